@@ -26,7 +26,10 @@
 
 #include "capture_video.h"
 
-CaptureThread::CaptureThread(int cam_id)
+CaptureThread::CaptureThread(int cam_id) : values([this](Values & v) {
+    v.auto_refresh = c_auto_refresh->getBool();
+    v.print_timings = c_print_timings->getBool();
+  })
 {
   camId=cam_id;
   affinity=0;
@@ -40,6 +43,8 @@ CaptureThread::CaptureThread(int cam_id)
   // timings should only be printed on demand for a short period of time by temporally activating this flag
   control->addChild( (VarType*) (c_print_timings = new VarBool("print timings",false)));
   control->addChild( (VarType*) (c_refresh= new VarTrigger("re-read params","Refresh")));
+  values.bind(c_auto_refresh);
+  values.bind(c_print_timings);
   control->addChild( (VarType*) (captureModule= new VarStringEnum("Capture Module",camId < 1 ? "Read from files" : "None")));
   captureModule->addFlags(VARTYPE_FLAG_NOLOAD_ENUM_CHILDREN);
   captureModule->addItem("None");
@@ -343,7 +348,8 @@ void CaptureThread::run() {
 
             auto t_process = std::chrono::steady_clock::now();
 
-              if(c_print_timings->getBool())
+              values.update();
+              if(values->print_timings)
               {
                 auto getFrame_duration = std::chrono::duration_cast<std::chrono::microseconds>(t_getFrame - t_start);
                 std::cout << std::setw(13) << std::left << "getFrame"
@@ -360,7 +366,7 @@ void CaptureThread::run() {
               }
 
               if (changed) {
-                if (c_auto_refresh->getBool()==true) {
+                if (values->auto_refresh==true) {
                   capture_mutex.lock();
                   if ((capture != 0) && (capture->isCapturing())) capture->readAllParameterValues();
                   capture_mutex.unlock();
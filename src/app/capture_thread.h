@@ -35,6 +35,7 @@
 #include "visionstack.h"
 #include "capturestats.h"
 #include "affinity_manager.h"
+#include "VarBinding.h"
 
 #ifdef MVIMPACT2
 #include "capture_bluefox2.h"
@@ -106,6 +107,13 @@ protected:
   VarBool * c_print_timings;
   VarStringEnum * captureModule;
 
+  //per-frame copies of the capture control flags
+  struct Values {
+    bool auto_refresh;
+    bool print_timings;
+  };
+  VarBinding<Values> values;
+
 public slots:
   bool init();
   bool stop();
@@ -53,6 +53,12 @@ public:
     erase(label);
     return insert(label, item);
   }
+  /// removes the label and returns its item for the caller to delete, 0 if there was none
+  void * remove(const string & label) {
+    void * item = get(label);
+    erase(label);
+    return item;
+  }
 };
 
 /*!
@@ -306,6 +306,8 @@ void GLLUTWidget::drawEvent ( QMouseEvent * event )
     //update texture
     slices[state.slice_idx]->selection_update_pending=true;
     _lut->unlock();
+    //make the edit visible to the running threshold plugins right away
+    _lut->publish();
 
     this->redraw();
   }
@@ -90,6 +90,8 @@ GLWidget::GLWidget ( QWidget *parent , bool allow_qpainter_overlay) : QGLWidget
   rb_bb=0;
   rb=0;
   stack=0;
+  vis_output=0;
+  vis_output_drawn=0;
   setAutoFillBackground(false);
   //not needed because we are remote triggering this:
   //startTimer(1);
@@ -247,29 +249,17 @@ void GLWidget::myGLdraw() {
     glPushMatrix();
 
       glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-      if ( rb!=0 ) {
+      if ( vis_output!=0 ) {
+        VisualizationFrame * vis_frame = vis_output->lockFront();
+        unsigned long published = vis_output->getPublished();
+        drawVisualizationFrame ( vis_frame );
+        vis_output->unlockFront(true);
+        vis_output_drawn=published;
+      } else if ( rb!=0 ) {
         rb->lockRead();
         int idx=rb->curRead();
         FrameData * frame = rb->getPointer ( idx );
-        VisualizationFrame * vis_frame=(VisualizationFrame *)(frame->map.get("vis_frame"));
-        if (vis_frame!=0 && vis_frame->valid==true && vis_frame->data.getData() != 0 && vis_frame->data.getWidth() >= 1 && vis_frame->data.getHeight() >=1 ) {
-          rgbImage & img = vis_frame->data;
-          if ( img.getWidth() > 1 && img.getHeight() > 1 ) {
-            glPushMatrix();
-            zoom.setup ( img.getWidth(), img.getHeight(), vpW,vpH,true );
-            pixelloc orig=zoom.zoom ( 0, 0 );
-
-            glPushMatrix();
-            glRasterPos2i ( 0,0 );
-            glBitmap ( 0,0,0,0,orig.x,-orig.y,0 );
-            glPixelZoom ( zoom.getZoom() * zoom.getFlipXval(),zoom.getZoom() * zoom.getFlipYval() * -1.0 );
-            glDrawPixels ( img.getWidth(), img.getHeight(), GL_RGB, GL_UNSIGNED_BYTE, img.getData() );
-            glPopMatrix();
-
-            glPopMatrix();
-          }
-
-        }
+        drawVisualizationFrame ( (VisualizationFrame *)(frame->map.get("vis_frame")) );
         rb->unlockRead();
       }
 
@@ -282,6 +272,29 @@ void GLWidget::myGLdraw() {
   glPopAttrib();
 
 }
+
+void GLWidget::drawVisualizationFrame ( VisualizationFrame * vis_frame ) {
+  if (vis_frame!=0 && vis_frame->valid==true && vis_frame->data.getData() != 0 && vis_frame->data.getWidth() >= 1 && vis_frame->data.getHeight() >=1 ) {
+    rgbImage & img = vis_frame->data;
+    if ( img.getWidth() > 1 && img.getHeight() > 1 ) {
+      //zoom in camera image pixels, so that mouse positions stay in camera image coordinates
+      int scale = vis_frame->scale;
+      glPushMatrix();
+      zoom.setup ( img.getWidth() * scale, img.getHeight() * scale, vpW,vpH,true );
+      pixelloc orig=zoom.zoom ( 0, 0 );
+
+      glPushMatrix();
+      glRasterPos2i ( 0,0 );
+      glBitmap ( 0,0,0,0,orig.x,-orig.y,0 );
+      glPixelZoom ( zoom.getZoom() * scale * zoom.getFlipXval(),zoom.getZoom() * scale * zoom.getFlipYval() * -1.0 );
+      glDrawPixels ( img.getWidth(), img.getHeight(), GL_RGB, GL_UNSIGNED_BYTE, img.getData() );
+      glPopMatrix();
+
+      glPopMatrix();
+    }
+  }
+}
+
 void GLWidget::setupViewPort ( int width, int height ) {
   glViewport ( 0, 0, width, height );
   glOrtho ( 0, width, 0, height, -1, 1 );
@@ -377,7 +390,13 @@ void GLWidget::myQPainterOverlay(QPainter & painter, QTransform & trans) {
 
 void GLWidget::saveImage() {
   rgbImage temp;
-  if ( rb!=0 ) {
+  if ( vis_output!=0 ) {
+    VisualizationFrame * vis_frame = vis_output->lockFront();
+    bool valid = vis_frame->valid;
+    if (valid) temp.copy ( vis_frame->data );
+    vis_output->unlockFront(false);
+    if (!valid) return;
+  } else if ( rb!=0 ) {
     rb->lockRead();
     int idx=rb->curRead();
     FrameData * frame = rb->getPointer ( idx );
@@ -57,6 +57,8 @@ protected:
   int vpH;
   long long last_frame;
   VisionStack * stack;
+  VisualizationOutput * vis_output;
+  unsigned long vis_output_drawn;
   QPoint mouseStart;
   double mouseStartPanX;
   double mouseStartPanY;
@@ -100,6 +102,11 @@ public:
   {
     stack=_stack;
   }
+  /// draw the visualization of this output instead of the one in the ring buffer
+  void setVisualizationOutput(VisualizationOutput * output)
+  {
+    vis_output=output;
+  }
   void setObjectName(const QString & s)
   {
     QGLWidget::setObjectName(s);
@@ -132,6 +139,7 @@ public:
   virtual void myGLinit();
   virtual void myGLdraw();
   void setupViewPort ( int width, int height );
+  void drawVisualizationFrame ( VisualizationFrame * vis_frame );
 
 
   virtual void displayLoopEvent(bool frame_changed, RenderOptions * opts)
@@ -153,7 +161,14 @@ public:
       }
 
       rb->unlockRead();
-      redraw();
+      if (vis_output==0) redraw();
+    }
+
+    if (vis_output!=0) {
+      //hidden, minimized or switched off displays ask for no frames
+      bool shown = actionOn->isChecked() && isVisible() && !window()->isMinimized() && !visibleRegion().isEmpty();
+      vis_output->setVisible(shown);
+      if (shown && vis_output->getPublished() != vis_output_drawn) redraw();
     }
 
     stats.fps_loop= c_loop.getFPS(changed);
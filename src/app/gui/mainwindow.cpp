@@ -63,6 +63,10 @@ MainWindow::MainWindow(bool start_capture, bool enforce_affinity, int num_camera
     GLWidget * gl=new GLWidget(0,false);
     gl->setRingBuffer(multi_stack->threads[i]->getFrameBuffer());
     gl->setVisionStack(s);
+    for (VisionPlugin * plugin : s->stack) {
+      PluginVisualize * vis = dynamic_cast<PluginVisualize *>(plugin);
+      if (vis!=0) gl->setVisualizationOutput(vis->getOutput());
+    }
     QString label = "Thread " + QString::number(i);
 #ifdef CAMERA_SPLITTER
     if(i == multi_stack->threads.size() - 1)
@@ -145,6 +149,8 @@ MainWindow::MainWindow(bool start_capture, bool enforce_affinity, int num_camera
   //update network output settings from xml file
   ((MultiStackRoboCupSSL*)multi_stack)->RefreshNetworkOutput();
   ((MultiStackRoboCupSSL*)multi_stack)->RefreshLegacyNetworkOutput();
+  ((MultiStackRoboCupSSL*)multi_stack)->RefreshTrackerOutput();
+  ((MultiStackRoboCupSSL*)multi_stack)->RefreshMergedOutput();
   multi_stack->start();
 
   if (start_capture==true) {
@@ -201,7 +207,7 @@ void MainWindow::timerEvent( QTimerEvent * e) {
 
 void MainWindow::slotSaveSettings()
 {
-    VarXML::write(world,"settings.xml");
+    settings_writer.write(world,"settings.xml");
 }
 
 void MainWindow::init() {
@@ -223,7 +229,8 @@ void MainWindow::closeEvent(QCloseEvent * event ) {
 MainWindow::~MainWindow() {
   if (affinity!=0) delete affinity;
   //FIXME: right now we don't clean up anything
-  VarXML::write(world,"settings.xml");
+  settings_writer.write(world,"settings.xml");
+  settings_writer.flush();
 
   // Stop stack:
   multi_stack->stop();
@@ -37,6 +37,7 @@
 #include "lutwidget.h"
 #include <QStringList>
 #include "VarXML.h"
+#include "VarXMLWriter.h"
 #include "stacks.h"
 #include "qgetopt.h"
 #include "multistacks.h"
@@ -60,6 +61,7 @@ public:
   QTabWidget * cam_tabs;
   VarList * settings;
   vector<VarType * > world;
+  VarXMLWriter settings_writer;
   VarTreeModel * tmodel;
   vector<RealTimeDisplayWidget *> display_widgets;
   vector<QSplitter *> stack_widgets;
@@ -108,9 +108,8 @@ void PluginAutoColorCalibration::runCalibration() {
     if (use) colors.emplace_back(color, channel, weight, maxDistance, maxAngle);
   }
 
-  initialColorCalibrator.process(colors, global_lut);
-  lutw->getGLLUTWidget()->needs_init = true;
-  lutw->getGLLUTWidget()->repaint();
+  // runs in the background, the LUT widget is refreshed in process_gui_commands() once it is done
+  initialColorCalibrator.processAsync(colors, global_lut);
 }
 
 VarList *PluginAutoColorCalibration::getSettings() {
@@ -129,6 +128,12 @@ void PluginAutoColorCalibration::process_gui_commands() {
     return;
   }
 
+  if (initialColorCalibrator.takeFinished()) {
+    lutw->getGLLUTWidget()->needs_init = true;
+    lutw->getGLLUTWidget()->repaint();
+    accw->set_status("Calibration finished");
+  }
+
   if (accw->pending_reset_lut) {
     accw->pending_reset_lut = false;
     global_lut->reset();
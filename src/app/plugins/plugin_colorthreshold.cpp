@@ -20,17 +20,16 @@
 //========================================================================
 #include "plugin_colorthreshold.h"
 
-static void thresholdImage(RawImage *imagePartIn, Image<raw8> *imagePartOut, YUVLUT * lut, const ImageInterface* mask = nullptr) {
+static void thresholdImage(RawImage *imagePartIn, Image<raw8> *imagePartOut, YUVLUT * lut, RGBLUT * rgblut, const ImageRowSpan * mask_spans = nullptr) {
   if (imagePartIn->getColorFormat() == COLOR_YUV422_UYVY) {
-    CMVisionThreshold::thresholdImageYUV422_UYVY(imagePartOut, imagePartIn, lut, mask);
+    CMVisionThreshold::thresholdImageYUV422_UYVY(imagePartOut, imagePartIn, lut, mask_spans);
   } else if (imagePartIn->getColorFormat() == COLOR_YUV444) {
-    CMVisionThreshold::thresholdImageYUV444(imagePartOut, imagePartIn, lut, mask);
+    CMVisionThreshold::thresholdImageYUV444(imagePartOut, imagePartIn, lut, mask_spans);
   } else if (imagePartIn->getColorFormat() == COLOR_RGB8) {
-    auto *rgblut = (RGBLUT *) lut->getDerivedLUT(CSPACE_RGB);
     if (rgblut == nullptr) {
       printf("WARNING: No RGB LUT has been defined. You need to create a derived RGB LUT by calling e.g. \"lut_yuv->addDerivedLUT(new RGBLUT(5,5,5,\"\"))\" in the stack constructor!\n");
     } else {
-      CMVisionThreshold::thresholdImageRGB(imagePartOut, imagePartIn, rgblut, mask);
+      CMVisionThreshold::thresholdImageRGB(imagePartOut, imagePartIn, rgblut, mask_spans);
     }
   } else {
     fprintf(stderr, "ColorThresholding needs YUV422, YUV444, or RGB8 as input image, but found: %s\n",
@@ -43,6 +42,7 @@ PluginColorThresholdWorker::PluginColorThresholdWorker(int _id, int _totalThread
   this->id = _id;
   this->totalThreads = _totalThreads;
   this->lut = _lut;
+  this->rgblut = (RGBLUT *) _lut->getDerivedLUT(CSPACE_RGB);
 
   thread = new QThread();
   thread->setObjectName("ColorThreshold");
@@ -58,30 +58,33 @@ PluginColorThresholdWorker::~PluginColorThresholdWorker() {
 
 
 void PluginColorThresholdWorker::process() {
+  // split on whole rows, so that each worker's mask spans line up with its rows
+  int height = imageIn->getHeight();
+  int rowBegin = id * height / totalThreads;
+  int rowEnd = (id + 1) * height / totalThreads;
+
   RawImage imagePartIn;
   imagePartIn.setColorFormat(imageIn->getColorFormat());
-  imagePartIn.setHeight(imageIn->getHeight()/totalThreads);
+  imagePartIn.setHeight(rowEnd - rowBegin);
   imagePartIn.setWidth(imageIn->getWidth());
-  int offsetBytesIn = id * imageIn->getNumBytes() / totalThreads;
+  int offsetBytesIn = RawImage::computeImageSize(imageIn->getColorFormat(), rowBegin * imageIn->getWidth());
   imagePartIn.setData(imageIn->getData() + offsetBytesIn);
 
-  RawImage maskImagePartIn;
-  maskImagePartIn.setColorFormat(maskImageIn->getColorFormat());
-  maskImagePartIn.setHeight(maskImageIn->getHeight()/totalThreads);
-  maskImagePartIn.setWidth(maskImageIn->getWidth());
-  int maskOffsetBytesIn = id * maskImageIn->getNumBytes() /  totalThreads;
-  maskImagePartIn.setData(maskImageIn->getData() + maskOffsetBytesIn);
-
   RawImage rawImageOut;
   rawImageOut.setColorFormat(imageOut->getColorFormat());
-  rawImageOut.setHeight(imageOut->getHeight()/totalThreads);
+  rawImageOut.setHeight(rowEnd - rowBegin);
   rawImageOut.setWidth(imageOut->getWidth());
-  int offsetBytesOut = id * imageOut->getNumBytes() / totalThreads;
+  int offsetBytesOut = RawImage::computeImageSize(imageOut->getColorFormat(), rowBegin * imageOut->getWidth());
   rawImageOut.setData(imageOut->getData() + offsetBytesOut);
   Image<raw8> imagePartOut;
   imagePartOut.fromRawImage(rawImageOut);
 
-  thresholdImage(&imagePartIn, &imagePartOut, lut, &maskImagePartIn);
+  const ImageRowSpan * maskSpansPartIn = nullptr;
+  if (maskSpansIn != nullptr) {
+    maskSpansPartIn = maskSpansIn + rowBegin;
+  }
+
+  thresholdImage(&imagePartIn, &imagePartOut, lut, rgblut, maskSpansPartIn);
 
   doneMutex.unlock();
 }
@@ -100,13 +103,21 @@ void PluginColorThresholdWorker::wait() {
 
 
 PluginColorThreshold::PluginColorThreshold(FrameBuffer * _buffer, YUVLUT * _lut, ConvexHullImageMask &mask)
-  : VisionPlugin(_buffer), _image_mask(mask)
+  : VisionPlugin(_buffer), _image_mask(mask), values([this](Values & v) {
+      v.num_threads = numThreads->getInt();
+      v.compress_lut = compressLUT->getBool();
+    })
 {
   lut=_lut;
+  //derived LUTs are created together with the stack, so look it up once instead of locking the LUT for every frame
+  rgblut=(RGBLUT *) _lut->getDerivedLUT(CSPACE_RGB);
 
   settings=new VarList("Color Threshold");
   numThreads = new VarInt("number of threads", 0, 0, 32);
   settings->addChild(numThreads);
+  compressLUT = new VarBool("compressed LUT", false);
+  settings->addChild(compressLUT);
+  values.bind(settings);
 }
 
 
@@ -137,20 +148,34 @@ ProcessResult PluginColorThreshold::process(FrameData * data, RenderOptions * op
   //make sure image is allocated:
   img_thresholded->allocate(data->video.getWidth(),data->video.getHeight());
 
-  if((int) workers.size() != numThreads->getInt()) {
+  if (values.update() && lut->getCompression() != values->compress_lut) {
+    if (!lut->setCompression(values->compress_lut)) {
+      //not supported for this LUT layout, switch the setting off so that it is not retried
+      compressLUT->setBool(false);
+    }
+  }
+
+  if((int) workers.size() != values->num_threads) {
     clearWorkers();
-    for(int i=0;i<numThreads->getInt();i++) {
-      auto *worker = new PluginColorThresholdWorker(i, numThreads->getInt(), lut);
+    for(int i=0;i<values->num_threads;i++) {
+      auto *worker = new PluginColorThresholdWorker(i, values->num_threads, lut);
       workers.push_back(worker);
     }
   }
 
+  // the mask is resized along with the image by the mask plugin, until then it covers the whole image
+  const std::vector<ImageRowSpan> & spans = _image_mask.getRowSpans();
+  const ImageRowSpan * mask_spans = nullptr;
+  if ((int) spans.size() == img_thresholded->getHeight() && _image_mask.getMask().getWidth() == img_thresholded->getWidth()) {
+    mask_spans = spans.data();
+  }
+
   if(workers.empty()) {
-    thresholdImage(&data->video, img_thresholded, lut, &_image_mask.getMask());
+    thresholdImage(&data->video, img_thresholded, lut, rgblut, mask_spans);
   } else {
     for (auto worker : workers) {
       worker->imageIn = &data->video;
-      worker->maskImageIn = &_image_mask.getMask();
+      worker->maskSpansIn = mask_spans;
       worker->imageOut = img_thresholded;
       worker->start();
     }
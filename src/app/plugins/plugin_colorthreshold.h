@@ -28,6 +28,7 @@
 #include <QThread>
 #include <QObject>
 #include "convex_hull_image_mask.h"
+#include "VarBinding.h"
 
 class PluginColorThresholdWorker : public QObject {
 Q_OBJECT
@@ -38,9 +39,10 @@ public:
     int id;
     int totalThreads;
     RawImage* imageIn = nullptr;
-    const ImageInterface* maskImageIn = nullptr;
+    const ImageRowSpan* maskSpansIn = nullptr;
     Image<raw8>* imageOut = nullptr;
     YUVLUT * lut;
+    RGBLUT * rgblut;
     std::mutex doneMutex;
 
     void start();
@@ -61,9 +63,17 @@ class PluginColorThreshold : public VisionPlugin
 {
 protected:
   YUVLUT * lut;
+  RGBLUT * rgblut;
   ConvexHullImageMask& _image_mask;
   VarList * settings;
   VarInt * numThreads;
+  VarBool * compressLUT;
+
+  struct Values {
+    int num_threads;
+    bool compress_lut;
+  };
+  VarBinding<Values> values;
 public:
   PluginColorThreshold(FrameBuffer * _buffer, YUVLUT * _lut, ConvexHullImageMask& mask);
 
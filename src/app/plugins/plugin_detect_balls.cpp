@@ -18,11 +18,11 @@
   \author  Author Name, 2009
 */
 //========================================================================
-#include <list>
+#include <algorithm>
 #include "plugin_detect_balls.h"
 
 PluginDetectBalls::PluginDetectBalls ( FrameBuffer * _buffer, LUT3D * lut, const CameraParameters& camera_params, const RoboCupField& field,PluginDetectBallsSettings * settings )
-    : VisionPlugin ( _buffer ), camera_parameters ( camera_params ), field ( field ) {
+    : VisionPlugin ( _buffer ), values ( [this] ( Values & v ) { readValues ( v ); } ), camera_parameters ( camera_params ), field ( field ) {
   _lut=lut;
 
   _settings=settings;
@@ -32,8 +32,8 @@ PluginDetectBalls::PluginDetectBalls ( FrameBuffer * _buffer, LUT3D * lut, const
     _have_local_settings=true;
   }
 
-  vnotify.addRecursive(_settings->getSettings());
-  vnotify.addRecursive(field.getSettings());
+  values.bind(_settings->getSettings());
+  values.bind(field.getSettings());
 
 
   //read-out important LUT data:
@@ -89,22 +89,50 @@ bool PluginDetectBalls::checkHistogram ( const Image<raw8> * image, const CMVisi
   return ( true );
 }
 
-//Data structure for storing and sorting the filtered regions
-class BallDetectResult
-{
-public:
-  const CMVision::Region* reg;
-  float conf;
-
-  BallDetectResult(const CMVision::Region* reg, float conf) {
-    this->reg = reg;
-    this->conf = conf;    
+void PluginDetectBalls::readValues ( Values & v ) {
+  //copy all vartypes to local variables for faster repeated lookup:
+  v.color_id_ball = _lut->getChannelID ( _settings->_color_label->getString() );
+  if ( v.color_id_ball == -1 ) {
+    printf ( "Unknown Ball Detection Color Label: '%s'\nAborting Plugin!\n",_settings->_color_label->getString().c_str() );
   }
 
-  bool operator< (BallDetectResult a) {
-    return conf < a.conf;
+  v.max_balls = _settings->_max_balls->getInt();
+  v.min_width = _settings->_ball_min_width->getInt();
+  v.max_width = _settings->_ball_max_width->getInt();
+  v.min_height = _settings->_ball_min_height->getInt();
+  v.max_height = _settings->_ball_max_height->getInt();
+  v.min_area = _settings->_ball_min_area->getInt();
+  v.max_area = _settings->_ball_max_area->getInt();
+
+  v.filter_ball_in_field = _settings->_ball_on_field_filter->getBool();
+  v.filter_ball_on_field_filter_threshold = _settings->_ball_on_field_filter_threshold->getDouble();
+  v.filter_ball_in_goal  = _settings->_ball_in_goal_filter->getBool();
+  v.filter_ball_histogram = _settings->_ball_histogram_enabled->getBool();
+  if ( v.filter_ball_histogram ) {
+    if ( v.color_id_ball != color_id_orange ) {
+      printf ( "Warning: ball histogram check is only configured for orange balls!\n" );
+      printf ( "Please disable the histogram check in the Ball Detection Plugin settings\n" );
+    }
+    if ( color_id_pink==-1 || color_id_orange==-1 || color_id_yellow==-1 || color_id_field==-1 ) {
+      printf ( "WARNING: some LUT color labels where undefined for the ball detection plugin\n" );
+      printf ( "         Disabling histogram check!\n" );
+      v.filter_ball_histogram=false;
+    }
   }
-};
+
+  v.min_greenness = _settings->_ball_histogram_min_greenness->getDouble();
+  v.max_markeryness = _settings->_ball_histogram_max_markeryness->getDouble();
+
+  //setup values used for the gaussian confidence measurement:
+  v.filter_gauss = _settings->_ball_gauss_enabled->getBool();
+  v.exp_area_min =  _settings->_ball_gauss_min->getInt();
+  v.exp_area_max = _settings->_ball_gauss_max->getInt();
+  v.exp_area_var = sq ( _settings->_ball_gauss_stddev->getDouble() );
+  v.z_height= _settings->_ball_z_height->getDouble();
+
+  v.near_robot_filter = _settings->_ball_too_near_robot_enabled->getBool();
+  v.near_robot_dist_sq = sq(_settings->_ball_too_near_robot_dist->getDouble());
+}
 
 ProcessResult PluginDetectBalls::process ( FrameData * data, RenderOptions * options ) {
   ( void ) options;
@@ -115,56 +143,22 @@ ProcessResult PluginDetectBalls::process ( FrameData * data, RenderOptions * opt
   detection_frame= ( SSL_DetectionFrame * ) data->map.get ( "ssl_detection_frame" );
   if ( detection_frame == 0 ) detection_frame= ( SSL_DetectionFrame * ) data->map.insert ( "ssl_detection_frame",new SSL_DetectionFrame() );
 
-  int color_id_ball = _lut->getChannelID ( _settings->_color_label->getString() );
-  if ( color_id_ball == -1 ) {
-    printf ( "Unknown Ball Detection Color Label: '%s'\nAborting Plugin!\n",_settings->_color_label->getString().c_str() );
+  //initialize filter:
+  if ( values.update() ) {
+    filter.setWidth ( values->min_width,values->max_width );
+    filter.setHeight ( values->min_height,values->max_height );
+    filter.setArea ( values->min_area,values->max_area );
+    field_filter.update ( field );
+  }
+  const Values & v = values.get();
+
+  if ( v.color_id_ball == -1 ) {
     return ProcessingFailed;
   }
 
   //delete any previous detection results:
   detection_frame->clear_balls();
 
-  //TODO: add a vartype notifier for better performance.
-
-  //initialize filter:
-  if (vnotify.hasChanged()) {
-    max_balls = _settings->_max_balls->getInt();
-    filter.setWidth ( _settings->_ball_min_width->getInt(),_settings->_ball_max_width->getInt() );
-    filter.setHeight ( _settings->_ball_min_height->getInt(),_settings->_ball_max_height->getInt() );
-    filter.setArea ( _settings->_ball_min_area->getInt(),_settings->_ball_max_area->getInt() );
-    field_filter.update ( field );
-
-    //copy all vartypes to local variables for faster repeated lookup:
-    filter_ball_in_field = _settings->_ball_on_field_filter->getBool();
-    filter_ball_on_field_filter_threshold = _settings->_ball_on_field_filter_threshold->getDouble();
-    filter_ball_in_goal  = _settings->_ball_in_goal_filter->getBool();
-    filter_ball_histogram = _settings->_ball_histogram_enabled->getBool();
-    if ( filter_ball_histogram ) {
-      if ( color_id_ball != color_id_orange ) {
-        printf ( "Warning: ball histogram check is only configured for orange balls!\n" );
-        printf ( "Please disable the histogram check in the Ball Detection Plugin settings\n" );
-      }
-      if ( color_id_pink==-1 || color_id_orange==-1 || color_id_yellow==-1 || color_id_field==-1 ) {
-        printf ( "WARNING: some LUT color labels where undefined for the ball detection plugin\n" );
-        printf ( "         Disabling histogram check!\n" );
-        filter_ball_histogram=false;
-      }
-    }
-
-    min_greenness = _settings->_ball_histogram_min_greenness->getDouble();
-    max_markeryness = _settings->_ball_histogram_max_markeryness->getDouble();
-
-    //setup values used for the gaussian confidence measurement:
-    filter_gauss = _settings->_ball_gauss_enabled->getBool();
-    exp_area_min =  _settings->_ball_gauss_min->getInt();
-    exp_area_max = _settings->_ball_gauss_max->getInt();
-    exp_area_var = sq ( _settings->_ball_gauss_stddev->getDouble() );
-    z_height= _settings->_ball_z_height->getDouble();
-
-    near_robot_filter = _settings->_ball_too_near_robot_enabled->getBool();
-    near_robot_dist_sq = sq(_settings->_ball_too_near_robot_dist->getDouble());
-  }
-
   const CMVision::Region * reg = 0;
 
   //acquire orange region list from data-map:
@@ -174,7 +168,7 @@ ProcessResult PluginDetectBalls::process ( FrameData * data, RenderOptions * opt
     printf ( "error in ball detection plugin: no region-lists were found!\n" );
     return ProcessingFailed;
   }
-  reg = colorlist->getRegionList ( color_id_ball ).getInitialElement();
+  reg = colorlist->getRegionList ( v.color_id_ball ).getInitialElement();
 
   //acquire color-labeled image from data-map:
   const Image<raw8> * image = ( Image<raw8> * ) ( data->map.get ( "cmv_threshold" ) );
@@ -183,9 +177,12 @@ ProcessResult PluginDetectBalls::process ( FrameData * data, RenderOptions * opt
     return ProcessingFailed;
   }
 
+  //pick up rebuilt projection tables before any image2field lookups:
+  camera_parameters.projection_lut->update(data->video.getWidth(), data->video.getHeight());
+
   int robots_blue_n=0;
   int robots_yellow_n=0;
-  bool use_near_robot_filter=near_robot_filter;
+  bool use_near_robot_filter=v.near_robot_filter;
   if ( use_near_robot_filter ) {
     SSL_DetectionFrame * detection_frame = ( SSL_DetectionFrame * ) data->map.get ( "ssl_detection_frame" );
     if ( detection_frame==0 ) {
@@ -197,89 +194,107 @@ ProcessResult PluginDetectBalls::process ( FrameData * data, RenderOptions * opt
     }
   }
 
-  if ( max_balls > 0 ) {
-    list<BallDetectResult> result;
+  if ( v.max_balls > 0 ) {
+    //gather all candidates first, so that they can be projected in one batch:
+    cand_regions.clear();
+    cand_conf.clear();
+    cand_pixel_x.clear();
+    cand_pixel_y.clear();
     filter.init ( reg );
-    
+
     while ( ( reg = filter.getNext() ) != 0 ) {
       float conf = 1.0;
 
-      if ( filter_gauss==true ) {
-        int a = reg->area - bound ( reg->area,exp_area_min,exp_area_max );
-        conf = gaussian ( a / exp_area_var );
+      if ( v.filter_gauss==true ) {
+        int a = reg->area - bound ( reg->area,v.exp_area_min,v.exp_area_max );
+        conf = gaussian ( a / v.exp_area_var );
       }
 
       //TODO: add a plugin for confidence masking... possibly multi-layered.
       //      to replace the commented det.mask.get(...) below:
       //if (filter_conf_mask) conf*=det.mask.get(reg->cen_x,reg->cen_y));
 
-      //convert from image to field coordinates:
-      vector2d pixel_pos ( reg->cen_x,reg->cen_y );
-      vector3d field_pos_3d;
-      camera_parameters.image2field ( field_pos_3d,pixel_pos,z_height );
-      vector2d field_pos ( field_pos_3d.x,field_pos_3d.y );
+      cand_regions.push_back ( reg );
+      cand_conf.push_back ( conf );
+      cand_pixel_x.push_back ( reg->cen_x );
+      cand_pixel_y.push_back ( reg->cen_y );
+    }
+
+    int n = cand_regions.size();
+    cand_field_x.resize ( n );
+    cand_field_y.resize ( n );
+    cand_robot_x.resize ( n );
+    cand_robot_y.resize ( n );
+
+    //convert from image to field coordinates:
+    camera_parameters.projection_lut->image2field ( cand_field_x.data(), cand_field_y.data(), cand_pixel_x.data(), cand_pixel_y.data(), n, v.z_height );
+
+    for ( int i = 0; i < n; i++ ) {
+      vector2d field_pos ( cand_field_x[i],cand_field_y[i] );
 
       //filter points that are outside of the field:
-      if ( filter_ball_in_field==true && field_filter.isInFieldPlusThreshold ( field_pos, max(0.0,filter_ball_on_field_filter_threshold) ) ==false ) {
-        conf = 0.0;
+      if ( v.filter_ball_in_field==true && field_filter.isInFieldPlusThreshold ( field_pos, max(0.0,v.filter_ball_on_field_filter_threshold) ) ==false ) {
+        cand_conf[i] = 0.0;
       }
 
       //filter out points that are deep inside the goal-box
-      if ( filter_ball_in_goal==true && field_filter.isFarInGoal ( field_pos ) ==true ) {
-        conf = 0.0;
+      if ( v.filter_ball_in_goal==true && field_filter.isFarInGoal ( field_pos ) ==true ) {
+        cand_conf[i] = 0.0;
       }
+    }
 
-      //TODO add ball-too-near-robot filter
-      if ( use_near_robot_filter && conf > 0.0 ) {
-        int robots_n=0;
-        for (int team = 0; team < 2; team++) {
-          if (team==0) {
-            robots_n=robots_blue_n;
-          } else {
-            robots_n=robots_yellow_n;
+    //ball-too-near-robot filter:
+    //the candidates are projected once per distinct robot height and then compared against all robots of that height
+    if ( use_near_robot_filter && n > 0 ) {
+      robot_heights.clear();
+      for (int team = 0; team < 2; team++) {
+        const ::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot > & robots = (team==0) ? detection_frame->robots_blue() : detection_frame->robots_yellow();
+        for (int r = 0; r < robots.size(); r++) {
+          const SSL_DetectionRobot & robot = robots.Get(r);
+          if (robot.confidence() > 0.0 && find(robot_heights.begin(), robot_heights.end(), robot.height()) == robot_heights.end()) {
+            robot_heights.push_back(robot.height());
           }
-          if (robots_n > 0) {
-            ::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot > * robots;
-            if (team==0) {
-              robots = detection_frame->mutable_robots_blue();
-            } else {
-              robots = detection_frame->mutable_robots_yellow();
-            }
-            for (int r = 0; r < robots_n; r++) {
-              const SSL_DetectionRobot & robot = robots->Get(r);
-              if (robot.confidence() > 0.0) {
-                vector3d field_on_bot_pos_3d;
-                camera_parameters.image2field ( field_on_bot_pos_3d, pixel_pos, robot.height());
-                if ((sq((double)(robot.x())-(double)(field_on_bot_pos_3d.x)) + sq((double)(robot.y())-(double)(field_on_bot_pos_3d.y))) < near_robot_dist_sq) {
-                  conf = 0.0;
-                  break;
+        }
+      }
+
+      for (unsigned int h = 0; h < robot_heights.size(); h++) {
+        camera_parameters.projection_lut->image2field ( cand_robot_x.data(), cand_robot_y.data(), cand_pixel_x.data(), cand_pixel_y.data(), n, robot_heights[h] );
+        for (int team = 0; team < 2; team++) {
+          const ::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot > & robots = (team==0) ? detection_frame->robots_blue() : detection_frame->robots_yellow();
+          for (int r = 0; r < robots.size(); r++) {
+            const SSL_DetectionRobot & robot = robots.Get(r);
+            if (robot.confidence() > 0.0 && robot.height() == robot_heights[h]) {
+              for ( int i = 0; i < n; i++ ) {
+                if (cand_conf[i] > 0.0 && (sq((double)(robot.x())-cand_robot_x[i]) + sq((double)(robot.y())-cand_robot_y[i])) < v.near_robot_dist_sq) {
+                  cand_conf[i] = 0.0;
                 }
               }
             }
-            if (conf==0.0) break;
           }
         }
       }
+    }
 
+    result.clear();
+    for ( int i = 0; i < n; i++ ) {
       // histogram check if enabled
-      if ( filter_ball_histogram && conf > 0.0 && checkHistogram ( image, reg, min_greenness, max_markeryness ) ==false ) {
-        conf = 0.0;
+      if ( v.filter_ball_histogram && cand_conf[i] > 0.0 && checkHistogram ( image, cand_regions[i], v.min_greenness, v.max_markeryness ) ==false ) {
+        cand_conf[i] = 0.0;
       }
 
       // add filtered region to the region list
-      if(conf > 0) {
-        result.push_back(BallDetectResult(reg,conf));
+      if(cand_conf[i] > 0) {
+        result.push_back(BallDetectResult(cand_regions[i],cand_conf[i],i));
       }
-
     }
 
     // sort result by confidence and output first max_balls region(s)
-    result.sort();
-    
+    stable_sort(result.begin(), result.end());
+
     int num_ball = 0;
-    list<BallDetectResult>::reverse_iterator it;
+    vector<BallDetectResult>::reverse_iterator it;
     for(it=result.rbegin(); it!=result.rend(); it++) {
-      if(++num_ball > max_balls)
+      if(++num_ball > v.max_balls)
         break;
 
       //update result:
@@ -287,13 +302,9 @@ ProcessResult PluginDetectBalls::process ( FrameData * data, RenderOptions * opt
 
       ball->set_confidence ( it->conf );
 
-      vector2d pixel_pos ( it->reg->cen_x,it->reg->cen_y );
-      vector3d field_pos_3d;
-      camera_parameters.image2field ( field_pos_3d,pixel_pos,z_height );
-
       ball->set_area ( it->reg->area );
-      ball->set_x ( field_pos_3d.x );
-      ball->set_y ( field_pos_3d.y );
+      ball->set_x ( cand_field_x[it->idx] );
+      ball->set_y ( cand_field_y[it->idx] );
       ball->set_pixel_x ( it->reg->cen_x );
       ball->set_pixel_y ( it->reg->cen_y );
     }
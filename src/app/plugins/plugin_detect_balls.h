@@ -28,13 +28,32 @@
 #include "field_filter.h"
 #include "cmvision_histogram.h"
 #include "vis_util.h"
-#include "VarNotifier.h"
+#include "VarBinding.h"
 #include "lut3d.h"
 /**
 	@author Author Name
 */
 class PluginDetectBalls;
 
+//Data structure for storing and sorting the filtered regions
+class BallDetectResult
+{
+public:
+  const CMVision::Region* reg;
+  float conf;
+  int idx; //index into the candidate buffers
+
+  BallDetectResult(const CMVision::Region* reg, float conf, int idx) {
+    this->reg = reg;
+    this->conf = conf;
+    this->idx = idx;
+  }
+
+  bool operator< (const BallDetectResult & a) const {
+    return conf < a.conf;
+  }
+};
+
 class PluginDetectBallsSettings {
 friend class PluginDetectBalls; 
 protected:
@@ -119,22 +138,32 @@ class PluginDetectBalls : public VisionPlugin
 protected:
   //-----------------------------
   //local copies of the vartypes tree for better performance
-  //these are updated automatically if a change is reported by vartypes
-  VarNotifier vnotify;
-  bool filter_ball_in_field;
-  double filter_ball_on_field_filter_threshold;
-  bool filter_ball_in_goal;
-  bool filter_ball_histogram;
-  double min_greenness;
-  double max_markeryness;
-  bool filter_gauss;
-  int exp_area_min;
-  int exp_area_max;
-  double exp_area_var;
-  double z_height;
-  bool near_robot_filter;
-  double near_robot_dist_sq;
-  int max_balls;
+  //these are re-read automatically if a change is reported by vartypes
+  struct Values {
+    int color_id_ball;
+    int max_balls;
+    int min_width;
+    int max_width;
+    int min_height;
+    int max_height;
+    int min_area;
+    int max_area;
+    bool filter_ball_in_field;
+    double filter_ball_on_field_filter_threshold;
+    bool filter_ball_in_goal;
+    bool filter_ball_histogram;
+    double min_greenness;
+    double max_markeryness;
+    bool filter_gauss;
+    int exp_area_min;
+    int exp_area_max;
+    double exp_area_var;
+    double z_height;
+    bool near_robot_filter;
+    double near_robot_dist_sq;
+  };
+  VarBinding<Values> values;
+  void readValues(Values & v);
   //-----------------------------
   
   
@@ -158,6 +187,19 @@ protected:
 
   FieldFilter field_filter;
 
+  //candidate buffers, reused across frames.
+  //pixel and field coordinates are kept as separate arrays for batch projection.
+  std::vector<const CMVision::Region *> cand_regions;
+  std::vector<float> cand_conf;
+  std::vector<double> cand_pixel_x;
+  std::vector<double> cand_pixel_y;
+  std::vector<double> cand_field_x;
+  std::vector<double> cand_field_y;
+  std::vector<double> cand_robot_x;
+  std::vector<double> cand_robot_y;
+  std::vector<float> robot_heights;
+  std::vector<BallDetectResult> result;
+
   bool checkHistogram(const Image<raw8> * image, const CMVision::Region * reg, double min_greenness=0.5, double max_markeryness=2.0);
 
 public:
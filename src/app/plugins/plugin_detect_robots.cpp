@@ -109,6 +109,9 @@ ProcessResult PluginDetectRobots::process(FrameData * data, RenderOptions * opti
     return ProcessingFailed;
   }
 
+  //pick up rebuilt projection tables before any image2field lookups:
+  camera_parameters.projection_lut->update(data->video.getWidth(), data->video.getHeight());
+
   CMPattern::Team * team=0;
   ::google::protobuf::RepeatedPtrField< ::SSL_DetectionRobot >* robotlist=0;
   
@@ -0,0 +1,48 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    plugin_detection_merger.cpp
+  \brief   C++ Implementation: plugin_detection_merger
+*/
+//========================================================================
+#include "plugin_detection_merger.h"
+
+PluginDetectionMerger::PluginDetectionMerger(FrameBuffer * _fb, DetectionMerger * merger, const CameraParameters& camera_params)
+ : VisionPlugin(_fb), _camera_params(camera_params)
+{
+  _merger=merger;
+}
+
+PluginDetectionMerger::~PluginDetectionMerger()
+{
+
+}
+
+ProcessResult PluginDetectionMerger::process(FrameData * data, RenderOptions * options)
+{
+  (void)options;
+  if (data == nullptr) return ProcessingFailed;
+
+  SSL_DetectionFrame * detection_frame=(SSL_DetectionFrame *)data->map.get("ssl_detection_frame");
+  if (detection_frame != nullptr && _merger->isEnabled()) {
+    GVector::vector3d<double> camera = _camera_params.getWorldLocation();
+    _merger->addFrame(*detection_frame, camera.x, camera.y);
+  }
+  return ProcessingOk;
+}
+
+string PluginDetectionMerger::getName() {
+  return "Merged Output";
+}
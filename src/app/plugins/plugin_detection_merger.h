@@ -0,0 +1,48 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    plugin_detection_merger.h
+  \brief   C++ Interface: plugin_detection_merger
+*/
+//========================================================================
+#ifndef PLUGIN_DETECTION_MERGER_H
+#define PLUGIN_DETECTION_MERGER_H
+
+#include <visionplugin.h>
+#include "detection_merger.h"
+#include "camera_calibration.h"
+
+/*!
+  \class PluginDetectionMerger
+  \brief Passes the detection frame of a camera to the shared DetectionMerger
+
+  Must run after the network output, which fills in the capture time and
+  camera id of the frame. The camera position, by which the merger ranks
+  duplicate detections, is taken from the camera calibration.
+**/
+class PluginDetectionMerger : public VisionPlugin
+{
+protected:
+  DetectionMerger * _merger;
+  const CameraParameters& _camera_params;
+public:
+  PluginDetectionMerger(FrameBuffer * _fb, DetectionMerger * merger, const CameraParameters& camera_params);
+  ~PluginDetectionMerger();
+
+  virtual ProcessResult process(FrameData * data, RenderOptions * options);
+  virtual string getName();
+};
+
+#endif
@@ -0,0 +1,47 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    plugin_detection_tracker.cpp
+  \brief   C++ Implementation: plugin_detection_tracker
+*/
+//========================================================================
+#include "plugin_detection_tracker.h"
+
+PluginDetectionTracker::PluginDetectionTracker(FrameBuffer * _fb, DetectionTracker * tracker)
+ : VisionPlugin(_fb)
+{
+  _tracker=tracker;
+}
+
+PluginDetectionTracker::~PluginDetectionTracker()
+{
+
+}
+
+ProcessResult PluginDetectionTracker::process(FrameData * data, RenderOptions * options)
+{
+  (void)options;
+  if (data == nullptr) return ProcessingFailed;
+
+  SSL_DetectionFrame * detection_frame=(SSL_DetectionFrame *)data->map.get("ssl_detection_frame");
+  if (detection_frame != nullptr) {
+    _tracker->addFrame(*detection_frame);
+  }
+  return ProcessingOk;
+}
+
+string PluginDetectionTracker::getName() {
+  return "Tracker";
+}
@@ -0,0 +1,45 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    plugin_detection_tracker.h
+  \brief   C++ Interface: plugin_detection_tracker
+*/
+//========================================================================
+#ifndef PLUGIN_DETECTION_TRACKER_H
+#define PLUGIN_DETECTION_TRACKER_H
+
+#include <visionplugin.h>
+#include "detection_tracker.h"
+
+/*!
+  \class PluginDetectionTracker
+  \brief Passes the detection frame of a camera to the shared DetectionTracker
+
+  Must run after the network output, which fills in the capture time and
+  camera id of the frame.
+**/
+class PluginDetectionTracker : public VisionPlugin
+{
+protected:
+  DetectionTracker * _tracker;
+public:
+  PluginDetectionTracker(FrameBuffer * _fb, DetectionTracker * tracker);
+  ~PluginDetectionTracker();
+
+  virtual ProcessResult process(FrameData * data, RenderOptions * options);
+  virtual string getName();
+};
+
+#endif
@@ -21,6 +21,8 @@
 #include "plugin_dvr.h"
 
 #include <google/protobuf/util/json_util.h>
+#include <QDateTime>
+#include <QFile>
 #include <chrono>
 #include <fstream>
 #include <utility>
@@ -84,6 +86,8 @@ PluginDVRWidget::PluginDVRWidget(PluginDVR * dvr, QWidget * parent) : QWidget(pa
   btn_rec_new->setToolTip("New Recording");
   btn_rec_load = new QToolButton();
   btn_rec_load->setToolTip("Load Recording");
+  btn_rec_open = new QToolButton();
+  btn_rec_open->setToolTip("Play Continuous Recording From Disk");
   btn_rec_save = new QToolButton();
   btn_rec_save->setToolTip("Save Recording");
 
@@ -99,12 +103,16 @@ PluginDVRWidget::PluginDVRWidget(PluginDVR * dvr, QWidget * parent) : QWidget(pa
   btn_rec_load->setIcon(QIcon(":/icons/document-open.png"));
   btn_rec_load->setIconSize(QSize(mode_icon_size,mode_icon_size));
 
+  btn_rec_open->setIcon(QIcon(":/icons/video.png"));
+  btn_rec_open->setIconSize(QSize(mode_icon_size,mode_icon_size));
+
   btn_rec_save->setIcon(QIcon(":/icons/document-save.png"));
   btn_rec_save->setIconSize(QSize(mode_icon_size,mode_icon_size));
 
   connect(btn_rec_continuous,SIGNAL(clicked(bool)),dvr,SLOT(slotRecordContinuousToggled()));
   connect(btn_rec_new,SIGNAL(clicked(bool)),dvr,SLOT(slotMovieNew()));
   connect(btn_rec_load,SIGNAL(clicked(bool)),dvr,SLOT(slotMovieLoad()));
+  connect(btn_rec_open,SIGNAL(clicked(bool)),dvr,SLOT(slotMovieOpen()));
   connect(btn_rec_save,SIGNAL(clicked(bool)),dvr,SLOT(slotMovieSave()));
 
 
@@ -154,6 +162,7 @@ PluginDVRWidget::PluginDVRWidget(PluginDVR * dvr, QWidget * parent) : QWidget(pa
   layout_rec = new QHBoxLayout();
   layout_rec->addWidget(btn_rec_new);
   layout_rec->addWidget(btn_rec_load);
+  layout_rec->addWidget(btn_rec_open);
   layout_rec->addWidget(btn_rec_save);
   layout_rec->addStretch();
 
@@ -248,6 +257,7 @@ void PluginDVR::slotSeekModeToggled() {
     } else {
       seek_mode=SeekModeLive;
     }
+    play_anchor_valid=false;
   unlock();
 }
 
@@ -278,29 +288,16 @@ DVRFrame::~DVRFrame() {
 }
 
 void PluginDVR::slotRecordContinuousToggled(){
+  // Stop a running recording. Closing writes the remaining frames, so do it outside the plugin lock
+  lock();
   is_recording_continuous = false;
-
-  // Destruct the frame writer if it exists
-  if(frame_writer){
-    frame_writer.reset();
-  }
+  std::unique_ptr<DVRRecorder> old_recorder = std::move(recorder);
+  unlock();
+  old_recorder.reset();
 
   // Return if continuous recording is disabled
   if(!w->btn_rec_continuous->isChecked()) return;
 
-  // If the FPS limiter is not enabled, inform the user
-  if(!_fps_limit_enable->getBool()){
-    QMessageBox::StandardButton reply;
-    reply = QMessageBox::question(w, "Warning! FPS limiter not enabled!", "The FPS limiter is not enabled. Writing all "
-                                  "frames could take a toll on your computer. You can enable the FPS limiter on the "
-                                  "left under DVR Settings. Do you still want to continue?", QMessageBox::Yes | QMessageBox::No);
-
-    if(reply == QMessageBox::No){
-      w->btn_rec_continuous->setChecked(false);
-      return;
-    }
-  }
-
   // Ask the user where to store the recordings
   const auto dir = QFileDialog::getExistingDirectory(nullptr, "Select Directory to store", "", QFileDialog::DontUseNativeDialog | QFileDialog::ShowDirsOnly);
 
@@ -310,32 +307,48 @@ void PluginDVR::slotRecordContinuousToggled(){
     return;
   }
 
-  // Create the frame writer with the given directory
-  frame_writer = std::unique_ptr<DVRNonBlockingWriter>(new DVRNonBlockingWriter(dir));
+  // All cameras may record into the same directory, so pick the first free file name
+  QString base = dir + "/recording-" + QDateTime::currentDateTime().toString("yyyyMMdd-hhmmss");
+  QString filename = base + ".dvr";
+  for (int i = 1; QFile::exists(filename); i++) {
+    filename = base + "-" + QString::number(i) + ".dvr";
+  }
+
+  std::unique_ptr<DVRRecorder> new_recorder(new DVRRecorder(
+      _rec_pool_size->getInt(), _rec_slab_size->getInt(), _rec_writer_threads->getInt()));
+  if (!new_recorder->open(filename.toStdString())) {
+    QMessageBox::warning(w, "DVR", "Unable to create the recording " + filename);
+    w->btn_rec_continuous->setChecked(false);
+    return;
+  }
+
+  lock();
+  recorder = std::move(new_recorder);
   is_recording_continuous = true;
+  unlock();
 }
 
 void PluginDVR::slotSeekFrameFirst() {
   lock();
-    stream.seek(0);
+    seekPlayback(0);
   unlock();
 }
 
 void PluginDVR::slotSeekFrameForward() {
   lock();
-    stream.advance(1,w->btn_seek_wrap->isChecked());
+    advancePlayback(1,w->btn_seek_wrap->isChecked());
   unlock();
 }
 
 void PluginDVR::slotSeekFrameBack() {
   lock();
-    stream.advance(-1,w->btn_seek_wrap->isChecked());
+    advancePlayback(-1,w->btn_seek_wrap->isChecked());
   unlock();
 }
 
 void PluginDVR::slotSeekFrameLast() {
   lock();
-    stream.seek(stream.getFrameCount()-1);
+    seekPlayback(getPlaybackFrameCount()-1);
   unlock();
 }
 
@@ -351,6 +364,7 @@ void PluginDVR::jogValueChanged(float val) {
 
 void PluginDVR::slotMovieNew() {
   lock();
+  reader.reset();
   stream.clear();
   unlock();
 }
@@ -366,7 +380,10 @@ void PluginDVR::slotMovieLoad() {
   if (dirstr!="") {
 
     int fnum=0;
+    reader.reset();
     stream.clear();
+    // staging buffers would skip frames that arrive this fast
+    stream.setCompression(false);
     QDir dir(dirstr);
     QFileInfoList list = dir.entryInfoList ( QDir::Files | QDir::Readable, QDir::Name );
     QProgressDialog * dlg = new QProgressDialog("Loading Movie from Files...","Cancel", 1,list.size());
@@ -398,13 +415,48 @@ void PluginDVR::slotMovieLoad() {
   unlock();
 }
 
+void PluginDVR::slotMovieOpen() {
+  QString filename = QFileDialog::getOpenFileName(
+      0,"Select Recording to Play", "", "DVR Recordings (*.dvr)", 0,
+      QFileDialog::DontUseNativeDialog);
+  if (filename.isEmpty()) return;
+
+  // only the index is loaded, frames are read while playing
+  std::unique_ptr<DVRReader> new_reader(new DVRReader(_play_read_ahead->getInt()));
+  if (!new_reader->open(filename.toStdString()) || new_reader->getFrameCount() == 0) {
+    QMessageBox::warning(w, "DVR", "Unable to play the recording " + filename);
+    return;
+  }
+
+  lock();
+  reader = std::move(new_reader);
+  play_index=0;
+  play_anchor_valid=false;
+  unlock();
+}
+
 void PluginDVR::slotMovieSave() {
   lock();
   QString dir = QFileDialog::getExistingDirectory(0,"Select Directory to Save");
-  QProgressDialog * dlg = new QProgressDialog("Saving Movie to PNG Files...","Cancel", 1,stream.getFrameCount());
+  QProgressDialog * dlg = new QProgressDialog("Saving Movie to PNG Files...","Cancel", 1,getPlaybackFrameCount());
   dlg->setWindowModality(Qt::WindowModal);
 
-  if (dir!="") {
+  if (dir!="" && reader) {
+    DVRFrame frame;
+    for (int i = 0; i < reader->getFrameCount(); i++) {
+      const DVRReader::Frame * f = reader->getFrame(i);
+      dlg->setValue(i+1);
+      if (f!=0 && f->copyImageTo(frame.video)) {
+        DVRUtils::saveFrame(frame, dir, i);
+      }
+      if (f!=0 && f->has_detection) {
+        DVRUtils::saveDetectionFrame(f->detection, dir, i);
+      }
+
+      if (dlg->wasCanceled()) break;
+    }
+  } else if (dir!="") {
+    SSL_DetectionFrame detection_frame;
     for (int i = 0; i < stream.getFrameCount(); i++) {
       DVRFrame * f = stream.getFrame(i);
       dlg->setValue(i+1);
@@ -412,9 +464,8 @@ void PluginDVR::slotMovieSave() {
         DVRUtils::saveFrame(*f, dir, i);
       }
 
-      SSL_DetectionFrame* detection_frame = stream.getDetectionFrame(i);
-      if(detection_frame){
-        DVRUtils::saveDetectionFrame(*detection_frame, dir, i);
+      if (stream.getDetectionFrame(i, detection_frame)) {
+        DVRUtils::saveDetectionFrame(detection_frame, dir, i);
       }
 
       if (dlg->wasCanceled()) break;
@@ -436,20 +487,40 @@ PluginDVR::PluginDVR(FrameBuffer * fb)
   _settings = new VarList("DVR Settings");
   _max_frames = new VarInt("Max Frames",250);
   _max_frames->setMin(0);
+  // all frames share one slab of this size, compression makes it cover more frames
+  _max_memory = new VarInt("Max Memory (MiB)",1024,16,65536);
+  _compress = new VarBool("Compress Frames",false);
   _shift_on_exceed = new VarBool("Shift Video On Exceeding",true);
 
-  // Options to limit FPS recording, as to not overload the PC with write operations
+  // Continuous recording writes raw frames at full rate, the limiter is only needed for slow disks
   _settings_rec_continuous = new VarList("DVR Record Continuous");
   _fps_limit_enable = new VarBool("Enable DVR FPS Limiter");
-  _fps_limit_enable->setBool(true);
+  _fps_limit_enable->setBool(false);
   _fps_limit = new VarDouble("DVR FPS Limit");
   _fps_limit->setInt(1.0);
+  // Frames are buffered in slabs of this pool, and each full slab is written with one large write
+  _rec_pool_size = new VarInt("Buffer Pool (MiB)",512,64,65536);
+  _rec_slab_size = new VarInt("Slab Size (MiB)",32,1,1024);
+  _rec_writer_threads = new VarInt("Writer Threads",2,1,16);
   _settings_rec_continuous->addChild(_fps_limit_enable);
   _settings_rec_continuous->addChild(_fps_limit);
+  _settings_rec_continuous->addChild(_rec_pool_size);
+  _settings_rec_continuous->addChild(_rec_slab_size);
+  _settings_rec_continuous->addChild(_rec_writer_threads);
+
+  // Recordings from disk are played at the rate they were recorded, or one frame per processed frame
+  _settings_playback = new VarList("DVR Playback");
+  _play_read_ahead = new VarInt("Read-Ahead Frames",16,1,256);
+  _play_recorded_rate = new VarBool("Play at Recorded Rate",true);
+  _settings_playback->addChild(_play_read_ahead);
+  _settings_playback->addChild(_play_recorded_rate);
 
   _settings->addChild(_max_frames);
+  _settings->addChild(_max_memory);
+  _settings->addChild(_compress);
   _settings->addChild(_shift_on_exceed);
   _settings->addChild(_settings_rec_continuous);
+  _settings->addChild(_settings_playback);
 
   slotModeToggled();
   slotSeekModeToggled();
@@ -492,9 +563,15 @@ ProcessResult PluginDVR::process(FrameData * data, RenderOptions * options) {
     status = "Pausing.";
   } else if (mode == DVRModeRecord) {
     if (is_recording || is_recording_continuous) {
-      status = "Recording mode. " + QString::number(stream.getFrameCount()) + " frames in buffer. ";
+      status = "Recording mode. " + QString::number(stream.getFrameCount()) + " frames in buffer ("
+               + QString::number(stream.getMemoryUsed() >> 20) + " MiB). ";
+      if (stream.getSkippedCount() > 0) {
+        status += QString::number(stream.getSkippedCount()) + " frames skipped. ";
+      }
 
       stream.setLimit(_max_frames->getInt());
+      stream.setMemoryLimit(_max_memory->getInt());
+      stream.setCompression(_compress->getBool());
 
       // Get detection frame connected to frame
       SSL_DetectionFrame* detection_frame = (SSL_DetectionFrame *)data->map.get("ssl_detection_frame");
@@ -502,35 +579,28 @@ ProcessResult PluginDVR::process(FrameData * data, RenderOptions * options) {
       // If recording is on, store the frame and possible detection_frame in the ringbuffers
       if (is_recording) {
         status = status + "Currently storing all frames. ";
-        stream.appendFrame(data, _shift_on_exceed->getBool());
-        if(detection_frame)
-          stream.appendDetectionFrame(detection_frame, _shift_on_exceed->getBool());
+        stream.appendFrame(data, _shift_on_exceed->getBool(), detection_frame);
       }
 
       // If continuous recording is on, store the frame and possible detection_frame on the disk
       if(is_recording_continuous) {
-        double fps_limit = _fps_limit->getDouble();
-        status += "Currently writing " + QString::number(fps_limit) + " frames per second to disk. ";
         // Check if enough time has passed to store the next frame and detection_frame
         auto now = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+        double fps_limit = _fps_limit->getDouble();
         double interval_ms = 1000 / fps_limit;
 
         if (!_fps_limit_enable->getBool() || interval_ms < now - rec_continuous_last_timestamp) {
-            rec_continuous_last_timestamp = now;
-            
-            // using namespace std::chrono;
-            // high_resolution_clock::time_point t1 = high_resolution_clock::now();
-            // std::cout << std::endl;
-            frame_writer->write(data, detection_frame);
-            // high_resolution_clock::time_point t2 = high_resolution_clock::now();
-            // duration<double> time_span = duration_cast<duration<double>>(t2 - t1);
-            // std::cout << "[plugin_dvr.cpp][process] Writing frame took " << time_span.count() * 1000 << " ms in main thread" << std::endl;
-            
+          rec_continuous_last_timestamp = now;
+          recorder->write(data->video, data->number, data->time, data->time_cam, detection_frame);
         }
+        status += "Writing to " + QString::fromStdString(recorder->getFileName()) + ": " +
+                  QString::number(recorder->getFramesWritten()) + " frames, " +
+                  QString::number(recorder->getBytesWritten() >> 20) + " MiB written, " +
+                  QString::number(recorder->getFramesDropped()) + " dropped. ";
       }
 
       // Update status text
-      if (stream.getFrameCount() >= stream.getLimit()) {
+      if (stream.getLimit() > 0 && stream.getFrameCount() >= stream.getLimit()) {
         if (_shift_on_exceed->getBool()) {
           status = status + " Past Max Frame Limit! Now Shift-Recoding!";
         } else {
@@ -565,30 +635,44 @@ ProcessResult PluginDVR::process(FrameData * data, RenderOptions * options) {
 
 
     if (seek_mode==SeekModePlay) {
-      stream.advance(1,w->btn_seek_wrap->isChecked());
+      if (reader && _play_recorded_rate->getBool()) {
+        advancePlaybackToTime(t,w->btn_seek_wrap->isChecked());
+      } else {
+        advancePlayback(1,w->btn_seek_wrap->isChecked());
+      }
     } else if (seek_mode==SeekModePause) {
       if (frames_advance_int!=0) {
-        stream.advance(frames_advance_int,w->btn_seek_wrap->isChecked());
+        advancePlayback(frames_advance_int,w->btn_seek_wrap->isChecked());
         advance_last_t=t;
       }
     }
-    if (stream.getFrameCount() <= 0 || seek_mode==SeekModeLive) {
+    int frame_count = getPlaybackFrameCount();
+    int frame_index = getPlaybackFrameIndex();
+    if (frame_count <= 0 || seek_mode==SeekModeLive) {
       stream_info = "Showing Live-View.";
     } else {
-      double percent = 100.0 * ((double)stream.getCurrentFrameIndex()+1) / ((double)(stream.getFrameCount()));
+      double percent = 100.0 * ((double)frame_index+1) / ((double)(frame_count));
       if (seek_mode==SeekModePause) {
-        stream_info = "Paused Playback at Frame " + QString::number(stream.getCurrentFrameIndex()+1) + "/" + QString::number(stream.getFrameCount()) + " (" + QString::number(percent,'f',2) + "%).";
+        stream_info = "Paused Playback at Frame " + QString::number(frame_index+1) + "/" + QString::number(frame_count) + " (" + QString::number(percent,'f',2) + "%).";
       } else {
-        stream_info = "Running Playback at Frame " + QString::number(stream.getCurrentFrameIndex()+1) + "/" + QString::number(stream.getFrameCount()) + " (" + QString::number(percent,'f',2) + "%).";
+        stream_info = "Running Playback at Frame " + QString::number(frame_index+1) + "/" + QString::number(frame_count) + " (" + QString::number(percent,'f',2) + "%).";
       }
     }
+    if (reader) {
+      stream_info += "\nPlaying " + QString::fromStdString(reader->getFileName());
+    }
   }
 
   //output data:
   if (mode==DVRModePause) {
     data->video.deepCopyFromRawImage(pause_frame.video,false);
   } else if (mode==DVRModeRecord) {
-    if (seek_mode!=SeekModeLive && stream.getFrameCount() > 0) {
+    if (seek_mode!=SeekModeLive && reader) {
+      const DVRReader::Frame * f = reader->getFrame(play_index);
+      if (f!=0) {
+        f->copyImageTo(data->video);
+      }
+    } else if (seek_mode!=SeekModeLive && stream.getFrameCount() > 0) {
       DVRFrame * f = stream.getCurrentFrame();
       if (f!=0) {
         data->video.deepCopyFromRawImage(f->video,false);
@@ -606,6 +690,53 @@ QWidget * PluginDVR::getControlWidget() {
   return w;
 }
 
+int PluginDVR::getPlaybackFrameCount() {
+  return reader ? reader->getFrameCount() : stream.getFrameCount();
+}
+
+int PluginDVR::getPlaybackFrameIndex() {
+  return reader ? play_index : stream.getCurrentFrameIndex();
+}
+
+void PluginDVR::seekPlayback(int frame) {
+  if (!reader) {
+    stream.seek(frame);
+    return;
+  }
+  // the index makes any frame a single read away
+  play_index=std::max(0, std::min(frame, reader->getFrameCount()-1));
+  play_anchor_valid=false;
+}
+
+void PluginDVR::advancePlayback(int frames, bool wrap) {
+  if (!reader) {
+    stream.advance(frames,wrap);
+    return;
+  }
+  int count=reader->getFrameCount();
+  int new_index=play_index+frames;
+  if (wrap) {
+    new_index=mod(new_index,count);
+  }
+  seekPlayback(new_index);
+}
+
+void PluginDVR::advancePlaybackToTime(double t, bool wrap) {
+  int count=reader->getFrameCount();
+  if (play_index >= count-1) {
+    if (wrap) seekPlayback(0);
+    return;
+  }
+  if (!play_anchor_valid) {
+    play_anchor_t=t;
+    play_anchor_time=reader->getFrameTime(play_index);
+    play_anchor_valid=true;
+    return;
+  }
+  // frames recorded in between are skipped when processing is slower than the recording
+  play_index=std::max(play_index, reader->findFrame(play_anchor_time + (t - play_anchor_t)));
+}
+
 
 
 
@@ -624,87 +755,257 @@ void DVRStream::saveStream(QString directory) {
 
 }
 
-void DVRStream::clear() {
-  for (int i = 0; i < frames.size(); i++) {
-    delete frames[i];
+// default slab size until setMemoryLimit() is called
+static const size_t kDefaultMemoryLimit = 1024ull << 20;
+
+DVRStream::DVRStream() {
+  slab_size=0;
+  memory_limit=kDefaultMemoryLimit;
+  first=0;
+  count=0;
+  next_id=1;
+  limit=0;
+  current=0;
+  skipped=0;
+  decoded_id=0;
+  compression=false;
+  running=true;
+  for (int i = 0; i < NumStagingBuffers; i++) {
+    free_jobs.push_back(&jobs[i]);
+  }
+  compressor = std::thread(&DVRStream::runCompressor, this);
+}
+
+DVRStream::~DVRStream() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running=false;
   }
-  frames.clear();
+  job_condition.notify_all();
+  compressor.join();
+}
+
+void DVRStream::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  first=0;
+  count=0;
   current=0;
+  skipped=0;
+  decoded_id=0;
 }
 
-void DVRStream::appendFrame(FrameData * data, bool shift_stream_on_limit_exceed) {
-  if (limit!=0 && ((getFrameCount() + 1) > limit)) {
-    if (shift_stream_on_limit_exceed) {
-      DVRFrame * f = frames[0];
-      delete f;
-      frames.removeFirst();
-      if (current > 0) current--;
-    } else {
-      return;
+void DVRStream::setMemoryLimit(int megabytes) {
+  size_t bytes = (size_t) std::max(1, megabytes) << 20;
+  std::lock_guard<std::mutex> lock(mutex);
+  if (bytes == memory_limit) return;
+  memory_limit=bytes;
+  first=0;
+  count=0;
+  current=0;
+  decoded_id=0;
+  // reallocated on the next frame
+  slab.reset();
+  slab_size=0;
+}
+
+void DVRStream::setCompression(bool enable) {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (enable == compression) return;
+  // let queued frames finish first, so that they stay in order
+  done_condition.wait(lock, [this] { return queued_jobs.empty() && (int) free_jobs.size() == NumStagingBuffers; });
+  compression=enable;
+}
+
+void DVRStream::removeOldest() {
+  first=(first + 1) % entries.size();
+  count--;
+  if (current > 0) current--;
+}
+
+bool DVRStream::reserve(size_t length, bool shift_stream_on_limit_exceed, size_t & offset) {
+  if (length > slab_size) return false;
+  // frames are kept back to back, either in [oldest, newest] or wrapped around the end of the slab
+  while (count > 0) {
+    const Entry & oldest = at(0);
+    const Entry & newest = at(count - 1);
+    size_t end = newest.offset + newest.length;
+    if (newest.offset >= oldest.offset) {
+      if (slab_size - end >= length) {
+        offset=end;
+        return true;
+      }
+      if (oldest.offset >= length) {
+        offset=0;
+        return true;
+      }
+    } else if (oldest.offset - end >= length) {
+      offset=end;
+      return true;
     }
+    if (!shift_stream_on_limit_exceed) return false;
+    removeOldest();
   }
-  DVRFrame * f = new DVRFrame();
-  f->getFromFrameData(data);
-  frames.append(f);
+  offset=0;
+  return true;
 }
 
-void DVRStream::appendDetectionFrame(SSL_DetectionFrame * frame, bool shift_stream_on_limit_exceed){
-  if (limit!=0 && ((getFrameCount() + 1) > limit)) {
-    if (shift_stream_on_limit_exceed) {
-      SSL_DetectionFrame * f = detection_frames[0];
-      delete f;
-      frames.removeFirst();
-      if (current > 0) current--;
-    } else {
-      return;
+DVRStream::Entry * DVRStream::append(const unsigned char * data, size_t length, bool compressed, size_t raw_size,
+                                     int width, int height, ColorFormat format, long long number, double time,
+                                     const SSL_DetectionFrame * detection, bool shift_stream_on_limit_exceed) {
+  if (slab_size != memory_limit) {
+    slab.reset(new unsigned char[memory_limit]);
+    slab_size=memory_limit;
+  }
+  if (limit!=0 && count >= limit) {
+    if (!shift_stream_on_limit_exceed) return nullptr;
+    while (count >= limit) removeOldest();
+  }
+  size_t offset;
+  size_t aligned = (length + 15) & ~((size_t) 15);
+  if (!reserve(aligned, shift_stream_on_limit_exceed, offset)) return nullptr;
+
+  if (count == (int) entries.size()) {
+    // grow the ring, keeping the oldest frame in front
+    std::rotate(entries.begin(), entries.begin() + first, entries.end());
+    first=0;
+    entries.resize(std::max((size_t) 16, entries.size() * 2));
+  }
+  Entry & e = at(count);
+  count++;
+  memcpy(slab.get() + offset, data, length);
+  e.id=next_id++;
+  e.offset=offset;
+  e.length=aligned;
+  e.raw_size=raw_size;
+  e.width=width;
+  e.height=height;
+  e.format=format;
+  e.compressed=compressed;
+  e.number=number;
+  e.time=time;
+  e.has_detection=detection != nullptr;
+  if (detection != nullptr) {
+    e.detection.CopyFrom(*detection);
+  }
+  return &e;
+}
+
+void DVRStream::appendFrame(FrameData * data, bool shift_stream_on_limit_exceed, const SSL_DetectionFrame * detection) {
+  const RawImage & video = data->video;
+  size_t size = video.getNumBytes() > 0 ? video.getNumBytes() : 0;
+
+  std::unique_lock<std::mutex> lock(mutex);
+  if (!compression) {
+    if (append(video.getData(), size, false, size, video.getWidth(), video.getHeight(), video.getColorFormat(),
+               data->number, data->time, detection, shift_stream_on_limit_exceed) == nullptr) {
+      skipped++;
     }
+    return;
+  }
+
+  if (free_jobs.empty()) {
+    skipped++;
+    return;
+  }
+  Job * job = free_jobs.back();
+  free_jobs.pop_back();
+  lock.unlock();
+
+  // the staging buffer belongs to this thread until it is queued
+  if (job->data.size() < size) job->data.resize(size);
+  memcpy(job->data.data(), video.getData(), size);
+  job->size=size;
+  job->width=video.getWidth();
+  job->height=video.getHeight();
+  job->format=video.getColorFormat();
+  job->number=data->number;
+  job->time=data->time;
+  job->has_detection=detection != nullptr;
+  if (detection != nullptr) {
+    job->detection.CopyFrom(*detection);
+  }
+  job->shift=shift_stream_on_limit_exceed;
+
+  lock.lock();
+  queued_jobs.push_back(job);
+  job_condition.notify_one();
+}
+
+void DVRStream::runCompressor() {
+  std::vector<unsigned char> buffer;
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    job_condition.wait(lock, [this] { return !queued_jobs.empty() || !running; });
+    if (!running) return;
+    Job * job = queued_jobs.front();
+    queued_jobs.pop_front();
+    lock.unlock();
+
+    size_t max_size = DeltaCodec::getMaxCompressedSize(job->size);
+    if (buffer.size() < max_size) buffer.resize(max_size);
+    size_t length = DeltaCodec::compress(job->data.data(), job->size, DeltaCodec::getPeriod(job->format), buffer.data());
+
+    lock.lock();
+    if (append(buffer.data(), length, true, job->size, job->width, job->height, job->format, job->number, job->time,
+               job->has_detection ? &job->detection : nullptr, job->shift) == nullptr) {
+      skipped++;
+    }
+    free_jobs.push_back(job);
+    done_condition.notify_all();
   }
-  SSL_DetectionFrame * f = new SSL_DetectionFrame();
-  f->CopyFrom(*frame);
-  detection_frames.append(f);
 }
 
 void DVRStream::seek(int frame) {
-  if (frame >= getFrameCount()) frame=getFrameCount()-1;
+  std::lock_guard<std::mutex> lock(mutex);
+  if (frame >= count) frame=count-1;
   if (frame < 0) frame=0;
   current=frame;
 }
 
 int DVRStream::getFrameCount() {
-  return frames.size();
+  std::lock_guard<std::mutex> lock(mutex);
+  return count;
 }
 
-void DVRStream::setLimit(int num_frames) {
-  limit=num_frames;
+int DVRStream::getSkippedCount() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return skipped;
 }
 
-int DVRStream::getLimit() {
-  return limit;
+size_t DVRStream::getMemoryUsed() {
+  std::lock_guard<std::mutex> lock(mutex);
+  size_t used = 0;
+  for (int i = 0; i < count; i++) {
+    used += at(i).length;
+  }
+  return used;
 }
 
-DVRStream::DVRStream() {
-  limit=0;
-  clear();
+void DVRStream::setLimit(int num_frames) {
+  std::lock_guard<std::mutex> lock(mutex);
+  limit=num_frames;
 }
 
-DVRStream::~DVRStream() {
- clear();
+int DVRStream::getLimit() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return limit;
 }
 
 void DVRStream::advance(int frames, bool wrap) {
-  if (getFrameCount() == 0) return;
+  std::lock_guard<std::mutex> lock(mutex);
+  if (count == 0) return;
   int new_current=current+frames;
-  int max_idx=getFrameCount()-1;
+  int max_idx=count-1;
   if (new_current < 0) {
     if (wrap) {
-      new_current=mod(new_current,getFrameCount());
+      new_current=mod(new_current,count);
     } else {
       new_current=0;
     }
   }
   if (new_current > max_idx) {
     if (wrap) {
-      new_current=mod(new_current,getFrameCount());
+      new_current=mod(new_current,count);
     } else {
       new_current=max_idx;
     }
@@ -713,28 +1014,49 @@ void DVRStream::advance(int frames, bool wrap) {
 }
 
 void DVRStream::advanceToMostRecent() {
-  current=getFrameCount()-1;
+  std::lock_guard<std::mutex> lock(mutex);
+  current=count-1;
 }
 
 int DVRStream::getCurrentFrameIndex() {
+  std::lock_guard<std::mutex> lock(mutex);
   return current;
 }
 
 DVRFrame * DVRStream::getCurrentFrame() {
-  if (current >= frames.size()) return 0;
-  return frames[current];
+  std::lock_guard<std::mutex> lock(mutex);
+  return decode(current);
 }
 
 DVRFrame * DVRStream::getFrame(int i) {
-  if (current >= frames.size()) return 0;
-  if (i < 0) return 0;
-  return frames[i];
+  std::lock_guard<std::mutex> lock(mutex);
+  return decode(i);
+}
+
+DVRFrame * DVRStream::decode(int i) {
+  if (i < 0 || i >= count) return 0;
+  const Entry & e = at(i);
+  if (e.id != decoded_id) {
+    decoded.video.ensure_allocation(e.format, e.width, e.height);
+    if ((size_t) decoded.video.getNumBytes() != e.raw_size) return 0;
+    if (e.compressed) {
+      DeltaCodec::decompress(slab.get() + e.offset, decoded.video.getData(), e.raw_size, DeltaCodec::getPeriod(e.format));
+    } else {
+      memcpy(decoded.video.getData(), slab.get() + e.offset, e.raw_size);
+    }
+    decoded.video.setTime(e.time);
+    decoded_id=e.id;
+  }
+  return &decoded;
 }
 
-SSL_DetectionFrame * DVRStream::getDetectionFrame(int i) {
-  if (current >= detection_frames.size()) return 0;
-  if (i < 0) return 0;
-  return detection_frames[i];
+bool DVRStream::getDetectionFrame(int i, SSL_DetectionFrame & detection) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (i < 0 || i >= count) return false;
+  const Entry & e = at(i);
+  if (!e.has_detection) return false;
+  detection.CopyFrom(e.detection);
+  return true;
 }
 
 
@@ -778,98 +1100,3 @@ void DVRUtils::saveDetectionFrame(const SSL_DetectionFrame& detection_frame, con
   json_file << json_string;
   json_file.close();
 }
-
-
-
-
-
-/* ===== DVRThreadSafeQueue ===== */
-
-DVRFrameData DVRThreadSafeQueue::dequeue() {
-  std::unique_lock<std::mutex> lock(queue_mutex);
-
-  // Releases the lock and wait until there is new element
-  broker.wait(lock, [&] {
-    return !queue.empty() || !running;
-  });
-
-  // Early return since queue might be empty
-  if (!running) return {};
-
-  auto data = std::move(queue.front());
-  queue.pop();
-  return data;
-}
-
-void DVRThreadSafeQueue::enqueue(DVRFrameData data) {
-  const std::lock_guard<std::mutex> lock(queue_mutex);
-  queue.push(std::move(data));
-  broker.notify_one();
-}
-
-void DVRThreadSafeQueue::stop() {
-  running = false;
-  broker.notify_one();
-}
-
-int DVRThreadSafeQueue::size() {
-  return queue.size();
-}
-
-
-
-
-
-/* ===== DVRNonBlockingWriter ===== */
-
-DVRNonBlockingWriter::DVRNonBlockingWriter(QString output_dir): output_dir(std::move(output_dir)){
-  std::cout << "[DVRNonBlockingWriter] New instance" << std::endl;
-  writer_thread = std::thread(&DVRNonBlockingWriter::runWriterOnLoop, this);
-}
-
-DVRNonBlockingWriter::~DVRNonBlockingWriter() {
-  if (writer_thread.joinable()) {
-    running = false;
-    data_buffer.stop();
-    writer_thread.join();
-  }
-  std::cout << "[DVRNonBlockingWriter] Instance destructed" << std::endl;
-}
-
-void DVRNonBlockingWriter::runWriterOnLoop() {
-  while(running) write();
-}
-
-/**
- * Called from secondary thread. Writes the frame to disk
-*/
-void DVRNonBlockingWriter::write() {
-  const auto data = data_buffer.dequeue();
-
-  // Early return in case, thread was stopped, since dequeue might return {} in that case
-  if (!running) return;
-
-  // using namespace std::chrono;
-  // high_resolution_clock::time_point t1 = high_resolution_clock::now();
-  DVRUtils::saveFrame(*data.frame_ptr, output_dir, index);
-  DVRUtils::saveDetectionFrame(data.detection_frame, output_dir, index);
-  // high_resolution_clock::time_point t2 = high_resolution_clock::now();
-  // duration<double> time_span = duration_cast<duration<double>>(t2 - t1);
-  // std::cout << "[DVRNonBlockingWriter] Writing frame " << index << " took " << time_span.count() * 1000 << " ms in secondary thread" << std::endl;
-
-  index++;
-}
-
-/**
- * Called from main thread. Deepcopies the frame and adds it to the queue to be written in the secondary thread
-*/
-void DVRNonBlockingWriter::write(FrameData* frameData, SSL_DetectionFrame* detectionFrame) {
-    std::unique_ptr<DVRFrame> frame_ptr = std::unique_ptr<DVRFrame>(new DVRFrame());
-    // Limit the number of frames in the queue to 1. This prevents memory from overflowing
-    if(data_buffer.size() == 0){
-      frame_ptr->getFromFrameData(frameData);
-      data_buffer.enqueue({std::move(frame_ptr), *detectionFrame });
-    }else{
-      std::cout << "[DVRNonBlockingWriter] Warning: a previous frame is already queued to be written. Please lower the 'DVR FPS Limit' in the settings. Skipping current frame.." << std::endl;
-    }
-}
@@ -39,7 +39,11 @@
 #include <QSpacerItem>
 #include <QToolButton>
 #include <QVBoxLayout>
+#include <algorithm>
 #include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <thread>
 #include <optional>
 
@@ -47,9 +51,10 @@
 #include "jog_dial.h"
 #include "rawimage.h"
 #include "timer.h"
+#include "dvr_recording.h"
+#include "delta_codec.h"
 
 class PluginDVR;
-class DVRNonBlockingWriter;
 
 class PluginDVRWidget : public QWidget
 {
@@ -73,6 +78,7 @@ class PluginDVRWidget : public QWidget
 
     QToolButton * btn_rec_new;
     QToolButton * btn_rec_load;
+    QToolButton * btn_rec_open;
     QToolButton * btn_rec_rec;
     QToolButton * btn_rec_continuous;
     QToolButton * btn_rec_save;
@@ -98,28 +104,109 @@ class DVRFrame
   void getFromFrameData(FrameData * data);
 };
 
+/*!
+  \class DVRStream
+  \brief In-memory ring of recorded frames
+
+  All frames are stored back to back in one preallocated slab, the oldest
+  frames are overwritten once it is full. With compression enabled, the
+  camera thread only copies the frame into one of a few staging buffers,
+  and a background thread compresses it with DeltaCodec into the slab.
+  Frames that find no free staging buffer are skipped and counted.
+
+  getFrame() decodes into a frame owned by the stream, which stays valid
+  until the next call.
+**/
 class DVRStream
 {
-  //TODO: add partial memory buffering for long video streams.
   protected:
-    QList<DVRFrame *> frames;
-    QList<SSL_DetectionFrame *> detection_frames;
+    class Entry {
+    public:
+      uint64_t id;
+      size_t offset;
+      size_t length;  // bytes in the slab
+      size_t raw_size;
+      int width;
+      int height;
+      ColorFormat format;
+      bool compressed;
+      long long number;
+      double time;
+      bool has_detection;
+      SSL_DetectionFrame detection;
+    };
+
+    class Job {
+    public:
+      std::vector<unsigned char> data;
+      size_t size;
+      int width;
+      int height;
+      ColorFormat format;
+      long long number;
+      double time;
+      bool has_detection;
+      SSL_DetectionFrame detection;
+      bool shift;
+    };
+
+    static const int NumStagingBuffers = 3;
+
+    std::mutex mutex;
+    // not value-initialized, pages are only touched when the ring reaches them
+    std::unique_ptr<unsigned char[]> slab;
+    size_t slab_size;
+    size_t memory_limit;
+    std::vector<Entry> entries;  // ring, the oldest frame is at first
+    int first;
+    int count;
+    uint64_t next_id;
     int limit;
     int current;
+    int skipped;
+
+    // playback
+    DVRFrame decoded;
+    uint64_t decoded_id;
+
+    // background compression
+    bool compression;
+    Job jobs[NumStagingBuffers];
+    std::vector<Job *> free_jobs;
+    std::deque<Job *> queued_jobs;
+    std::condition_variable job_condition;
+    std::condition_variable done_condition;
+    bool running;
+    std::thread compressor;
+
+    Entry & at(int i) {
+      return entries[(first + i) % entries.size()];
+    }
+    bool reserve(size_t length, bool shift_stream_on_limit_exceed, size_t & offset);
+    Entry * append(const unsigned char * data, size_t length, bool compressed, size_t raw_size,
+                   int width, int height, ColorFormat format, long long number, double time,
+                   const SSL_DetectionFrame * detection, bool shift_stream_on_limit_exceed);
+    void removeOldest();
+    DVRFrame * decode(int i);
+    void runCompressor();
 
   public:
     DVRStream();
     virtual ~DVRStream();
     int getLimit();
     void setLimit(int num_frames);
+    /// size of the slab, changing it clears the stream
+    void setMemoryLimit(int megabytes);
+    void setCompression(bool enable);
     bool loadStream(QString file);
     void newRecording(QString directory);
     void saveStream(QString directory);
     void clear();
-    void appendFrame(FrameData * data, bool shift_stream_on_limit_exceed);
-    void appendDetectionFrame(SSL_DetectionFrame * frame, bool shift_stream_on_limit_exceed);
+    void appendFrame(FrameData * data, bool shift_stream_on_limit_exceed, const SSL_DetectionFrame * detection = nullptr);
     void seek(int frame);
     int getFrameCount();
+    int getSkippedCount();
+    size_t getMemoryUsed();
     void advance(int frames, bool wrap);
     //void advance(double s, bool wrap);
     void advanceToMostRecent();
@@ -127,7 +214,8 @@ class DVRStream
     DVRFrame * getFrame(int i);
     DVRFrame * getCurrentFrame();
 
-    SSL_DetectionFrame * getDetectionFrame(int i);
+    /// copies the detection of frame i, entries may move or be overwritten once the lock is released
+    bool getDetectionFrame(int i, SSL_DetectionFrame & detection);
 };
 
 
@@ -137,47 +225,6 @@ class DVRUtils {
   static void saveDetectionFrame(const SSL_DetectionFrame& detection_frame, const QString& dir, int index);
 };
 
-struct DVRFrameData {
-  std::unique_ptr<DVRFrame> frame_ptr;
-  SSL_DetectionFrame detection_frame;
-};
-
-
-class DVRThreadSafeQueue
-{
- protected:
-  std::queue<DVRFrameData> queue;
-  std::mutex queue_mutex;
-  std::condition_variable broker;
-  std::atomic<bool> running = {true};
-
- public:
-  DVRFrameData dequeue();
-  void enqueue(DVRFrameData data);
-  void stop();
-  int size();
-};
-
-
-class DVRNonBlockingWriter
-{
- protected:
-  const QString output_dir;
-  std::thread writer_thread;
-  std::atomic<bool> running = {true};
-  DVRThreadSafeQueue data_buffer;
-  int index{};
-  void runWriterOnLoop();
-  void write();
-
- public:
-  explicit DVRNonBlockingWriter(QString output_dir);
-  ~DVRNonBlockingWriter();
-
-  void write(FrameData * frameData, SSL_DetectionFrame * frame);
-};
-
-
 /**
 	@author Stefan Zickler
 */
@@ -195,6 +242,7 @@ protected slots:
   void slotRecordContinuousToggled();
   void slotMovieNew();
   void slotMovieLoad();
+  void slotMovieOpen();
   void slotMovieSave();
   void jogValueChanged(float val);
 
@@ -216,9 +264,17 @@ protected:
   VarList * _settings;
   VarList * _settings_rec_continuous;
   VarInt * _max_frames;
+  VarInt * _max_memory;
+  VarBool * _compress;
   VarBool * _shift_on_exceed;
   VarBool * _fps_limit_enable;
   VarDouble * _fps_limit;
+  VarInt * _rec_pool_size;
+  VarInt * _rec_slab_size;
+  VarInt * _rec_writer_threads;
+  VarList * _settings_playback;
+  VarInt * _play_read_ahead;
+  VarBool * _play_recorded_rate;
   PluginDVRWidget * w;
 
   double advance_last_t;
@@ -231,9 +287,21 @@ protected:
   bool is_recording_continuous = false;
   long rec_continuous_last_timestamp = 0;
 
-  // std::variant<DVRNonBlockingWriter> would be preferable over allocating on heap,
-  // but is not available in c++11
-  std::unique_ptr<DVRNonBlockingWriter> frame_writer;
+  std::unique_ptr<DVRRecorder> recorder;
+
+  // Playback of a continuous recording from disk, replaces the in-memory stream while open
+  std::unique_ptr<DVRReader> reader;
+  int play_index = 0;
+  bool play_anchor_valid = false;
+  double play_anchor_t = 0.0;
+  double play_anchor_time = 0.0;
+
+  int getPlaybackFrameCount();
+  int getPlaybackFrameIndex();
+  void seekPlayback(int frame);
+  void advancePlayback(int frames, bool wrap);
+  /// advances the recording from disk to the frame recorded as long ago as t is after the anchor
+  void advancePlaybackToTime(double t, bool wrap);
 
 public:
 
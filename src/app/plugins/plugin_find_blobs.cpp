@@ -61,17 +61,23 @@ ProcessResult PluginFindBlobs::process(FrameData * data, RenderOptions * options
   }
 
   CMVision::RunList * runlist = (CMVision::RunList *) data->map.get("cmv_runlist");
-  if (runlist == nullptr) {
+  CMVision::CompactRunList * compact_runlist = (CMVision::CompactRunList *) data->map.get("cmv_runlist_compact");
+  if (runlist == nullptr && compact_runlist == nullptr) {
     printf("Blob finder: no runlength-encoded input list was found!\n");
     return ProcessingFailed;
   }
 
   if (_v_enable->getBool()) {
-    //Connect the components of the runlength map:
-    CMVision::RegionProcessing::connectComponents(runlist);
-
-    //Extract Regions from runlength map:
-    CMVision::RegionProcessing::extractRegions(reglist, runlist);
+    if (compact_runlist != nullptr) {
+      CMVision::RegionProcessing::connectComponents(compact_runlist);
+      CMVision::RegionProcessing::extractRegions(reglist, compact_runlist);
+    } else {
+      //Connect the components of the runlength map:
+      CMVision::RegionProcessing::connectComponents(runlist);
+
+      //Extract Regions from runlength map:
+      CMVision::RegionProcessing::extractRegions(reglist, runlist);
+    }
 
     if (reglist->getUsedRegions() == reglist->getMaxRegions()) {
       printf("Warning: FindBlobs: extract regions exceeded maximum number of %d regions\n",reglist->getMaxRegions());
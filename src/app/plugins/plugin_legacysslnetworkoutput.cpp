@@ -81,9 +81,17 @@ ProcessResult PluginLegacySSLNetworkOutput::process(
     }
     detection_frame->set_frame_number(data->number);
     detection_frame->set_camera_id(_camera_params.additional_calibration_information->camera_index->getInt());
-    detection_frame->set_t_sent(GetTimeSec());
     // The double-sized field server uses the normal field coordinates.
-    _ds_udp_server_old->sendLegacyMessage(*detection_frame);
+    // If the network output already encoded this frame, its bytes start with the legacy packet.
+    SSLDetectionPacket * packet = (SSLDetectionPacket *)data->map.get("ssl_detection_packet");
+    if (packet == nullptr) {
+      packet = (SSLDetectionPacket *)data->map.insert("ssl_detection_packet", new SSLDetectionPacket());
+    }
+    if (!packet->isEncoded(data->number)) {
+      detection_frame->set_t_sent(GetTimeSec());
+      packet->encode(*detection_frame, data->number);
+    }
+    _ds_udp_server_old->sendLegacyMessage(*packet);
   }
   return ProcessingOk;
 }
@@ -20,12 +20,51 @@
 //========================================================================
 #include "plugin_runlength_encode.h"
 
-PluginRunlengthEncode::PluginRunlengthEncode(FrameBuffer * _buffer)
- : VisionPlugin(_buffer)
+PluginRunlengthEncode::PluginRunlengthEncode(FrameBuffer * _buffer, LUT3D * lut)
+ : VisionPlugin(_buffer), has_region_filter(false), use_run_filter(false), values([this](Values & v) {
+     v.max_runs = v_max_runs->getInt();
+     v.compact_runs = v_compact_runs->getBool();
+     v.region_channels_only = v_region_channels_only->getBool();
+     v.noise_filter = v_noise_filter->getBool();
+     v.min_run_widths.clear();
+     for (VarInt * v_min_run_width : v_min_run_widths) {
+       v.min_run_widths.push_back(v_min_run_width->getInt());
+     }
+   })
 {
   settings=new VarList("Run length encode");
   v_max_runs = new VarInt("max runs", 50000, 10000, 1000000);
   settings->addChild(v_max_runs);
+  v_compact_runs = new VarBool("compact run table", false);
+  settings->addChild(v_compact_runs);
+  v_region_channels_only = new VarBool("region channels only", true);
+  settings->addChild(v_region_channels_only);
+
+  //runs narrower than the minimum width are dropped unless they continue a wide enough run of the row above
+  noise_settings = new VarList("Noise Filter");
+  settings->addChild(noise_settings);
+  v_noise_filter = new VarBool("enable", false);
+  noise_settings->addChild(v_noise_filter);
+  for (int i = 1; lut != nullptr && i < lut->getChannelCount(); i++) {
+    auto * v_min_run_width = new VarInt("min run width: " + lut->getChannel(i).label, 1, 1, 64);
+    noise_settings->addChild(v_min_run_width);
+    v_min_run_widths.push_back(v_min_run_width);
+  }
+
+  settings->addChild(statistics = new VarList("Statistics"));
+  statistics->addChild(v_runs_before = new VarInt("runs before noise filter", 0));
+  statistics->addChild(v_runs_after = new VarInt("runs after noise filter", 0));
+  statistics->addFlags(VARTYPE_FLAG_NOSTORE);
+  for (VarType* item : statistics->getChildren()) {
+    item->addFlags(VARTYPE_FLAG_READONLY | VARTYPE_FLAG_NOSTORE);
+  }
+  stats_start = std::chrono::steady_clock::now();
+
+  //the statistics change every second, so they are not bound
+  values.bind(v_max_runs);
+  values.bind(v_compact_runs);
+  values.bind(v_region_channels_only);
+  values.bind(noise_settings);
 }
 
 
@@ -33,17 +72,72 @@ PluginRunlengthEncode::~PluginRunlengthEncode()
 {
   delete settings;
   delete v_max_runs;
+  delete v_compact_runs;
+  delete v_region_channels_only;
+  delete noise_settings;
+  delete v_noise_filter;
+  for (VarInt * v_min_run_width : v_min_run_widths) {
+    delete v_min_run_width;
+  }
+  delete statistics;
+  delete v_runs_before;
+  delete v_runs_after;
+}
+
+void PluginRunlengthEncode::setRegionChannels(const std::vector<int> & channels) {
+  region_filter.setAllRegionColors(false);
+  for (int channel : channels) {
+    region_filter.setRegionColor(channel, true);
+  }
+  has_region_filter = true;
+  values.invalidate();
 }
 
+void PluginRunlengthEncode::updateRunFilter() {
+  bool region_channels_only = has_region_filter && values->region_channels_only;
+  if (region_channels_only) {
+    run_filter = region_filter;
+  } else {
+    run_filter.setAllRegionColors(true);
+  }
+  run_filter.clearMinWidths();
+  if (values->noise_filter) {
+    for (int i = 0; i < (int) values->min_run_widths.size(); i++) {
+      run_filter.setMinWidth(i + 1, values->min_run_widths[i]);
+    }
+  }
+  use_run_filter = region_channels_only || run_filter.hasMinWidths();
+}
+
+
 
+template <typename RunTable>
+void PluginRunlengthEncode::encode(FrameData * data, const string & label, Image<raw8> * img_thresholded) {
+  RunTable * runlist = (RunTable *) data->map.get(label);
+  if (runlist == nullptr || runlist->getMaxRuns() != values->max_runs) {
+    delete runlist;
+    runlist = (RunTable *) data->map.update(label, new RunTable(values->max_runs));
+  }
+
+  //Runlength Encode the image:
+  CMVision::RegionProcessing::encodeRuns(img_thresholded, runlist, use_run_filter ? &run_filter : nullptr);
+  if (runlist->getUsedRuns() == runlist->getMaxRuns()) {
+    printf("Warning: runlength encoder exceeded current max run size of %d\n",runlist->getMaxRuns());
+  }
+
+  auto now = std::chrono::steady_clock::now();
+  if (now - stats_start >= std::chrono::seconds(1)) {
+    v_runs_before->setInt(runlist->getUsedRuns() + runlist->getDroppedRuns());
+    v_runs_after->setInt(runlist->getUsedRuns());
+    stats_start = now;
+  }
+}
 
 ProcessResult PluginRunlengthEncode::process(FrameData * data, RenderOptions * options) {
   (void)options;
 
-  CMVision::RunList * runlist = (CMVision::RunList *) data->map.get("cmv_runlist");
-  if (runlist == nullptr || runlist->getMaxRuns() != v_max_runs->get()) {
-    delete runlist;
-    runlist = (CMVision::RunList *) data->map.update("cmv_runlist", new CMVision::RunList(v_max_runs->getInt()));
+  if (values.update()) {
+    updateRunFilter();
   }
 
   Image<raw8> * img_thresholded = (Image<raw8> *) data->map.get("cmv_threshold");
@@ -52,10 +146,13 @@ ProcessResult PluginRunlengthEncode::process(FrameData * data, RenderOptions * o
     return ProcessingFailed;
   }
 
-  //Runlength Encode the image:
-  CMVision::RegionProcessing::encodeRuns(img_thresholded, runlist);
-  if (runlist->getUsedRuns() == runlist->getMaxRuns()) {
-    printf("Warning: runlength encoder exceeded current max run size of %d\n",runlist->getMaxRuns());
+  //only one of the run tables is in the map, that is how the blob finder knows which one to use
+  if (values->compact_runs) {
+    delete (CMVision::RunList *) data->map.remove("cmv_runlist");
+    encode<CMVision::CompactRunList>(data, "cmv_runlist_compact", img_thresholded);
+  } else {
+    delete (CMVision::CompactRunList *) data->map.remove("cmv_runlist_compact");
+    encode<CMVision::RunList>(data, "cmv_runlist", img_thresholded);
   }
 
   return ProcessingOk;
@@ -23,7 +23,11 @@
 
 #include <visionplugin.h>
 #include "cmvision_region.h"
+#include "lut3d.h"
 #include "timer.h"
+#include "VarBinding.h"
+#include <chrono>
+#include <vector>
 
 /**
 	@author Stefan Zickler
@@ -33,8 +37,41 @@ class PluginRunlengthEncode : public VisionPlugin
 protected:
   VarList * settings;
   VarInt * v_max_runs;
+  VarBool * v_compact_runs;
+  VarBool * v_region_channels_only;
+  VarList * noise_settings;
+  VarBool * v_noise_filter;
+  std::vector<VarInt *> v_min_run_widths;  // per LUT channel, starting at channel 1
+  VarList * statistics;
+  VarInt * v_runs_before;
+  VarInt * v_runs_after;
+  std::chrono::steady_clock::time_point stats_start;
+
+  CMVision::RunColorFilter region_filter;
+  bool has_region_filter;
+  // region_filter combined with the noise filter settings, used by encodeRuns
+  CMVision::RunColorFilter run_filter;
+  bool use_run_filter;
+
+  struct Values {
+    int max_runs;
+    bool compact_runs;
+    bool region_channels_only;
+    bool noise_filter;
+    std::vector<int> min_run_widths;
+  };
+  VarBinding<Values> values;
+
+  void updateRunFilter();
+
+  template <typename RunTable>
+  void encode(FrameData * data, const string & label, Image<raw8> * img_thresholded);
 public:
-    explicit PluginRunlengthEncode(FrameBuffer * _buffer);
+    /// with a lut, the noise filter offers a minimum run width for each of its channels
+    explicit PluginRunlengthEncode(FrameBuffer * _buffer, LUT3D * lut = nullptr);
+
+    /// LUT channels that detectors need as regions, all others are encoded like clear pixels
+    void setRegionChannels(const std::vector<int> & channels);
 
     ~PluginRunlengthEncode() override;
 
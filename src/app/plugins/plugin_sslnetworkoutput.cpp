@@ -50,7 +50,14 @@ ProcessResult PluginSSLNetworkOutput::process(FrameData * data, RenderOptions *
     detection_frame->set_frame_number(data->number);
     detection_frame->set_camera_id(_camera_params.additional_calibration_information->camera_index->getInt());
     detection_frame->set_t_sent(GetTimeSec());
-    _udp_server->send(*detection_frame);
+
+    //the encoded packet is kept with the frame buffer, so the legacy output can reuse it
+    SSLDetectionPacket * packet = (SSLDetectionPacket *)data->map.get("ssl_detection_packet");
+    if (packet == nullptr) {
+      packet = (SSLDetectionPacket *)data->map.insert("ssl_detection_packet", new SSLDetectionPacket());
+    }
+    packet->encode(*detection_frame, data->number);
+    _udp_server->send(*packet);
   }
   return ProcessingOk;
 }
@@ -67,6 +74,9 @@ PluginSSLNetworkOutputSettings::PluginSSLNetworkOutputSettings()
   settings->addChild(multicast_port =
       new VarInt("Multicast Port",10006,1,65535));
   settings->addChild(multicast_interface = new VarString("Multicast Interface",""));
+  //local clients can read the same packets from shared memory instead of the network:
+  settings->addChild(shm_enable = new VarBool("Shared Memory Output",false));
+  settings->addChild(shm_name = new VarString("Shared Memory Name",RoboCupSSLShmRing::DefaultName));
 }
 
 VarList * PluginSSLNetworkOutputSettings::getSettings()
@@ -51,6 +51,8 @@ public:
   VarString * multicast_address;
   VarInt * multicast_port;
   VarString * multicast_interface;
+  VarBool * shm_enable;
+  VarString * shm_name;
 
   PluginSSLNetworkOutputSettings();
   VarList * getSettings();
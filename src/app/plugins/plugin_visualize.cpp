@@ -23,6 +23,7 @@
 #include <sobel.h>
 #include <opencv2/opencv.hpp>
 #include "convex_hull.h"
+#include "timer.h"
 #include <mutex>
 
 namespace {
@@ -52,6 +53,10 @@ PluginVisualize::PluginVisualize(
 
   _v_mask_hull = new VarBool("image mask hull", true);
 
+  // only rendered while the display is visible and has shown the previous frame
+  _v_max_rate = new VarDouble("max display rate (fps)", 30.0, 1.0, 1000.0);
+  _v_downscale = new VarInt("downscale factor", 1, 1, 8);
+
   _settings = new VarList("Visualization");
   _settings->addChild(_v_enabled);
   _settings->addChild(_v_image);
@@ -67,9 +72,13 @@ PluginVisualize::PluginVisualize(
   _settings->addChild(_v_complete_sobel);
   _settings->addChild(_v_mask_hull);
   _settings->addChild(_v_chessboard);
+  _settings->addChild(_v_max_rate);
+  _settings->addChild(_v_downscale);
   _threshold_lut=0;
   edge_image = 0;
   temp_grey_image = 0;
+  _last_render_t = 0.0;
+  _published_valid = false;
 }
 
 
@@ -90,7 +99,24 @@ void PluginVisualize::DrawCameraImage(
     FrameData* data, VisualizationFrame* vis_frame) {
   //if converting entire image then blanking is not needed
   const ColorFormat source_format = data->video.getColorFormat();
-  if (source_format == COLOR_RGB8) {
+  const int scale = vis_frame->scale;
+  if (scale > 1 && (source_format == COLOR_RGB8 || source_format == COLOR_YUV422_UYVY)) {
+    //only convert the pixels that are shown
+    rgb * vis_ptr = vis_frame->data.getPixelData();
+    const int w = vis_frame->data.getWidth();
+    const int h = vis_frame->data.getHeight();
+    for (int y = 0; y < h; y++) {
+      for (int x = 0; x < w; x++) {
+        *(vis_ptr++) = data->video.getRgb(x * scale, y * scale);
+      }
+    }
+  } else if (scale > 1 && source_format == COLOR_RAW8) {
+    cv::Mat src(data->video.getHeight(), data->video.getWidth(), CV_8UC1, data->video.getData());
+    //cvtColor only reallocates bayer_rgb when the frame size changes
+    cvtColor(src, bayer_rgb, cv::COLOR_BayerBG2BGR);
+    cv::Mat dst(vis_frame->data.getHeight(), vis_frame->data.getWidth(), CV_8UC3, vis_frame->data.getData());
+    cv::resize(bayer_rgb, dst, dst.size(), 0, 0, cv::INTER_NEAREST);
+  } else if (source_format == COLOR_RGB8) {
     //plain copy of data
     memcpy(vis_frame->data.getData(), data->video.getData(),
             data->video.getNumBytes());
@@ -134,19 +160,41 @@ void PluginVisualize::DrawThresholdedImage(
   if (_threshold_lut != 0) {
     Image<raw8>* img_thresholded =
         reinterpret_cast<Image<raw8>*>(data->map.get("cmv_threshold"));
-    if (img_thresholded != 0) {
-      int n = vis_frame->data.getNumPixels();
-      if (img_thresholded->getNumPixels() == n) {
-        rgb * vis_ptr = vis_frame->data.getPixelData();
-        raw8 * seg_ptr = img_thresholded->getPixelData();
-        for (int i = 0; i < n; i++) {
-          if (seg_ptr[i].getIntensity() != 0) {
-            vis_ptr[i] = _threshold_lut->getChannel(
-                seg_ptr[i].getIntensity()).draw_color;
-          }
+    if (img_thresholded == 0) {
+      return;
+    }
+    const int scale = vis_frame->scale;
+    const int w = vis_frame->data.getWidth();
+    const int h = vis_frame->data.getHeight();
+    const int seg_w = img_thresholded->getWidth();
+    if (seg_w < w * scale || img_thresholded->getHeight() < h * scale) {
+      return;
+    }
+
+    // the thresholded image is empty outside of the mask, so only the
+    // in-mask span of each row is looked at
+    _image_mask.lock();
+    const std::vector<ImageRowSpan> & spans = _image_mask.getRowSpans();
+    const bool use_spans = (int) spans.size() == img_thresholded->getHeight() &&
+                           _image_mask.getMask().getWidth() == seg_w;
+    for (int y = 0; y < h; y++) {
+      int start = 0;
+      int end = w;
+      if (use_spans) {
+        const ImageRowSpan & span = spans[y * scale];
+        start = std::min(w, (span.start + scale - 1) / scale);
+        end = std::min(w, (span.end + scale - 1) / scale);
+      }
+      rgb * vis_ptr = vis_frame->data.getPixelData() + y * w;
+      raw8 * seg_ptr = img_thresholded->getPixelData() + y * scale * seg_w;
+      for (int x = start; x < end; x++) {
+        unsigned char c = seg_ptr[x * scale].getIntensity();
+        if (c != 0) {
+          vis_ptr[x] = _threshold_lut->getChannel(c).draw_color;
         }
       }
     }
+    _image_mask.unlock();
   }
 }
 
@@ -167,13 +215,13 @@ void PluginVisualize::DrawBlobs(
       }
       CMVision::Region * blob=regionlist[i].getInitialElement();
       while (blob != 0) {
-        vis_frame->data.drawLine(
+        vis_frame->drawLine(
             blob->x1,blob->y1,blob->x2,blob->y1,blob_draw_color);
-        vis_frame->data.drawLine(
+        vis_frame->drawLine(
             blob->x1,blob->y1,blob->x1,blob->y2,blob_draw_color);
-        vis_frame->data.drawLine(
+        vis_frame->drawLine(
             blob->x1,blob->y2,blob->x2,blob->y2,blob_draw_color);
-        vis_frame->data.drawLine(
+        vis_frame->drawLine(
             blob->x2,blob->y1,blob->x2,blob->y2,blob_draw_color);
         blob = blob->next;
       }
@@ -195,8 +243,8 @@ void PluginVisualize::DrawCameraCalibration(
     x = (int) camera_parameters.principal_point_x->getDouble();
     y = (int) camera_parameters.principal_point_y->getDouble();
   }
-  vis_frame->data.drawFatLine(x-15, y-15, x+15, y+15, ppoint_draw_color);
-  vis_frame->data.drawFatLine(x+15, y-15, x-15, y+15, ppoint_draw_color);
+  vis_frame->drawFatLine(x-15, y-15, x+15, y+15, ppoint_draw_color);
+  vis_frame->drawFatLine(x+15, y-15, x-15, y+15, ppoint_draw_color);
   // Calibration points
   rgb cpoint_draw_color;
   cpoint_draw_color.set(0,255,255);
@@ -205,18 +253,18 @@ void PluginVisualize::DrawCameraCalibration(
         control_point_image_xs[i]->getDouble();
     const int by = camera_parameters.additional_calibration_information->
         control_point_image_ys[i]->getDouble();
-    vis_frame->data.drawFatBox(bx - 5, by - 5, 11, 11, cpoint_draw_color);
+    vis_frame->drawFatBox(bx - 5, by - 5, 11, 11, cpoint_draw_color);
     const string label =
         camera_parameters.additional_calibration_information->
         control_point_names[i]->getString();
-    vis_frame->data.drawString(bx - 5, by + 15, label, cpoint_draw_color);
+    vis_frame->drawString(bx - 5, by + 15, label, cpoint_draw_color);
 
     char buff[20];
     snprintf(buff, sizeof(buff), "(%.0f,%.0f)",
              camera_parameters.additional_calibration_information->control_point_field_xs[i]->getDouble(),
              camera_parameters.additional_calibration_information->control_point_field_ys[i]->getDouble());
     std::string description = buff;
-    vis_frame->data.drawString(bx + 10, by - 2, description, cpoint_draw_color);
+    vis_frame->drawString(bx + 10, by - 2, description, cpoint_draw_color);
   }
 }
 
@@ -229,10 +277,10 @@ void PluginVisualize::DrawCameraCalibrationMarkers(
     for (const auto &point : camera_parameters.extrinsic_parameters->getCalibImagePoints()) {
       int px = (int) point.x - size/2;
       int py = (int) point.y - size/2;
-      vis_frame->data.drawBox(px, py, size, size, color);
+      vis_frame->drawBox(px, py, size, size, color);
       int pfx = (int) point.x - sizeFat/2;
       int pfy = (int) point.y - sizeFat/2;
-      vis_frame->data.drawFatBox(pfx, pfy, sizeFat, sizeFat, color);
+      vis_frame->drawFatBox(pfx, pfy, sizeFat, sizeFat, color);
     }
   }
 }
@@ -348,7 +396,7 @@ void PluginVisualize::DrawEdgeTangent(
       image_point + (image_point_plus_tangent - image_point).norm(6.0);
   const GVector::vector2d<double> edge_p2 =
       image_point - (image_point_plus_tangent - image_point).norm(6.0);
-  vis_frame->data.drawLine(edge_p1.x, edge_p1.y,
+  vis_frame->drawLine(edge_p1.x, edge_p1.y,
                             edge_p2.x, edge_p2.y, edge_draw_color);
 }
 
@@ -363,7 +411,7 @@ void PluginVisualize::DrawDetectedEdges(
       if (!(segment.points[edge].detected)) continue;
       const GVector::vector2d<double>& image_point = segment.points[edge].img_point;
       const GVector::vector2d<double>& image_closest_point = segment.points[edge].img_closestPointToSegment;
-      vis_frame->data.drawBox(
+      vis_frame->drawBox(
           image_point.x - 5, image_point.y - 5, 11, 11, edge_draw_color);
       const double alpha = segment.alphas[edge];
       if (segment.straightLine) {
@@ -374,7 +422,7 @@ void PluginVisualize::DrawDetectedEdges(
         DrawEdgeTangent(image_point, field_point, field_tangent, vis_frame,
                         edge_draw_color);
         if (image_closest_point.nonzero()) {
-          vis_frame->data.drawLine((int)image_point.x,
+          vis_frame->drawLine((int)image_point.x,
                                    (int)image_point.y,
                                    (int)image_closest_point.x,
                                    (int)image_closest_point.y,
@@ -441,11 +489,11 @@ void PluginVisualize::DrawMaskHull(
   auto mask_ch = _image_mask.getConvexHull();
   for (auto it = mask_ch.begin(); it != mask_ch.end(); ++it) {
     const GVector::vector2d<int> &a = *it;
-    vis_frame->data.drawFatBox(a.x - 3, a.y - 3, 7, 7, RGB::Orange);
+    vis_frame->drawFatBox(a.x - 3, a.y - 3, 7, 7, RGB::Orange);
 
     const GVector::vector2d<int> &b =
       std::next(it) != mask_ch.end() ? *std::next(it) : *mask_ch.begin();
-    vis_frame->data.drawLine(a.x, a.y, b.x, b.y, RGB::Orange);
+    vis_frame->drawLine(a.x, a.y, b.x, b.y, RGB::Orange);
   }
   _image_mask.unlock();
 }
@@ -454,73 +502,87 @@ ProcessResult PluginVisualize::process(
     FrameData* data, RenderOptions* options) {
   if (data == 0) return ProcessingFailed;
 
-  VisualizationFrame* vis_frame =
-      reinterpret_cast<VisualizationFrame*>(data->map.get("vis_frame"));
-  if (vis_frame == 0) {
-    vis_frame = reinterpret_cast<VisualizationFrame*>(
-        data->map.insert("vis_frame",new VisualizationFrame()));
-  }
-
-  if (_v_enabled->getBool()) {
-    //check video data...
-    if (data->video.getWidth() == 0 || data->video.getHeight()==0) {
-      //there is no valid video data
-      //mark visualization data as invalid
-      vis_frame->valid = false;
-      return ProcessingOk;
-    } else {
-      //allocate visualization frame accordingly:
-      vis_frame->data.allocate(data->video.getWidth(), data->video.getHeight());
+  if (!_v_enabled->getBool()) {
+    //let the display clear the image once
+    if (_published_valid) {
+      _output.getBackFrame()->valid = false;
+      _output.publish();
+      _published_valid = false;
     }
+    return ProcessingOk;
+  }
 
-    // Draw camera image
-    if (_v_image->getBool()) {
-      DrawCameraImage(data, vis_frame);
-    } else {
-      vis_frame->data.fillBlack();
-    }
+  //render on demand of the display, at most at the display rate
+  double t = GetTimeSec();
+  if (!_output.wantsFrame() || t - _last_render_t < 1.0 / _v_max_rate->getDouble()) {
+    return ProcessingOk;
+  }
+  _last_render_t = t;
+  VisualizationFrame* vis_frame = _output.getBackFrame();
 
-    // Draw color-thresholded image.
-    if (_v_thresholded->getBool()) {
-      DrawThresholdedImage(data, vis_frame);
-    }
+  //check video data...
+  if (data->video.getWidth() == 0 || data->video.getHeight()==0) {
+    //there is no valid video data
+    //mark visualization data as invalid
+    vis_frame->valid = false;
+    _output.publish();
+    _published_valid = false;
+    return ProcessingOk;
+  } else {
+    //full resolution is needed by the per-pixel calibration views
+    vis_frame->scale = (_v_complete_sobel->getBool() || _v_chessboard->getBool()) ? 1 : _v_downscale->getInt();
+    //allocate visualization frame accordingly:
+    vis_frame->data.allocate(data->video.getWidth() / vis_frame->scale,
+                             data->video.getHeight() / vis_frame->scale);
+  }
 
-    //draw blob finding results:
-    if (_v_blobs->getBool()) {
-      DrawBlobs(data, vis_frame);
-    }
+  // Draw camera image
+  if (_v_image->getBool()) {
+    DrawCameraImage(data, vis_frame);
+  } else {
+    vis_frame->data.fillBlack();
+  }
 
-    // Camera calibration
-    if (_v_camera_calibration->getBool()) {
-      DrawCameraCalibration(data, vis_frame);
-    }
+  // Draw color-thresholded image.
+  if (_v_thresholded->getBool()) {
+    DrawThresholdedImage(data, vis_frame);
+  }
 
-    // Camera calibration
-    if (_v_camera_calibration_markers->getBool()) {
-      DrawCameraCalibrationMarkers(data, vis_frame);
-    }
+  //draw blob finding results:
+  if (_v_blobs->getBool()) {
+    DrawBlobs(data, vis_frame);
+  }
 
-    // Result of camera calibration, draws field to image
-    if (_v_calibration_result->getBool()) {
-      DrawCalibrationResult(data, vis_frame);
-    }
+  // Camera calibration
+  if (_v_camera_calibration->getBool()) {
+    DrawCameraCalibration(data, vis_frame);
+  }
 
-    // Test edge detection for calibration
-    if (_v_complete_sobel->getBool()) {
-      DrawSobelImage(data, vis_frame);
-    }
+  // Camera calibration
+  if (_v_camera_calibration_markers->getBool()) {
+    DrawCameraCalibrationMarkers(data, vis_frame);
+  }
 
-    // Result of edge detection for second calibration step
-    if (_v_detected_edges->getBool()) {
-      DrawDetectedEdges(data, vis_frame);
-    }
-    if(_v_mask_hull->getBool()) {
-      DrawMaskHull(data, vis_frame);
-    }
-    vis_frame->valid = true;
-  } else {
-    vis_frame->valid = false;
+  // Result of camera calibration, draws field to image
+  if (_v_calibration_result->getBool()) {
+    DrawCalibrationResult(data, vis_frame);
+  }
+
+  // Test edge detection for calibration
+  if (_v_complete_sobel->getBool()) {
+    DrawSobelImage(data, vis_frame);
+  }
+
+  // Result of edge detection for second calibration step
+  if (_v_detected_edges->getBool()) {
+    DrawDetectedEdges(data, vis_frame);
+  }
+  if(_v_mask_hull->getBool()) {
+    DrawMaskHull(data, vis_frame);
   }
+  vis_frame->valid = true;
+  _output.publish();
+  _published_valid = true;
   return ProcessingOk;
 }
 
@@ -546,7 +608,7 @@ void PluginVisualize::drawFieldArc(
     camera_parameters.field2image(nextInWorld, nextInImage);
     rgb draw_color;
     draw_color.set(r,g,b);
-    vis_frame->data.drawFatLine(
+    vis_frame->drawFatLine(
         lastInImage.x,lastInImage.y,nextInImage.x,nextInImage.y,draw_color);
     lastInWorld = nextInWorld;
     lastInImage = nextInImage;
@@ -569,7 +631,7 @@ void PluginVisualize::drawFieldLine(
     camera_parameters.field2image(nextInWorld, nextInImage);
     rgb draw_color;
     draw_color.set(r,g,b);
-    vis_frame->data.drawFatLine(
+    vis_frame->drawFatLine(
         lastInImage.x,lastInImage.y,nextInImage.x,nextInImage.y,draw_color);
 
     lastInWorld = nextInWorld;
@@ -605,7 +667,7 @@ void PluginVisualize::DrawChessboardCalibrationPoints(FrameData *data, Visualiza
     for (const auto &point : points) {
       int x = (int) point.x - size/2;
       int y = (int) point.y - size/2;
-      vis_frame->data.drawBox(x, y, size, size, color);
+      vis_frame->drawBox(x, y, size, size, color);
     }
   }
 }
@@ -30,6 +30,9 @@
 #include "field.h"
 #include "plugin_mask.h"
 #include "convex_hull_image_mask.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 
 /**
 	@author Stefan Zickler
@@ -46,8 +49,79 @@ class VisualizationFrame {
   public:
     rgbImage data;
     bool valid;
+    /// camera image pixels per visualization pixel in each direction
+    int scale;
     VisualizationFrame() {
       valid=false;
+      scale=1;
+    }
+
+    // drawing in camera image coordinates, independent of the scale
+    void drawLine(int x0, int y0, int x1, int y1, rgb val) {
+      data.drawLine(x0/scale, y0/scale, x1/scale, y1/scale, val);
+    }
+    void drawFatLine(int x0, int y0, int x1, int y1, rgb val) {
+      data.drawFatLine(x0/scale, y0/scale, x1/scale, y1/scale, val);
+    }
+    void drawBox(int x, int y, int width, int height, rgb val) {
+      data.drawBox(x/scale, y/scale, std::max(1, width/scale), std::max(1, height/scale), val);
+    }
+    void drawFatBox(int x, int y, int width, int height, rgb val) {
+      data.drawFatBox(x/scale, y/scale, std::max(1, width/scale), std::max(1, height/scale), val);
+    }
+    void drawString(int x, int y, const std::string & s, rgb val) {
+      data.drawString(x/scale, y/scale, s, val);
+    }
+};
+
+/*!
+  \class VisualizationOutput
+  \brief Hands rendered visualization frames from a stack to its display
+
+  The plugin renders into the back frame and publishes it, the display
+  draws the front frame. A new frame is only wanted while the display is
+  visible and has drawn the previously published one, so hidden or
+  minimized displays and displays that fall behind cost no rendering.
+*/
+class VisualizationOutput {
+  protected:
+    std::mutex mutex;
+    VisualizationFrame frames[2];
+    int front;
+    std::atomic<bool> visible;
+    std::atomic<unsigned long> published;
+    std::atomic<unsigned long> displayed;
+  public:
+    VisualizationOutput() : front(0), visible(true), published(0), displayed(0) {}
+
+    void setVisible(bool v) {
+      visible=v;
+    }
+    bool wantsFrame() const {
+      return visible && displayed == published;
+    }
+    unsigned long getPublished() const {
+      return published;
+    }
+
+    /// only used by the rendering thread
+    VisualizationFrame * getBackFrame() {
+      return &frames[1-front];
+    }
+    void publish() {
+      std::lock_guard<std::mutex> lock(mutex);
+      front=1-front;
+      published++;
+    }
+
+    /// the front frame stays valid until unlockFront()
+    VisualizationFrame * lockFront() {
+      mutex.lock();
+      return &frames[front];
+    }
+    void unlockFront(bool was_displayed) {
+      if (was_displayed) displayed=published.load();
+      mutex.unlock();
     }
 };
 
@@ -69,6 +143,8 @@ protected:
   VarBool * _v_detected_edges;
   VarBool * _v_mask_hull;
   VarBool * _v_chessboard;
+  VarDouble * _v_max_rate;
+  VarInt * _v_downscale;
 
   const CameraParameters& camera_parameters;
   const RoboCupField& real_field;
@@ -77,6 +153,11 @@ protected:
   LUT3D * _threshold_lut;
   greyImage* edge_image;
   greyImage* temp_grey_image;
+  cv::Mat bayer_rgb;  // full size demosaic of a downscaled RAW8 frame, reused across frames
+
+  VisualizationOutput _output;
+  double _last_render_t;
+  bool _published_valid;
 
   void drawFieldArc(
       const GVector::vector3d<double>& center,
@@ -126,6 +207,9 @@ public:
    ProcessResult process(FrameData * data, RenderOptions * options) override;
    VarList * getSettings() override;
    string getName() override;
+   VisualizationOutput * getOutput() {
+     return &_output;
+   }
 };
 
 #endif
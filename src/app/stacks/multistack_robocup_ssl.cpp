@@ -25,7 +25,12 @@
 MultiStackRoboCupSSL::MultiStackRoboCupSSL(RenderOptions *_opts, int num_normal_camera_threads) :
     MultiVisionStack("RoboCup SSL Multi-Cam",_opts),
     ds_udp_server_new(NULL),
-    ds_udp_server_old(NULL) {
+    ds_udp_server_old(NULL),
+    udp_sender(NULL),
+    tracker_udp_server(NULL),
+    tracker(NULL),
+    merger_udp_server(NULL),
+    merger(NULL) {
   //add global field calibration parameter
   global_field = new RoboCupField();
   settings->addChild(global_field->getSettings());
@@ -56,6 +61,14 @@ MultiStackRoboCupSSL::MultiStackRoboCupSSL(RenderOptions *_opts, int num_normal_
           SIGNAL(wasEdited(VarType *)),
           this,
           SLOT(RefreshNetworkOutput()));
+  connect(global_network_output_settings->shm_enable,
+          SIGNAL(wasEdited(VarType *)),
+          this,
+          SLOT(RefreshNetworkOutput()));
+  connect(global_network_output_settings->shm_name,
+          SIGNAL(wasEdited(VarType *)),
+          this,
+          SLOT(RefreshNetworkOutput()));
 
   legacy_network_output_settings = new PluginLegacySSLNetworkOutputSettings();
   settings->addChild(legacy_network_output_settings->getSettings());
@@ -72,8 +85,58 @@ MultiStackRoboCupSSL::MultiStackRoboCupSSL(RenderOptions *_opts, int num_normal_
           this,
           SLOT(RefreshLegacyNetworkOutput()));
 
+  udp_sender = new UDPSender();
+  global_network_output_settings->getSettings()->addChild(udp_sender->getSettings());
+  //socket options are applied when the servers are reopened:
+  for (VarType * item : udp_sender->getSettings()->getChildren()) {
+    connect(item, SIGNAL(wasEdited(VarType *)), this, SLOT(RefreshNetworkOutput()));
+    connect(item, SIGNAL(wasEdited(VarType *)), this, SLOT(RefreshLegacyNetworkOutput()));
+  }
+
   ds_udp_server_new = new RoboCupSSLServer(10006, "224.5.23.2");
   ds_udp_server_old = new RoboCupSSLServer(10005, "224.5.23.2");
+  ds_udp_server_new->setSender(udp_sender);
+  ds_udp_server_old->setSender(udp_sender);
+
+  tracker_udp_server = new RoboCupSSLServer(10010, "224.5.23.2");
+  tracker_udp_server->setSender(udp_sender);
+  tracker = new DetectionTracker(tracker_udp_server);
+  settings->addChild(tracker->getSettings());
+  connect(tracker->getPort(),
+          SIGNAL(wasEdited(VarType *)),
+          this,
+          SLOT(RefreshTrackerOutput()));
+  connect(tracker->getAddress(),
+          SIGNAL(wasEdited(VarType *)),
+          this,
+          SLOT(RefreshTrackerOutput()));
+  connect(tracker->getInterface(),
+          SIGNAL(wasEdited(VarType *)),
+          this,
+          SLOT(RefreshTrackerOutput()));
+  for (VarType * item : udp_sender->getSettings()->getChildren()) {
+    connect(item, SIGNAL(wasEdited(VarType *)), this, SLOT(RefreshTrackerOutput()));
+  }
+
+  merger_udp_server = new RoboCupSSLServer(10020, "224.5.23.2");
+  merger_udp_server->setSender(udp_sender);
+  merger = new DetectionMerger(merger_udp_server);
+  settings->addChild(merger->getSettings());
+  connect(merger->getPort(),
+          SIGNAL(wasEdited(VarType *)),
+          this,
+          SLOT(RefreshMergedOutput()));
+  connect(merger->getAddress(),
+          SIGNAL(wasEdited(VarType *)),
+          this,
+          SLOT(RefreshMergedOutput()));
+  connect(merger->getInterface(),
+          SIGNAL(wasEdited(VarType *)),
+          this,
+          SLOT(RefreshMergedOutput()));
+  for (VarType * item : udp_sender->getSettings()->getChildren()) {
+    connect(item, SIGNAL(wasEdited(VarType *)), this, SLOT(RefreshMergedOutput()));
+  }
 
   global_plugin_publish_geometry = new  PluginPublishGeometry(
       0,
@@ -110,6 +173,8 @@ MultiStackRoboCupSSL::MultiStackRoboCupSSL(RenderOptions *_opts, int num_normal_
             global_team_selector_yellow,
             ds_udp_server_new,
             ds_udp_server_old,
+            tracker,
+            merger,
             "robocup-ssl-cam-" + QString::number(i).toStdString()));
   }
 
@@ -135,6 +200,16 @@ string MultiStackRoboCupSSL::getSettingsFileName() {
 
 MultiStackRoboCupSSL::~MultiStackRoboCupSSL() {
   stop();
+  //the sender drains its queue, so delete it while the sockets are still open
+  ds_udp_server_new->setSender(NULL);
+  ds_udp_server_old->setSender(NULL);
+  tracker_udp_server->setSender(NULL);
+  merger_udp_server->setSender(NULL);
+  delete udp_sender;
+  delete tracker;
+  delete tracker_udp_server;
+  delete merger;
+  delete merger_udp_server;
   delete ds_udp_server_new;
   delete ds_udp_server_old;
   delete global_plugin_publish_geometry;
@@ -146,8 +221,9 @@ void MultiStackRoboCupSSL::UpdateServerSettings(const int port,
                           const string& address,
                           const string& interface,
                           const string& server_name,
-                          RoboCupSSLServer* server) {
-  server->mutex.lock();
+                          RoboCupSSLServer* server,
+                          const string& shm_name) {
+  server->lock.lockForWrite();
   server->close();
   server->_port = port;
   server->_net_address = address;
@@ -158,7 +234,14 @@ void MultiStackRoboCupSSL::UpdateServerSettings(const int port,
             server_name.c_str());
     fflush(stderr);
   }
-  server->mutex.unlock();
+  server->closeSharedMemory();
+  if (!shm_name.empty() && server->openSharedMemory(shm_name)==false) {
+    fprintf(stderr,
+            "ERROR WHEN TRYING TO OPEN SHARED MEMORY OUTPUT FOR %s!\n",
+            server_name.c_str());
+    fflush(stderr);
+  }
+  server->lock.unlock();
 }
 
 void MultiStackRoboCupSSL::RefreshLegacyNetworkOutput() {
@@ -182,6 +265,30 @@ void MultiStackRoboCupSSL::RefreshNetworkOutput()
       global_network_output_settings->multicast_address->getString(),
       global_network_output_settings->multicast_interface->getString(),
       "DOUBLE-SIZE FIELD (NEW FORMAT)",
-      ds_udp_server_new
+      ds_udp_server_new,
+      global_network_output_settings->shm_enable->getBool() ?
+          global_network_output_settings->shm_name->getString() : ""
+  );
+}
+
+void MultiStackRoboCupSSL::RefreshTrackerOutput()
+{
+  UpdateServerSettings(
+      tracker->getPort()->getInt(),
+      tracker->getAddress()->getString(),
+      tracker->getInterface()->getString(),
+      "TRACKER",
+      tracker_udp_server
+  );
+}
+
+void MultiStackRoboCupSSL::RefreshMergedOutput()
+{
+  UpdateServerSettings(
+      merger->getPort()->getInt(),
+      merger->getAddress()->getString(),
+      merger->getInterface()->getString(),
+      "MERGED OUTPUT",
+      merger_udp_server
   );
 }
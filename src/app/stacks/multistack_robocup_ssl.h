@@ -28,6 +28,9 @@
 #include "plugin_publishgeometry.h"
 #include "cmpattern_teamdetector.h"
 #include "robocup_ssl_server.h"
+#include "udp_sender.h"
+#include "detection_tracker.h"
+#include "detection_merger.h"
 #include "field.h"
 using namespace std;
 
@@ -53,6 +56,14 @@ class MultiStackRoboCupSSL : public QObject, public MultiVisionStack {
   RoboCupSSLServer * ds_udp_server_new;
   // UDP Server for Double-Sized field, old protobuf format.
   RoboCupSSLServer * ds_udp_server_old;
+  // Sends the datagrams of both servers off the camera threads.
+  UDPSender * udp_sender;
+  // Publishes the tracked objects of all cameras.
+  RoboCupSSLServer * tracker_udp_server;
+  DetectionTracker * tracker;
+  // Publishes one deduplicated frame of all cameras per period.
+  RoboCupSSLServer * merger_udp_server;
+  DetectionMerger * merger;
   public:
   MultiStackRoboCupSSL(RenderOptions *_opts, int num_normal_camera_threads);
   virtual string getSettingsFileName();
@@ -60,12 +71,15 @@ class MultiStackRoboCupSSL : public QObject, public MultiVisionStack {
   public slots:
   void RefreshNetworkOutput();
   void RefreshLegacyNetworkOutput();
+  void RefreshTrackerOutput();
+  void RefreshMergedOutput();
   private:
   void UpdateServerSettings(const int port,
                             const string& address,
                             const string& interface,
                             const string& server_name,
-                            RoboCupSSLServer* server);
+                            RoboCupSSLServer* server,
+                            const string& shm_name="");
 };
 
 #endif
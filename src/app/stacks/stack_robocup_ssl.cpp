@@ -34,6 +34,8 @@ StackRoboCupSSL::StackRoboCupSSL(
     CMPattern::TeamSelector * _global_team_selector_yellow,
     RoboCupSSLServer * ds_udp_server_new,
     RoboCupSSLServer * ds_udp_server_old,
+    DetectionTracker * tracker,
+    DetectionMerger * merger,
     string cam_settings_filename) :
     VisionStack(_opts),
     _camera_id(camera_id),
@@ -44,7 +46,9 @@ StackRoboCupSSL::StackRoboCupSSL(
     global_team_selector_blue(_global_team_selector_blue),
     global_team_selector_yellow(_global_team_selector_yellow),
     _ds_udp_server_new(ds_udp_server_new),
-    _ds_udp_server_old(ds_udp_server_old) {
+    _ds_udp_server_old(ds_udp_server_old),
+    _tracker(tracker),
+    _merger(merger) {
   (void)_fb;
   lut_yuv = new YUVLUT(4,6,6,cam_settings_filename + "-lut-yuv.xml");
   lut_yuv->loadRoboCupChannels(LUTChannelMode_Numeric);
@@ -74,7 +78,18 @@ StackRoboCupSSL::StackRoboCupSSL(
   stack.push_back(
       new PluginCameraIntrinsicCalibration(_fb, *camera_parameters));
 
-  stack.push_back(new PluginRunlengthEncode(_fb));
+  // Field green and black are only read from the thresholded image, by the
+  // histograms of the ball and robot detectors, all other channels are needed
+  // as regions: the ball color is configurable and markers may be any other color.
+  auto * pluginRunlengthEncode = new PluginRunlengthEncode(_fb, lut_yuv);
+  std::vector<int> region_channels;
+  for (int i = 1; i < lut_yuv->getChannelCount(); i++) {
+    if (i != lut_yuv->getChannelID("Field Green") && i != lut_yuv->getChannelID("Black")) {
+      region_channels.push_back(i);
+    }
+  }
+  pluginRunlengthEncode->setRegionChannels(region_channels);
+  stack.push_back(pluginRunlengthEncode);
 
   stack.push_back(new PluginFindBlobs(_fb,lut_yuv));
 
@@ -96,6 +111,10 @@ StackRoboCupSSL::StackRoboCupSSL(
       *camera_parameters,
       *global_field));
 
+  stack.push_back(new PluginDetectionTracker(_fb, _tracker));
+
+  stack.push_back(new PluginDetectionMerger(_fb, _merger, *camera_parameters));
+
   stack.push_back(_global_plugin_publish_geometry);
   stack.push_back(_legacy_plugin_publish_geometry);
 
@@ -39,6 +39,8 @@
 #include "plugin_publishgeometry.h"
 #include "plugin_legacysslnetworkoutput.h"
 #include "plugin_legacypublishgeometry.h"
+#include "plugin_detection_tracker.h"
+#include "plugin_detection_merger.h"
 #include "plugin_auto_color_calibration.h"
 #include "plugin_dvr.h"
 #include "cmpattern_teamdetector.h"
@@ -70,6 +72,9 @@ class StackRoboCupSSL : public VisionStack {
   RoboCupSSLServer * _ds_udp_server_new;
   // UDP Server for Double-Sized field, old protobuf format.
   RoboCupSSLServer * _ds_udp_server_old;
+  // Shared by all camera stacks.
+  DetectionTracker * _tracker;
+  DetectionMerger * _merger;
   public:
   StackRoboCupSSL(RenderOptions* _opts,
                   FrameBuffer* _fb,
@@ -83,6 +88,8 @@ class StackRoboCupSSL : public VisionStack {
                   CMPattern::TeamSelector* _global_team_selector_yellow,
                   RoboCupSSLServer* ds_udp_server_new,
                   RoboCupSSLServer* ds_udp_server_old,
+                  DetectionTracker* tracker,
+                  DetectionMerger* merger,
                   string cam_settings_filename);
   virtual string getSettingsFileName();
   ~StackRoboCupSSL() override;
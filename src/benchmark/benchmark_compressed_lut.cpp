@@ -0,0 +1,95 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    benchmark_compressed_lut.cpp
+  \brief   Micro-benchmark of the flat against the compressed threshold LUT
+*/
+//========================================================================
+#include "cmvision_threshold.h"
+#include "conversions.h"
+#include "benchmark_util.h"
+#include <cstdio>
+
+// For each LUT layout, thresholds synthetic UYVY field frames with the flat
+// and with the compressed table. The hit rate is the share of pixel lookups
+// that land in a uniform block and are answered by the coarse table alone.
+
+static double uniformHitRate(YUVLUT & lut, const RawImage & frame) {
+  int handle;
+  lut.acquireTable(handle);
+  const CompressedLUT * compressed = lut.getCompressedTable(handle);
+  long hits = 0;
+  long lookups = 0;
+  const uyvy * pixels = (const uyvy *) frame.getData();
+  for (int i = 0; compressed != nullptr && i < frame.getNumPixels() / 2; i++) {
+    unsigned int u = pixels[i].u >> lut.Y_SHIFT;
+    unsigned int v = pixels[i].v >> lut.Z_SHIFT;
+    hits += compressed->isUniform_preshrunk(pixels[i].y1 >> lut.X_SHIFT, u, v);
+    hits += compressed->isUniform_preshrunk(pixels[i].y2 >> lut.X_SHIFT, u, v);
+    lookups += 2;
+  }
+  lut.releaseTable(handle);
+  return lookups > 0 ? (double) hits / lookups : 0.0;
+}
+
+int main(int argc, char ** argv) {
+  int repetitions = benchmarkRepetitions(argc, argv);
+  const int layouts[][3] = {{4, 6, 6}, {5, 6, 6}, {6, 6, 6}, {7, 7, 7}};
+
+  printf("%-6s %-12s %10s %10s %10s %10s %11s %11s %8s\n", "lut", "resolution", "flat (KB)", "comp (KB)",
+         "flat (ms)", "comp (ms)", "flat ns/px", "comp ns/px", "hits");
+  for (const auto & layout : layouts) {
+    YUVLUT lut(layout[0], layout[1], layout[2], "");
+    lut.loadRoboCupChannels(LUTChannelMode_Numeric);
+    lut.computeLUTfromLabels(60);
+    if (!lut.setCompression(true)) continue;
+    int handle;
+    lut.acquireTable(handle);
+    int compressed_bytes = lut.getCompressedTable(handle)->getSizeBytes();
+    lut.releaseTable(handle);
+
+    char name[16];
+    snprintf(name, sizeof(name), "%d-%d-%d", layout[0], layout[1], layout[2]);
+    for (const BenchmarkResolution & resolution : kBenchmarkResolutions) {
+      int width = resolution.width;
+      int height = resolution.height;
+      RawImage rgb_frame;
+      rgb_frame.allocate(COLOR_RGB8, width, height);
+      fillFieldFrame(rgb_frame.getData(), width, height);
+      RawImage frame;
+      frame.allocate(COLOR_YUV422_UYVY, width, height);
+      Conversions::rgb2uyvy(rgb_frame.getData(), frame.getData(), width, height);
+      Image<raw8> target;
+      target.allocate(width, height);
+
+      lut.setCompression(false);
+      double flat = benchmarkMedianMs(repetitions, [&]() {
+        CMVisionThreshold::thresholdImageYUV422_UYVY(&target, &frame, &lut);
+      });
+      lut.setCompression(true);
+      double compressed = benchmarkMedianMs(repetitions, [&]() {
+        CMVisionThreshold::thresholdImageYUV422_UYVY(&target, &frame, &lut);
+      });
+
+      char resolution_name[32];
+      snprintf(resolution_name, sizeof(resolution_name), "%dx%d", width, height);
+      printf("%-6s %-12s %10.1f %10.1f %10.3f %10.3f %11.2f %11.2f %7.1f%%\n", name, resolution_name,
+             lut.LUT_SIZE * sizeof(lut_mask_t) / 1024.0, compressed_bytes / 1024.0, flat, compressed,
+             flat * 1e6 / (width * height), compressed * 1e6 / (width * height),
+             100.0 * uniformHitRate(lut, frame));
+    }
+  }
+  return 0;
+}
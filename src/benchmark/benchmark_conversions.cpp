@@ -0,0 +1,89 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    benchmark_conversions.cpp
+  \brief   Micro-benchmark of the SSSE3 against the portable image conversions
+*/
+//========================================================================
+#include "conversions.h"
+#include "benchmark_util.h"
+#include <cstdio>
+#include <vector>
+
+// Every conversion runs on the same synthetic field frame, once through the
+// function the application calls and once through its portable version.
+// Without SSSE3 in the build both columns measure the portable code.
+
+typedef void (*Conversion)(unsigned char * src, unsigned char * dest, int width, int height);
+typedef void (*ScalarConversion)(unsigned char * src, unsigned char * dest, int width, int height, int first);
+
+struct ConversionCase {
+  const char * name;
+  Conversion fast;
+  ScalarConversion scalar;
+  int src_format;  // 0: rgb, 1: uyvy, 2: yuyv, 3: grey
+  int dest_bytes_per_pixel;
+};
+
+int main(int argc, char ** argv) {
+  int repetitions = benchmarkRepetitions(argc, argv);
+  const ConversionCase cases[] = {
+    {"uyvy2rgb", Conversions::uyvy2rgb, Conversions::uyvy2rgbScalar, 1, 3},
+    {"yuyv2rgb", Conversions::yuyv2rgb, Conversions::yuyv2rgbScalar, 2, 3},
+    {"uyvy2bgr", Conversions::uyvy2bgr, Conversions::uyvy2bgrScalar, 1, 3},
+    {"rgb2uyvy", Conversions::rgb2uyvy, Conversions::rgb2uyvyScalar, 0, 2},
+    {"rgb2yuyv", Conversions::rgb2yuyv, Conversions::rgb2yuyvScalar, 0, 2},
+    {"bgr2rgb", Conversions::bgr2rgb, Conversions::bgr2rgbScalar, 0, 3},
+    {"y2rgb", Conversions::y2rgb, Conversions::y2rgbScalar, 3, 3},
+  };
+
+#ifdef __SSSE3__
+  printf("SSSE3 enabled\n");
+#else
+  printf("SSSE3 disabled, both columns are portable code\n");
+#endif
+  printf("%-12s %-10s %11s %12s %8s\n", "resolution", "conversion", "fast (ms)", "scalar (ms)", "speedup");
+  for (const BenchmarkResolution & resolution : kBenchmarkResolutions) {
+    int width = resolution.width;
+    int height = resolution.height;
+    int num_pixels = width * height;
+    std::vector<unsigned char> sources[4];
+    sources[0].resize(num_pixels * 3);
+    fillFieldFrame(sources[0].data(), width, height);
+    sources[1].resize(num_pixels * 2);
+    Conversions::rgb2uyvyScalar(sources[0].data(), sources[1].data(), width, height);
+    sources[2].resize(num_pixels * 2);
+    Conversions::rgb2yuyvScalar(sources[0].data(), sources[2].data(), width, height);
+    sources[3].resize(num_pixels);
+    for (int i = 0; i < num_pixels; i++) {
+      sources[3][i] = sources[1][i * 2 + 1];
+    }
+    std::vector<unsigned char> dest(num_pixels * 3);
+
+    char name[32];
+    snprintf(name, sizeof(name), "%dx%d", width, height);
+    for (const ConversionCase & c : cases) {
+      unsigned char * src = sources[c.src_format].data();
+      double fast = benchmarkMedianMs(repetitions, [&]() {
+        c.fast(src, dest.data(), width, height);
+      });
+      double scalar = benchmarkMedianMs(repetitions, [&]() {
+        c.scalar(src, dest.data(), width, height, 0);
+      });
+      printf("%-12s %-10s %11.3f %12.3f %7.2fx\n", name, c.name, fast, scalar, scalar / fast);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,136 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    benchmark_encode_runs.cpp
+  \brief   Micro-benchmark of the chunked against the byte-wise run scan
+*/
+//========================================================================
+#include "cmvision_region.h"
+#include "cmvision_threshold.h"
+#include "conversions.h"
+#include "benchmark_util.h"
+#include <opencv2/opencv.hpp>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Thresholds frames with the default color classes and run length encodes
+// them with encodeRuns, which finds run ends 32 or 16 pixels at a time,
+// and with the same loop scanning byte by byte.
+//
+// usage: benchmark_encode_runs [repetitions] [image files...]
+// Without image files, synthetic field frames at the camera resolutions
+// are used. Image files, e.g. frames saved by the DVR, are read with OpenCV.
+
+using CMVision::Run;
+using CMVision::RunList;
+
+// encodeRuns without a filter, with a byte-wise scan for the end of each run
+static void encodeRunsByteWise(Image<raw8> * tmap, RunList * runlist) {
+  int max_runs = runlist->getMaxRuns();
+  int width = tmap->getWidth();
+  int j = 0;
+  Run r;
+  r.next = 0;
+  for (int y = 0; y < tmap->getHeight(); y++) {
+    const raw8 * row = tmap->getPixelData() + y * width;
+    r.y = y;
+    int x = 0;
+    while (x < width) {
+      raw8 m = row[x];
+      int l = x;
+      while (x != width && row[x] == m) x++;
+      if (m.v != 0 || x == width) {
+        r.x = l;
+        r.color = m;
+        r.width = x - l;
+        r.parent = j;
+        runlist->setRun(j++, r);
+        if (j >= max_runs) {
+          runlist->setUsedRuns(j);
+          return;
+        }
+      }
+    }
+  }
+  runlist->setUsedRuns(j);
+}
+
+static void benchmarkFrame(const std::string & name, const RawImage & rgb_frame, YUVLUT & lut, int repetitions) {
+  int width = rgb_frame.getWidth();
+  int height = rgb_frame.getHeight();
+  RawImage uyvy_frame;
+  uyvy_frame.allocate(COLOR_YUV422_UYVY, width, height);
+  Conversions::rgb2uyvy(rgb_frame.getData(), uyvy_frame.getData(), width, height);
+  Image<raw8> thresholded;
+  thresholded.allocate(width, height);
+  CMVisionThreshold::thresholdImageYUV422_UYVY(&thresholded, &uyvy_frame, &lut);
+
+  RunList runlist(width * height + 1);
+  double chunked = benchmarkMedianMs(repetitions, [&]() {
+    CMVision::RegionProcessing::encodeRuns(&thresholded, &runlist);
+  });
+  int runs = runlist.getUsedRuns();
+  double byte_wise = benchmarkMedianMs(repetitions, [&]() {
+    encodeRunsByteWise(&thresholded, &runlist);
+  });
+  if (runlist.getUsedRuns() != runs) {
+    fprintf(stderr, "%s: %d runs byte-wise, %d chunked\n", name.c_str(), runlist.getUsedRuns(), runs);
+  }
+  printf("%-24s %10d %10.1f %12.3f %14.3f %8.2fx\n", name.c_str(), runs, (double) width * height / runs,
+         chunked, byte_wise, byte_wise / chunked);
+}
+
+int main(int argc, char ** argv) {
+  int repetitions = benchmarkRepetitions(argc, argv);
+  YUVLUT lut(4, 6, 6, "");
+  lut.loadRoboCupChannels(LUTChannelMode_Numeric);
+  lut.computeLUTfromLabels(60);
+
+#if defined(__AVX2__)
+  printf("run scan: AVX2\n");
+#elif defined(__SSE2__)
+  printf("run scan: SSE2\n");
+#else
+  printf("run scan: byte-wise, both columns measure the same code\n");
+#endif
+  printf("%-24s %10s %10s %12s %14s %8s\n", "frame", "runs", "px/run", "chunked (ms)", "byte-wise (ms)", "speedup");
+  int first_file = (argc > 1 && atoi(argv[1]) > 0) ? 2 : 1;
+  if (first_file >= argc) {
+    for (const BenchmarkResolution & resolution : kBenchmarkResolutions) {
+      RawImage rgb_frame;
+      rgb_frame.allocate(COLOR_RGB8, resolution.width, resolution.height);
+      fillFieldFrame(rgb_frame.getData(), resolution.width, resolution.height);
+      char name[32];
+      snprintf(name, sizeof(name), "synthetic %dx%d", resolution.width, resolution.height);
+      benchmarkFrame(name, rgb_frame, lut, repetitions);
+    }
+  }
+  for (int i = first_file; i < argc; i++) {
+    cv::Mat image = cv::imread(argv[i], cv::IMREAD_COLOR);
+    if (image.empty()) {
+      fprintf(stderr, "Unable to read image '%s'\n", argv[i]);
+      continue;
+    }
+    RawImage rgb_frame;
+    rgb_frame.allocate(COLOR_RGB8, image.cols, image.rows);
+    cv::Mat rgb(image.rows, image.cols, CV_8UC3, rgb_frame.getData());
+    cv::cvtColor(image, rgb, cv::COLOR_BGR2RGB);
+    std::string name = argv[i];
+    if (name.size() > 24) name = "..." + name.substr(name.size() - 21);
+    benchmarkFrame(name, rgb_frame, lut, repetitions);
+  }
+  return 0;
+}
@@ -0,0 +1,89 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    benchmark_threshold.cpp
+  \brief   Micro-benchmark of the CMVision threshold kernels
+*/
+//========================================================================
+#include "cmvision_threshold.h"
+#include "conversions.h"
+#include "benchmark_util.h"
+#include <cstdio>
+
+// Thresholds synthetic field frames in every input format with the LUT
+// layouts of the RoboCup stack (4-6-6 YUV, 5-5-5 RGB) and reports the
+// median time per frame and the pixel rate.
+
+class ThresholdSetup {
+public:
+  YUVLUT yuv_lut;
+  RGBLUT * rgb_lut;  // derived from yuv_lut, which owns it
+
+  ThresholdSetup(int y_bits, int u_bits, int v_bits, int r_bits, int g_bits, int b_bits) :
+      yuv_lut(y_bits, u_bits, v_bits, "") {
+    rgb_lut = new RGBLUT(r_bits, g_bits, b_bits, "");
+    yuv_lut.loadRoboCupChannels(LUTChannelMode_Numeric);
+    yuv_lut.addDerivedLUT(rgb_lut);
+    yuv_lut.computeLUTfromLabels(60);
+    yuv_lut.updateDerivedLUTs();
+  }
+};
+
+static void report(const char * resolution, const char * format, int num_pixels, double ms) {
+  printf("%-12s %-8s %10.3f %12.1f\n", resolution, format, ms, num_pixels / (ms * 1000.0));
+}
+
+int main(int argc, char ** argv) {
+  int repetitions = benchmarkRepetitions(argc, argv);
+  ThresholdSetup setup(4, 6, 6, 5, 5, 5);
+
+  printf("%-12s %-8s %10s %12s\n", "resolution", "format", "time (ms)", "Mpixel/s");
+  for (const BenchmarkResolution & resolution : kBenchmarkResolutions) {
+    int width = resolution.width;
+    int height = resolution.height;
+    RawImage rgb_frame;
+    rgb_frame.allocate(COLOR_RGB8, width, height);
+    fillFieldFrame(rgb_frame.getData(), width, height);
+    RawImage uyvy_frame;
+    uyvy_frame.allocate(COLOR_YUV422_UYVY, width, height);
+    Conversions::rgb2uyvy(rgb_frame.getData(), uyvy_frame.getData(), width, height);
+    RawImage yuv_frame;
+    yuv_frame.allocate(COLOR_YUV444, width, height);
+    const rgb * rgb_pixels = (const rgb *) rgb_frame.getData();
+    yuv * yuv_pixels = (yuv *) yuv_frame.getData();
+    for (int i = 0; i < width * height; i++) {
+      yuv_pixels[i] = Conversions::rgb2yuv(rgb_pixels[i]);
+    }
+    Image<raw8> target;
+    target.allocate(width, height);
+
+    double uyvy_ms = benchmarkMedianMs(repetitions, [&]() {
+      CMVisionThreshold::thresholdImageYUV422_UYVY(&target, &uyvy_frame, &setup.yuv_lut);
+    });
+    double yuv_ms = benchmarkMedianMs(repetitions, [&]() {
+      CMVisionThreshold::thresholdImageYUV444(&target, &yuv_frame, &setup.yuv_lut);
+    });
+    double rgb_ms = benchmarkMedianMs(repetitions, [&]() {
+      CMVisionThreshold::thresholdImageRGB(&target, &rgb_frame, setup.rgb_lut);
+    });
+
+    char name[32];
+    snprintf(name, sizeof(name), "%dx%d", width, height);
+    report(name, "uyvy", width * height, uyvy_ms);
+    report(name, "yuv444", width * height, yuv_ms);
+    report(name, "rgb", width * height, rgb_ms);
+  }
+  return 0;
+}
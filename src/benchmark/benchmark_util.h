@@ -0,0 +1,95 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    benchmark_util.h
+  \brief   Timing and test frame helpers shared by the micro-benchmarks
+*/
+//========================================================================
+#ifndef BENCHMARK_UTIL_H
+#define BENCHMARK_UTIL_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+/// camera resolutions the benchmarks run at
+struct BenchmarkResolution {
+  int width;
+  int height;
+};
+static const BenchmarkResolution kBenchmarkResolutions[] = {{780, 580}, {1280, 1024}, {1920, 1200}};
+
+/// repetitions per measurement, can be overridden by the first command line argument
+static inline int benchmarkRepetitions(int argc, char ** argv, int fallback = 50) {
+  if (argc > 1 && atoi(argv[1]) > 0) return atoi(argv[1]);
+  return fallback;
+}
+
+/// Median wall time in milliseconds of repetitions calls of run, after one
+/// untimed warm-up call. The median keeps scheduler hiccups out of the result.
+template <typename Function>
+double benchmarkMedianMs(int repetitions, Function run) {
+  run();
+  std::vector<double> times;
+  for (int i = 0; i < repetitions; i++) {
+    auto start = std::chrono::steady_clock::now();
+    run();
+    times.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+  }
+  std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+  return times[times.size() / 2];
+}
+
+/// Fill an rgb frame with a noisy field, lines and ball/marker sized blobs.
+/// The same seed always gives the same frame.
+static inline void fillFieldFrame(uint8_t * rgb_data, int width, int height, unsigned int seed = 1) {
+  static const uint8_t colors[][3] = {
+    {255, 128, 0}, {255, 255, 0}, {0, 64, 255}, {255, 64, 192}, {0, 255, 255}, {0, 255, 64}
+  };
+  unsigned int state = seed;
+  auto next = [&state]() -> unsigned int {
+    state = state * 1103515245u + 12345u;
+    return (state >> 16) & 0x7fff;
+  };
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      uint8_t * p = rgb_data + 3 * (y * width + x);
+      bool line = (x % 200) < 3 || (y % 200) < 3;
+      int noise = (int) (next() % 21) - 10;
+      p[0] = (uint8_t) std::max(0, std::min(255, (line ? 230 : 40) + noise));
+      p[1] = (uint8_t) std::max(0, std::min(255, (line ? 230 : 120) + noise));
+      p[2] = (uint8_t) std::max(0, std::min(255, (line ? 230 : 50) + noise));
+    }
+  }
+  int blobs = width * height / 20000;
+  for (int i = 0; i < blobs; i++) {
+    const uint8_t * color = colors[next() % 6];
+    int size = 6 + next() % 14;
+    int x0 = next() % std::max(1, width - size);
+    int y0 = next() % std::max(1, height - size);
+    for (int y = y0; y < y0 + size; y++) {
+      for (int x = x0; x < x0 + size; x++) {
+        uint8_t * p = rgb_data + 3 * (y * width + x);
+        p[0] = color[0];
+        p[1] = color[1];
+        p[2] = color[2];
+      }
+    }
+  }
+}
+
+#endif
@@ -25,7 +25,9 @@
 //#include "mainwindow.h"
 
 #include <stdio.h>
+#include <string.h>
 #include "robocup_ssl_client.h"
+#include "robocup_ssl_shm.h"
 #include "timer.h"
 
 #include "messages_robocup_ssl_detection.pb.h"
@@ -51,15 +53,30 @@ void printRobotInfo(const SSL_DetectionRobot & robot) {
 
 int main(int argc, char *argv[])
 {
-    (void)argc;
-    (void)argv;
+    //--shm [name]: read from the shared memory output of a local ssl-vision instead of the network
+    bool use_shm = false;
+    string shm_name = RoboCupSSLShmRing::DefaultName;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i],"--shm")==0 || strcmp(argv[i],"-s")==0) {
+            use_shm = true;
+            if (i + 1 < argc && argv[i+1][0] == '/') shm_name = argv[++i];
+        } else {
+            fprintf(stderr,"usage: %s [--shm [/name]]\n",argv[0]);
+            return 1;
+        }
+    }
 
     RoboCupSSLClient client;
-    client.open(true);
+    RoboCupSSLShmClient shm_client(shm_name);
+    if (use_shm) {
+        if (!shm_client.open(true)) return 1;
+    } else {
+        client.open(true);
+    }
     SSL_WrapperPacket packet;
 
     while(true) {
-        if (client.receive(packet)) {
+        if (use_shm ? shm_client.receive(packet) : client.receive(packet)) {
             printf("-----Received Wrapper Packet---------------------------------------------\n");
             //see if the packet contains a robot detection frame:
             if (packet.has_detection()) {
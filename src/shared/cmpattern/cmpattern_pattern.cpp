@@ -429,7 +429,7 @@ bool MultiPatternModel::findPattern(PatternDetectionResult & result, Marker * ma
     for(int i=0; i<num_markers; i++){
       vector2d marker_img_center(markers[i].reg->cen_x,markers[i].reg->cen_y);
       vector3d marker_center3d;
-      camera_params.image2field(marker_center3d,marker_img_center,markers[i].height);
+      camera_params.projection_lut->image2field(marker_center3d,marker_img_center,markers[i].height);
       markers[i].loc.set(marker_center3d.x,marker_center3d.y);
     }
 
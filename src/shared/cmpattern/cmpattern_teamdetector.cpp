@@ -203,17 +203,24 @@ void TeamDetector::findRobotsByTeamMarkerOnly(::google::protobuf::RepeatedPtrFie
   //local variables
   const CMVision::Region * reg=0;
   SSL_DetectionRobot * robot=0;
+
+  //gather all center markers and project them in one batch:
+  team_projection.clear();
   while((reg = filter_team.getNext()) != 0) {
-    vector2d reg_img_center(reg->cen_x,reg->cen_y);
-    vector3d reg_center3d;
-    _camera_params.image2field(reg_center3d,reg_img_center,_robot_height);
+    team_projection.add(reg);
+  }
+  team_projection.project(*_camera_params.projection_lut,_robot_height);
+
+  for (int r=0;r<team_projection.size();r++) {
+    reg=team_projection.regions[r];
+    vector3d reg_center3d=team_projection.getCenter(r);
     vector2d reg_center(reg_center3d.x,reg_center3d.y);
 
     //TODO: add confidence masking:
     //float conf = det.mask.get(reg->cen_x,reg->cen_y);
     double conf=1.0;
     if (field_filter.isInFieldOrPlayableBoundary(reg_center) &&  ((_histogram_enable==false) || checkHistogram(reg,image)==true)) {
-      double area = getRegionArea(reg,_robot_height);
+      double area = team_projection.getArea(r);
       double area_err = fabs(area - _center_marker_area_mean);
 
       conf *= GaussianVsUniform(area_err, sq(_center_marker_area_stddev), _center_marker_uniform);
@@ -266,16 +273,33 @@ void TeamDetector::findRobotsByTeamMarkerOnly(::google::protobuf::RepeatedPtrFie
 
 
 
-double TeamDetector::getRegionArea(const CMVision::Region * reg, double z) const {
+void RegionProjection::project(CameraProjectionLUT & lut, double z) {
+  _z=z;
+  int n=regions.size();
+  pixel_x.resize(3*n);
+  pixel_y.resize(3*n);
+  field_x.resize(3*n);
+  field_y.resize(3*n);
+  for (int i=0;i<n;i++) {
+    const CMVision::Region * reg=regions[i];
+    pixel_x[i]=reg->cen_x;
+    pixel_y[i]=reg->cen_y;
+    pixel_x[n+i]=reg->x2+1;
+    pixel_y[n+i]=reg->y2+1;
+    pixel_x[2*n+i]=reg->x1;
+    pixel_y[2*n+i]=reg->y1;
+  }
+  lut.image2field(field_x.data(),field_y.data(),pixel_x.data(),pixel_y.data(),3*n,z);
+}
+
+double RegionProjection::getArea(int i) const {
   // calculate area of bounding box in sq mm
-  vector3d a,b;
-  vector2d right(reg->x2+1,reg->y2+1);
-  vector2d left(reg->x1,reg->y1);
-  _camera_params.image2field(a,right,z);
-  _camera_params.image2field(b,left,z);
-  vector3d box = a-b;
-
-  double box_area = fabs(box.x) * fabs(box.y);
+  const CMVision::Region * reg=regions[i];
+  int n=regions.size();
+  double box_x = field_x[n+i] - field_x[2*n+i];
+  double box_y = field_y[n+i] - field_y[2*n+i];
+
+  double box_area = fabs(box_x) * fabs(box_y);
   int box_pixels = (reg->x2+1 - reg->x1) * (reg->y2+1 - reg->y1);
 
   // estimate world coordinate area of region
@@ -432,41 +456,51 @@ void TeamDetector::findRobotsByModel(::google::protobuf::RepeatedPtrField< ::SSL
 
   MultiPatternModel::PatternDetectionResult res;
 
+  //gather all center markers and project them in one batch:
+  team_projection.clear();
   while((reg = filter_team.getNext()) != 0) {
-    vector2d reg_img_center(reg->cen_x,reg->cen_y);
-    vector3d reg_center3d;
-    _camera_params.image2field(reg_center3d,reg_img_center,_robot_height);
+    team_projection.add(reg);
+  }
+  team_projection.project(*_camera_params.projection_lut,_robot_height);
+
+  for (int r=0;r<team_projection.size();r++) {
+    reg=team_projection.regions[r];
+    vector3d reg_center3d=team_projection.getCenter(r);
     vector2d reg_center(reg_center3d.x,reg_center3d.y);
     //TODO add masking:
     //if(det.mask.get(reg->cen_x,reg->cen_y) >= 0.5){
     if (field_filter.isInFieldOrPlayableBoundary(reg_center)) {
-      cen.set(reg,reg_center3d,getRegionArea(reg,_robot_height));
+      cen.set(reg,reg_center3d,team_projection.getArea(r));
       int num_markers = 0;
 
+      //gather the surrounding marker candidates, then project them in one batch:
+      marker_projection.clear();
       reg_tree.startQuery(*reg,marker_max_query_dist);
       double sd=0.0;
       CMVision::Region *mreg;
-      while((mreg=reg_tree.getNextNearest(sd))!=0 && num_markers<MaxDetections) {
+      while((mreg=reg_tree.getNextNearest(sd))!=0) {
         //TODO: implement masking:
         // filter_other.check(*mreg) && det.mask.get(mreg->cen_x,mreg->cen_y)>=0.5
 
         if(filter_others.check(*mreg) && model.usesColor(mreg->color)) {
-          vector2d marker_img_center(mreg->cen_x,mreg->cen_y);
-          vector3d marker_center3d;
-          _camera_params.image2field(marker_center3d,marker_img_center,_robot_height);
-          Marker &m = markers[num_markers];
-
-          m.set(mreg,marker_center3d,getRegionArea(mreg,_robot_height));
-          vector2f ofs = m.loc - cen.loc;
-          m.dist = ofs.length();
-          m.angle = ofs.angle();
-
-          if(m.dist>0.0 && m.dist<marker_max_dist){
-            num_markers++;
-          }
+          marker_projection.add(mreg);
         }
       }
       reg_tree.endQuery();
+      marker_projection.project(*_camera_params.projection_lut,_robot_height);
+
+      for (int i=0;i<marker_projection.size() && num_markers<MaxDetections;i++) {
+        Marker &m = markers[num_markers];
+
+        m.set(marker_projection.regions[i],marker_projection.getCenter(i),marker_projection.getArea(i));
+        vector2f ofs = m.loc - cen.loc;
+        m.dist = ofs.length();
+        m.angle = ofs.angle();
+
+        if(m.dist>0.0 && m.dist<marker_max_dist){
+          num_markers++;
+        }
+      }
 
       if(num_markers >= 2){
         CMPattern::PatternProcessing::sortMarkersByAngle(markers,num_markers);
@@ -155,6 +155,38 @@ public:
 
 
 
+/// Gathers marker regions and projects their centers and bounding boxes
+/// onto the field in one batch call.
+class RegionProjection {
+protected:
+  double _z;
+  // 3 points per region, stored as consecutive blocks:
+  // centers, bottom-right and top-left bounding box corners
+  std::vector<double> pixel_x;
+  std::vector<double> pixel_y;
+  std::vector<double> field_x;
+  std::vector<double> field_y;
+public:
+  std::vector<const CMVision::Region *> regions;
+
+  RegionProjection() : _z(0.0) {}
+  void clear() {
+    regions.clear();
+  }
+  void add(const CMVision::Region * reg) {
+    regions.push_back(reg);
+  }
+  int size() const {
+    return regions.size();
+  }
+  void project(CameraProjectionLUT & lut, double z);
+  vector3d getCenter(int i) const {
+    return vector3d(field_x[i],field_y[i],_z);
+  }
+  /// estimated area of the region in sq mm
+  double getArea(int i) const;
+};
+
 class TeamDetector {
 protected:
 
@@ -198,6 +230,9 @@ protected:
   double _pattern_max_dist;
   MultiPatternModel::PatternFitParameters _pattern_fit_params;
 
+  RegionProjection team_projection;
+  RegionProjection marker_projection;
+
   //----END OF TEAM CONFIG---------
 
   //color ids:
@@ -211,7 +246,6 @@ protected:
   int color_id_team;
 
 protected:
-    double getRegionArea(const CMVision::Region * reg, double z) const;
     bool checkHistogram(const CMVision::Region * reg, const Image<raw8> * image);
 
     //returns a mutable pointer if the add was successful
@@ -21,6 +21,9 @@
 */
 //========================================================================
 #include "cmvision_region.h"
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <x86intrin.h>
+#endif
 
 namespace CMVision {
 
@@ -34,14 +37,134 @@ RegionProcessing::~RegionProcessing()
 }
 
 
-void RegionProcessing::encodeRuns(Image<raw8> * tmap, CMVision::RunList * runlist)
+// Returns the first x at or after start where row[x] != m, or width if
+// there is none. Thresholded images mostly consist of long runs of the
+// same label, so whole chunks are compared at once and the first
+// differing byte is found from the comparison mask.
+static inline int findRunEnd(const raw8 * row, int x, int width, raw8 m)
+{
+  const uint8_t * p = (const uint8_t *) row;
+#ifdef __AVX2__
+  const __m256i m32 = _mm256_set1_epi8((char) m.v);
+  for (; x + 32 <= width; x += 32) {
+    const __m256i chunk = _mm256_loadu_si256((const __m256i *) (p + x));
+    const unsigned int diff = ~(unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, m32));
+    if (diff != 0) return x + __builtin_ctz(diff);
+  }
+#endif
+#ifdef __SSE2__
+  const __m128i m16 = _mm_set1_epi8((char) m.v);
+  for (; x + 16 <= width; x += 16) {
+    const __m128i chunk = _mm_loadu_si128((const __m128i *) (p + x));
+    const unsigned int diff = ~(unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, m16)) & 0xffff;
+    if (diff != 0) return x + __builtin_ctz(diff);
+  }
+#endif
+  while(x != width && p[x] == m.v) x++;
+  return x;
+}
+
+void RunColorFilter::setAllRegionColors(bool enable)
+{
+  for (int i = 0; i < 256; i++) {
+    region_color[i] = false;
+  }
+  for (int i = 0; i < 16; i++) {
+    lo_table[i] = 0;
+    hi_table[i] = i < 8 ? (uint8_t) (1 << i) : 0;
+  }
+  vectorizable = true;
+  all_region_colors = false;
+  for (int i = 1; enable && i < 256; i++) {
+    setRegionColor(i, true);
+  }
+}
+
+void RunColorFilter::setRegionColor(int label, bool enable)
+{
+  if (label <= 0 || label > 255) return;
+  region_color[label] = enable;
+  if (label < 128) {
+    if (enable) {
+      lo_table[label & 15] |= (uint8_t) (1 << (label >> 4));
+    } else {
+      lo_table[label & 15] &= (uint8_t) ~(1 << (label >> 4));
+    }
+  }
+  vectorizable = true;
+  all_region_colors = true;
+  for (int i = 1; i < 256; i++) {
+    if (region_color[i] && i >= 128) vectorizable = false;
+    if (!region_color[i]) all_region_colors = false;
+  }
+}
+
+void RunColorFilter::clearMinWidths()
+{
+  for (int i = 0; i < 256; i++) {
+    min_width[i] = 1;
+  }
+  has_min_widths = false;
+}
+
+void RunColorFilter::setMinWidth(int label, int width)
+{
+  if (label <= 0 || label > 255) return;
+  min_width[label] = width > 1 ? width : 1;
+  has_min_widths = false;
+  for (int i = 1; i < 256; i++) {
+    if (min_width[i] > 1) has_min_widths = true;
+  }
+}
+
+int RunColorFilter::findRegionColor(const raw8 * row, int x, int width) const
+{
+  if (all_region_colors) {
+    return findRunEnd(row, x, width, raw8(0));
+  }
+  const uint8_t * p = (const uint8_t *) row;
+#ifdef __SSSE3__
+  // labels above 127 look up a zero in hi_table, which is right as long
+  // as none of them is a region color
+  if (vectorizable) {
+#ifdef __AVX2__
+    const __m256i lo32 = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) lo_table));
+    const __m256i hi32 = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) hi_table));
+    const __m256i nibble32 = _mm256_set1_epi8(0x0f);
+    for (; x + 32 <= width; x += 32) {
+      const __m256i chunk = _mm256_loadu_si256((const __m256i *) (p + x));
+      const __m256i lo = _mm256_shuffle_epi8(lo32, _mm256_and_si256(chunk, nibble32));
+      const __m256i hi = _mm256_shuffle_epi8(hi32, _mm256_and_si256(_mm256_srli_epi16(chunk, 4), nibble32));
+      const __m256i miss = _mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), _mm256_setzero_si256());
+      const unsigned int found = ~(unsigned int) _mm256_movemask_epi8(miss);
+      if (found != 0) return x + __builtin_ctz(found);
+    }
+#endif
+    const __m128i lo16 = _mm_load_si128((const __m128i *) lo_table);
+    const __m128i hi16 = _mm_load_si128((const __m128i *) hi_table);
+    const __m128i nibble16 = _mm_set1_epi8(0x0f);
+    for (; x + 16 <= width; x += 16) {
+      const __m128i chunk = _mm_loadu_si128((const __m128i *) (p + x));
+      const __m128i lo = _mm_shuffle_epi8(lo16, _mm_and_si128(chunk, nibble16));
+      const __m128i hi = _mm_shuffle_epi8(hi16, _mm_and_si128(_mm_srli_epi16(chunk, 4), nibble16));
+      const __m128i miss = _mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128());
+      const unsigned int found = ~(unsigned int) _mm_movemask_epi8(miss) & 0xffff;
+      if (found != 0) return x + __builtin_ctz(found);
+    }
+  }
+#endif
+  while(x != width && !region_color[p[x]]) x++;
+  return x;
+}
+
+template <typename RunTable>
+void RegionProcessing::encodeRunsT(Image<raw8> * tmap, RunTable * runlist, const CMVision::RunColorFilter * filter)
 // Changes the flat array version of the thresholded image into a run
 // length encoded version, which speeds up later processing since we
 // only have to look at the points where values change.
 {
 
   int max_runs = runlist->getMaxRuns();
-  CMVision::Run * runs = runlist->getRunArrayPointer();
   raw8 * map = tmap->getPixelData();
   int width=tmap->getWidth();
   int height=tmap->getHeight();
@@ -53,6 +176,11 @@ void RegionProcessing::encodeRuns(Image<raw8> * tmap, CMVision::RunList * runlis
   int x,y,j,l;
   CMVision::Run r;
 
+  // runs of the previous row are [prev_begin, prev_end), k scans them left to right
+  bool noise_filter = filter != nullptr && filter->hasMinWidths();
+  int prev_begin = 0, prev_end = 0, k;
+  int dropped = 0;
+
   r.next = 0;
 
   j = 0;
@@ -60,6 +188,8 @@ void RegionProcessing::encodeRuns(Image<raw8> * tmap, CMVision::RunList * runlis
     row = &map[y * width];
 
     r.y = y;
+    k = prev_begin;
+    prev_begin = j;
 
     x = 0;
     while(x < width){
@@ -68,33 +198,58 @@ void RegionProcessing::encodeRuns(Image<raw8> * tmap, CMVision::RunList * runlis
 
       l = x;
 
-      //fix by Stefan: stop if x==row-width
-      //(and don't access the row array in that case as it could cause a segfault)
-      //Note that the left argument of the && operator is always evaluated first and as
-      //such this expression should be safe.
-      while(x != width && row[x] == m) x++;
+      if(filter != nullptr && !filter->isRegionColor(m.v)) {
+        // labels that are not needed as regions become part of a clear run
+        m = clear;
+        x = filter->findRegionColor(row, x, width);
+      } else {
+        //fix by Stefan: stop if x==row-width
+        //(and don't access the row array in that case as it could cause a segfault)
+        x = findRunEnd(row, x, width, m);
+      }
+
+      if(noise_filter && m != clear && x - l < filter->getMinWidth(m.v)) {
+        // keep a short run only if it touches a long enough run of its color above
+        int min_width = filter->getMinWidth(m.v);
+        while(k < prev_end && runlist->getRun(k).x + runlist->getRun(k).width <= l) k++;
+        bool supported = false;
+        for(int i = k; i < prev_end && !supported; i++) {
+          CMVision::Run p = runlist->getRun(i);
+          if(p.x >= x) break;
+          supported = p.color == m && p.width >= min_width;
+        }
+        if(!supported) {
+          // a dropped run at the end of the row stays in the table as the clear run
+          if(x != width) dropped++;
+          m = clear;
+        }
+      }
 
       if(m != clear || x==width) {
         r.color = m;
         r.width = x - l;
         r.parent = j;
-        runs[j++] = r;
+        runlist->setRun(j++, r);
 
         if(j >= max_runs){
           runlist->setUsedRuns(j);
+          runlist->setDroppedRuns(dropped);
           return;
         }
       }
     }
+    prev_end = j;
   }
 
   runlist->setUsedRuns(j);
+  runlist->setDroppedRuns(dropped);
 }
 
 
 
 
-void RegionProcessing::connectComponents(CMVision::RunList * runlist)
+template <typename RunTable>
+void RegionProcessing::connectComponentsT(RunTable * runlist)
 // Connect components using four-connecteness so that the runs each
 // identify the global parent of the connected region they are a part
 // of.  It does this by scanning adjacent rows and merging where
@@ -107,7 +262,7 @@ void RegionProcessing::connectComponents(CMVision::RunList * runlist)
 //   tree-based union find before you touch it
 {
 
-  CMVision::Run * map=runlist->getRunArrayPointer();
+  RunTable & map=*runlist;
   int num = runlist->getUsedRuns();
   int l1,l2;
   CMVision::Run r1,r2;
@@ -116,11 +271,11 @@ void RegionProcessing::connectComponents(CMVision::RunList * runlist)
   // l2 starts on first scan line, l1 starts on second
   l2 = 0;
   l1 = 1;
-  while(map[l1].y == 0) l1++; // skip first line
+  while(map.getY(l1) == 0) l1++; // skip first line
 
   // Do rest in lock step
-  r1 = map[l1];
-  r2 = map[l2];
+  r1 = map.getRun(l1);
+  r2 = map.getRun(l2);
   s = l1;
   while(l1 < num){
     /*
@@ -136,25 +291,30 @@ void RegionProcessing::connectComponents(CMVision::RunList * runlist)
         (r1.x<=r2.x && r2.x<r1.x+r1.width)){
         if(s != l1){
           // if we didn't have a parent already, just take this one
-          map[l1].parent = r1.parent = r2.parent;
+          map.setParent(l1, r2.parent);
+          r1.parent = r2.parent;
           s = l1;
         }else if(r1.parent != r2.parent){
           // otherwise union two parents if they are different
 
           // find terminal roots of each path up tree
           i = r1.parent;
-          while(i != map[i].parent) i = map[i].parent;
+          while(i != map.getParent(i)) i = map.getParent(i);
           j = r2.parent;
-          while(j != map[j].parent) j = map[j].parent;
+          while(j != map.getParent(j)) j = map.getParent(j);
 
           // union and compress paths; use smaller of two possible
           // representative indicies to preserve DAG property
           if(i < j){
-            map[j].parent = i;
-            map[l1].parent = map[l2].parent = r1.parent = r2.parent = i;
+            map.setParent(j, i);
+            map.setParent(l1, i);
+            map.setParent(l2, i);
+            r1.parent = r2.parent = i;
           }else{
-            map[i].parent = j;
-            map[l1].parent = map[l2].parent = r1.parent = r2.parent = j;
+            map.setParent(i, j);
+            map.setParent(l1, j);
+            map.setParent(l2, j);
+            r1.parent = r2.parent = j;
           }
         }
       }
@@ -162,20 +322,21 @@ void RegionProcessing::connectComponents(CMVision::RunList * runlist)
 
     // Move to next point where values may change
     i = (r2.x + r2.width) - (r1.x + r1.width);
-    if(i >= 0) r1 = map[++l1];
-    if(i <= 0) r2 = map[++l2];
+    if(i >= 0) r1 = map.getRun(++l1);
+    if(i <= 0) r2 = map.getRun(++l2);
   }
 
   // Now we need to compress all parent paths
   for(i=0; i<num; i++){
-    j = map[i].parent;
-    map[i].parent = map[j].parent;
+    j = map.getParent(i);
+    map.setParent(i, map.getParent(j));
   }
 }
 
 
 
-void RegionProcessing::extractRegions(CMVision::RegionList * reglist, CMVision::RunList * runlist)
+template <typename RunTable>
+void RegionProcessing::extractRegionsT(CMVision::RegionList * reglist, RunTable * runlist)
 // Takes the list of runs and formats them into a region table,
 // gathering the various statistics along the way.  num is the number
 // of runs in the rmap array, and the number of unique regions in
@@ -185,18 +346,18 @@ void RegionProcessing::extractRegions(CMVision::RegionList * reglist, CMVision::
   int b,i,n,a;
   CMVision::Run r;
   CMVision::Region * reg = reglist->getRegionArrayPointer();
-  CMVision::Run * rmap = runlist->getRunArrayPointer();
+  RunTable & rmap = *runlist;
   int max_reg=reglist->getMaxRegions();
   int num = runlist->getUsedRuns();
 
   n = 0;
 
   for(i=0; i<num; i++){
-    if(rmap[i].color.v!=0){
-      r = rmap[i];
+    if(rmap.getColor(i).v!=0){
+      r = rmap.getRun(i);
       if(r.parent == i){
         // Add new region if this run is a root (i.e. self parented)
-        rmap[i].parent = b = n;  // renumber to point to region id
+        rmap.setParent(i, b = n);  // renumber to point to region id
         reg[b].color = r.color;
         reg[b].area = r.width;
         reg[b].x1 = r.x;
@@ -214,8 +375,8 @@ void RegionProcessing::extractRegions(CMVision::RegionList * reglist, CMVision::
         }
       }else{
         // Otherwise update region stats incrementally
-        b = rmap[r.parent].parent;
-        rmap[i].parent = b; // update parent to identify region id
+        b = rmap.getParent(r.parent);
+        rmap.setParent(i, b); // update parent to identify region id
         reg[b].area += r.width;
         reg[b].x2 = max(r.x + r.width,reg[b].x2);
         reg[b].x1 = min((int)r.x,reg[b].x1);
@@ -223,7 +384,7 @@ void RegionProcessing::extractRegions(CMVision::RegionList * reglist, CMVision::
         reg[b].cen_x += rangeSum(r.x,r.width);
         reg[b].cen_y += r.y * r.width;
         // set previous run to point to this one as next
-        rmap[reg[b].iterator_id].next = i;
+        rmap.setNext(reg[b].iterator_id, i);
         reg[b].iterator_id = i;
       }
     }
@@ -234,7 +395,7 @@ void RegionProcessing::extractRegions(CMVision::RegionList * reglist, CMVision::
     a = reg[i].area;
     reg[i].cen_x = (float)reg[i].cen_x / a;
     reg[i].cen_y = (float)reg[i].cen_y / a;
-    rmap[reg[i].iterator_id].next = 0; // -1;
+    rmap.setNext(reg[i].iterator_id, 0); // -1;
     reg[i].iterator_id = 0;
     reg[i].x2--; // change to inclusive range
   }
@@ -247,6 +408,44 @@ void RegionProcessing::extractRegions(CMVision::RegionList * reglist, CMVision::
 
 
 
+void RegionProcessing::encodeRuns(Image<raw8> * tmap, CMVision::RunList * runlist, const CMVision::RunColorFilter * filter)
+{
+  encodeRunsT(tmap, runlist, filter);
+}
+
+void RegionProcessing::encodeRuns(Image<raw8> * tmap, CMVision::CompactRunList * runlist, const CMVision::RunColorFilter * filter)
+{
+  if (tmap->getWidth() > CMVision::CompactRunList::MaxCoordinate || tmap->getHeight() > CMVision::CompactRunList::MaxCoordinate) {
+    fprintf(stderr, "CMVision: image of %dx%d pixels is too large for a compact run list\n", tmap->getWidth(), tmap->getHeight());
+    runlist->setUsedRuns(0);
+    runlist->setDroppedRuns(0);
+    return;
+  }
+  encodeRunsT(tmap, runlist, filter);
+}
+
+void RegionProcessing::connectComponents(CMVision::RunList * runlist)
+{
+  connectComponentsT(runlist);
+}
+
+void RegionProcessing::connectComponents(CMVision::CompactRunList * runlist)
+{
+  connectComponentsT(runlist);
+}
+
+void RegionProcessing::extractRegions(CMVision::RegionList * reglist, CMVision::RunList * runlist)
+{
+  extractRegionsT(reglist, runlist);
+}
+
+void RegionProcessing::extractRegions(CMVision::RegionList * reglist, CMVision::CompactRunList * runlist)
+{
+  extractRegionsT(reglist, runlist);
+}
+
+
+
 int RegionProcessing::separateRegions(CMVision::ColorRegionList * colorlist, CMVision::RegionList * reglist, int min_area, double min_pixel_ratio)
 // Splits the various regions in the region table a separate list for
 // each color.  The lists are threaded through the table using the
@@ -408,10 +607,7 @@ ImageProcessor::~ImageProcessor() {
 
 void ImageProcessor::processYUV444(const ImageInterface * image, int min_blob_area, double min_pixel_ratio) {
   img_thresholded->allocate(image->getWidth(),image->getHeight());
-  Image<raw8> mask;
-  mask.allocate(image->getWidth(),image->getHeight());
-  memset(mask.getData(),-1,mask.getNumBytes());
-  CMVisionThreshold::thresholdImageYUV444(img_thresholded,image,lut,&mask);
+  CMVisionThreshold::thresholdImageYUV444(img_thresholded,image,lut);
   processThresholded(img_thresholded, min_blob_area, min_pixel_ratio);
 }
 
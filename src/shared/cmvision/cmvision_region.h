@@ -44,11 +44,13 @@ private:
   Run * runs;
   int max_runs;
   int used_runs;
+  int dropped_runs;
 public:
   RunList(int _max_runs) {
     runs=new Run[_max_runs];
     max_runs=_max_runs;
     used_runs=0;
+    dropped_runs=0;
   }
   void setUsedRuns(int runs) {
     used_runs=runs;
@@ -56,6 +58,13 @@ public:
   int getUsedRuns() {
     return used_runs;
   }
+  // runs the noise filter of the last encodeRuns call removed from the table
+  void setDroppedRuns(int runs) {
+    dropped_runs=runs;
+  }
+  int getDroppedRuns() {
+    return dropped_runs;
+  }
   ~RunList() {
     delete[] runs;
   }
@@ -66,10 +75,171 @@ public:
   int getMaxRuns() {
     return max_runs;
   }
+
+  // per-run access, shared with CompactRunList for the region algorithms
+  inline Run getRun(int i) const {
+    return runs[i];
+  }
+  inline void setRun(int i, const Run & r) {
+    runs[i]=r;
+  }
+  inline int getY(int i) const {
+    return runs[i].y;
+  }
+  inline raw8 getColor(int i) const {
+    return runs[i].color;
+  }
+  inline int getParent(int i) const {
+    return runs[i].parent;
+  }
+  inline void setParent(int i, int parent) {
+    runs[i].parent=parent;
+  }
+  inline void setNext(int i, int next) {
+    runs[i].next=next;
+  }
 };
 
+/*!
+  \class CompactRunList
+  \brief A run table with 16-bit coordinates in structure-of-arrays layout
+
+  Holds the same runs as RunList in 15 instead of 24 bytes per run, and
+  keeps each field in its own array, so that the parent chasing in
+  connectComponents and extractRegions stays in cache on large images.
+  Coordinates and widths are 16-bit, which limits images to 65535 pixels
+  in each direction.
+*/
+class CompactRunList {
+private:
+  uint16_t * xs;
+  uint16_t * ys;
+  uint16_t * widths;
+  raw8 * colors;
+  int32_t * parents;
+  int32_t * nexts;
+  int max_runs;
+  int used_runs;
+  int dropped_runs;
+public:
+  static const int MaxCoordinate = 65535;
+
+  CompactRunList(int _max_runs) {
+    // one spare run, connectComponents reads one past the last used run
+    xs=new uint16_t[_max_runs + 1];
+    ys=new uint16_t[_max_runs + 1];
+    widths=new uint16_t[_max_runs + 1];
+    colors=new raw8[_max_runs + 1];
+    parents=new int32_t[_max_runs + 1];
+    nexts=new int32_t[_max_runs + 1];
+    max_runs=_max_runs;
+    used_runs=0;
+    dropped_runs=0;
+  }
+  ~CompactRunList() {
+    delete[] xs;
+    delete[] ys;
+    delete[] widths;
+    delete[] colors;
+    delete[] parents;
+    delete[] nexts;
+  }
+  void setUsedRuns(int runs) {
+    used_runs=runs;
+  }
+  int getUsedRuns() {
+    return used_runs;
+  }
+  void setDroppedRuns(int runs) {
+    dropped_runs=runs;
+  }
+  int getDroppedRuns() {
+    return dropped_runs;
+  }
+  int getMaxRuns() {
+    return max_runs;
+  }
+
+  inline Run getRun(int i) const {
+    Run r;
+    r.x=xs[i];
+    r.y=ys[i];
+    r.width=widths[i];
+    r.color=colors[i];
+    r.parent=parents[i];
+    r.next=nexts[i];
+    return r;
+  }
+  inline void setRun(int i, const Run & r) {
+    xs[i]=(uint16_t)r.x;
+    ys[i]=(uint16_t)r.y;
+    widths[i]=(uint16_t)r.width;
+    colors[i]=r.color;
+    parents[i]=r.parent;
+    nexts[i]=r.next;
+  }
+  inline int getY(int i) const {
+    return ys[i];
+  }
+  inline raw8 getColor(int i) const {
+    return colors[i];
+  }
+  inline int getParent(int i) const {
+    return parents[i];
+  }
+  inline void setParent(int i, int parent) {
+    parents[i]=parent;
+  }
+  inline void setNext(int i, int next) {
+    nexts[i]=next;
+  }
+};
 
 
+/*!
+  \class RunColorFilter
+  \brief The labels of a thresholded image that are encoded as runs
+
+  Labels that no detector needs as regions, such as the field color, are
+  run length encoded like clear pixels. They then cost neither runs nor
+  union-find work nor regions. The clear label 0 is never a region color.
+
+  A minimum run width per label suppresses sensor noise: a shorter run is
+  encoded as clear unless it touches a run of the same label in the
+  previous row that is at least that wide.
+*/
+class RunColorFilter {
+private:
+  bool region_color[256];
+  bool all_region_colors;
+  int min_width[256];
+  bool has_min_widths;
+  // nibble lookup tables, label b matches if lo[b & 15] & hi[b >> 4] != 0
+  alignas(16) uint8_t lo_table[16];
+  alignas(16) uint8_t hi_table[16];
+  bool vectorizable;  // no region color above 127
+public:
+  RunColorFilter() {
+    setAllRegionColors(false);
+    clearMinWidths();
+  }
+  void setAllRegionColors(bool enable);
+  void setRegionColor(int label, bool enable);
+  inline bool isRegionColor(uint8_t label) const {
+    return region_color[label];
+  }
+  void clearMinWidths();
+  void setMinWidth(int label, int width);
+  inline int getMinWidth(uint8_t label) const {
+    return min_width[label];
+  }
+  bool hasMinWidths() const {
+    return has_min_widths;
+  }
+  /// the first x at or after start with a region color, or width if there is none
+  int findRegionColor(const raw8 * row, int x, int width) const;
+};
+
 class Region{
   public:
   raw8 color;        // id of the color
@@ -286,15 +456,27 @@ protected:
     return(rs / 6);
   }
 
+  // the algorithms for both run table layouts
+  template <typename RunTable>
+  static void encodeRunsT(Image<raw8> * tmap, RunTable * runlist, const CMVision::RunColorFilter * filter);
+  template <typename RunTable>
+  static void connectComponentsT(RunTable * runlist);
+  template <typename RunTable>
+  static void extractRegionsT(CMVision::RegionList * reglist, RunTable * runlist);
+
 
 public:
     RegionProcessing();
 
     ~RegionProcessing();
 
-    static void encodeRuns(Image<raw8> * tmap, CMVision::RunList * runlist);
+    // without a filter, all labels but clear are encoded as runs
+    static void encodeRuns(Image<raw8> * tmap, CMVision::RunList * runlist, const CMVision::RunColorFilter * filter = nullptr);
+    static void encodeRuns(Image<raw8> * tmap, CMVision::CompactRunList * runlist, const CMVision::RunColorFilter * filter = nullptr);
     static void connectComponents(CMVision::RunList * runlist);
+    static void connectComponents(CMVision::CompactRunList * runlist);
     static void extractRegions(CMVision::RegionList * reglist, CMVision::RunList * runlist);
+    static void extractRegions(CMVision::RegionList * reglist, CMVision::CompactRunList * runlist);
     //returns the max area found:
     static int  separateRegions(CMVision::ColorRegionList * colorlist, CMVision::RegionList * reglist, int min_area, double min_pixel_ratio);
 
@@ -20,6 +20,8 @@
 */
 //========================================================================
 #include "cmvision_threshold.h"
+#include <string.h>
+#include <algorithm>
 #ifdef __AVX2__
 #include <x86intrin.h>
 #endif
@@ -33,102 +35,70 @@ CMVisionThreshold::~CMVisionThreshold()
 {
 }
 
-bool CMVisionThreshold::thresholdImageYUV422_UYVY(Image<raw8> * target, const RawImage * source, YUVLUT * lut, const ImageInterface* mask) {
-  if (source->getColorFormat()!=COLOR_YUV422_UYVY) {
-    //TODO add YUV444 and maybe even 411 mode
-    fprintf(stderr,"CMVision thresholdImageYUV422_UYVY assumes YUV422 as input, but found %s\n", Colors::colorFormatToString(source->getColorFormat()).c_str());
-    return false;
-  }
-
-  register lut_mask_t * LUT = lut->getTable();
-
-  register unsigned int          target_size    = target->getNumPixels();
-  register uyvy *       source_pointer = (uyvy*)(source->getData());
-  register raw8 *      target_pointer = target->getPixelData();
-  register unsigned char *      mask_pointer = mask->getData();
+/// The bit layout of a LUT, read once per image
+class LUTLayout {
+  int X_SHIFT;
+  int Y_SHIFT;
+  int Z_SHIFT;
+  int Z_AND_Y_BITS;
+  int Z_BITS;
+public:
+  explicit LUTLayout(const LUT3D * lut) :
+    X_SHIFT(lut->X_SHIFT), Y_SHIFT(lut->Y_SHIFT), Z_SHIFT(lut->Z_SHIFT),
+    Z_AND_Y_BITS(lut->Z_AND_Y_BITS), Z_BITS(lut->Z_BITS) {}
+  inline int xShift() const { return X_SHIFT; }
+  inline int yShift() const { return Y_SHIFT; }
+  inline int zShift() const { return Z_SHIFT; }
+  inline int zAndYBits() const { return Z_AND_Y_BITS; }
+  inline int zBits() const { return Z_BITS; }
+};
 
-  if (target->getNumPixels() != source->getNumPixels()) {
-    fprintf(stderr, "CMVision YUV422_UYVY thresholding: source (num=%d  w=%d  h=%d) and target (num=%d w=%d h=%d) pixel counts do not match!\n", source->getNumPixels(),source->getWidth(),source->getHeight(), target->getNumPixels(),target->getWidth(),target->getHeight());
-    return false;
-  }
-
-  lut->lock();
-  int X_SHIFT=lut->X_SHIFT;
-  int Y_SHIFT=lut->Y_SHIFT;
-  int Z_SHIFT=lut->Z_SHIFT;
-  int Z_AND_Y_BITS=lut->Z_AND_Y_BITS;
-  int Z_BITS = lut->Z_BITS;
+static void thresholdYUV422_UYVY(const LUTLayout & layout, const lut_mask_t * LUT, raw8 * target_pointer,
+                                 const uyvy * source_pointer, int begin, int end) {
   uyvy p;
-  for (unsigned int i=0;i<target_size;i+=2) {
+  // pixels come in pairs, an odd border pixel is cleared by thresholdRows
+  for (int i=(begin & ~1);i<end;i+=2) {
     p=source_pointer[(i >> 0x01)];
-    register int B=((p.u >> Y_SHIFT) << Z_BITS);
-    register int C=(p.v >> Z_SHIFT);
-    target_pointer[i] =  mask_pointer[i] & LUT[(((p.y1 >> X_SHIFT) << Z_AND_Y_BITS) | B | C)];
-    target_pointer[i+1] =  mask_pointer[i+1] & LUT[(((p.y2 >> X_SHIFT) << Z_AND_Y_BITS) | B | C)];
+    int B=((p.u >> layout.yShift()) << layout.zBits());
+    int C=(p.v >> layout.zShift());
+    target_pointer[i] =  LUT[(((p.y1 >> layout.xShift()) << layout.zAndYBits()) | B | C)];
+    target_pointer[i+1] =  LUT[(((p.y2 >> layout.xShift()) << layout.zAndYBits()) | B | C)];
   }
-  lut->unlock();
-  return true;
 }
 
-bool CMVisionThreshold::thresholdImageYUV444(Image<raw8> * target, const ImageInterface * source, YUVLUT * lut, const ImageInterface* mask) {
-  if (source->getColorFormat()!=COLOR_YUV444) {
-    fprintf(stderr,"CMVision thresholdImageYUV444 assumes YUV444 as input, but found %s\n", Colors::colorFormatToString(source->getColorFormat()).c_str());
-    return false;
-  }
-
-  register lut_mask_t * LUT = lut->getTable();
-
-  register unsigned int          target_size    = target->getNumPixels();
-  register yuv  *                source_pointer = (yuv*)(source->getData());
-  register raw8 *                target_pointer = target->getPixelData();
-  register unsigned char *       mask_pointer = mask->getData();
-
-  if (target->getNumPixels() != source->getNumPixels()) {
-     fprintf(stderr, "CMVision YUV444 thresholding: source (num=%d  w=%d  h=%d) and target (num=%d w=%d h=%d) pixel counts do not match!\n", source->getNumPixels(),source->getWidth(),source->getHeight(), target->getNumPixels(),target->getWidth(),target->getHeight());
-    return false;
-  }
-
-  lut->lock();
-  int X_SHIFT=lut->X_SHIFT;
-  int Y_SHIFT=lut->Y_SHIFT;
-  int Z_SHIFT=lut->Z_SHIFT;
-  int Z_AND_Y_BITS=lut->Z_AND_Y_BITS;
-  int Z_BITS = lut->Z_BITS;
+static void thresholdYUV444(const LUTLayout & layout, const lut_mask_t * LUT, raw8 * target_pointer,
+                            const yuv * source_pointer, int begin, int end) {
   yuv p;
-  for (unsigned int i=0;i<target_size;i++) {
+  for (int i=begin;i<end;i++) {
     p=source_pointer[i];
-    target_pointer[i] =  mask_pointer[i] & LUT[(((p.y >> X_SHIFT) << Z_AND_Y_BITS) | ((p.u >> Y_SHIFT) << Z_BITS) | (p.v >> Z_SHIFT))];
+    target_pointer[i] =  LUT[(((p.y >> layout.xShift()) << layout.zAndYBits()) | ((p.u >> layout.yShift()) << layout.zBits()) | (p.v >> layout.zShift()))];
   }
-  lut->unlock();
-
-  return true;
 }
 
-
-
-bool CMVisionThreshold::thresholdImageRGB(Image<raw8> * target, const ImageInterface * source, RGBLUT * lut, const ImageInterface* mask) {
-  if (source->getColorFormat()!=COLOR_RGB8) {
-    fprintf(stderr,"CMVision RGB thresholding assumes RGB8 as input, but found %s\n", Colors::colorFormatToString(source->getColorFormat()).c_str());
-    return false;
+static void thresholdYUV422_UYVY(const LUTLayout & layout, const CompressedLUT * LUT, raw8 * target_pointer,
+                                 const uyvy * source_pointer, int begin, int end) {
+  uyvy p;
+  for (int i=(begin & ~1);i<end;i+=2) {
+    p=source_pointer[(i >> 0x01)];
+    unsigned int B=(p.u >> layout.yShift());
+    unsigned int C=(p.v >> layout.zShift());
+    target_pointer[i] =  LUT->get_preshrunk(p.y1 >> layout.xShift(), B, C);
+    target_pointer[i+1] =  LUT->get_preshrunk(p.y2 >> layout.xShift(), B, C);
   }
+}
 
-  register lut_mask_t * LUT = lut->getTable();
-  int source_size    = source->getNumPixels();
-  const rgb * source_pointer = (const rgb*)(source->getData());
-  auto * target_pointer = (uint8_t*) target->getPixelData();
-  auto * mask_pointer = mask->getData();
-
-  if (target->getNumPixels() != source->getNumPixels()) {
-    fprintf(stderr, "CMVision RGB thresholding: source (num=%d  w=%d  h=%d) and target (num=%d w=%d h=%d) pixel counts do not match!\n", source->getNumPixels(),source->getWidth(),source->getHeight(), target->getNumPixels(),target->getWidth(),target->getHeight());
-    return false;
+static void thresholdYUV444(const LUTLayout & layout, const CompressedLUT * LUT, raw8 * target_pointer,
+                            const yuv * source_pointer, int begin, int end) {
+  yuv p;
+  for (int i=begin;i<end;i++) {
+    p=source_pointer[i];
+    target_pointer[i] =  LUT->get_preshrunk(p.y >> layout.xShift(), p.u >> layout.yShift(), p.v >> layout.zShift());
   }
+}
 
-  int X_SHIFT=lut->X_SHIFT;
-  int Y_SHIFT=lut->Y_SHIFT;
-  int Z_SHIFT=lut->Z_SHIFT;
-  int Z_AND_Y_BITS=lut->Z_AND_Y_BITS;
-  int Z_BITS = lut->Z_BITS;
-
+static void thresholdRGB(const LUTLayout & layout, const lut_mask_t * LUT, uint8_t * target_pointer,
+                         const rgb * source_pointer, int begin, int end) {
+  int i=begin;
 #ifdef __AVX2__
   // unpacking from: https://docs.google.com/presentation/d/1I0-SiHid1hTsv7tjLST2dYW5YF5AJVfs9l4Rg9rvz48/edit#slide=id.g1eefe20b_0_125
   __m128i ssse3_red_indeces_0 = _mm_set_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 15, 12, 9, 6, 3, 0);
@@ -142,10 +112,9 @@ bool CMVisionThreshold::thresholdImageRGB(Image<raw8> * target, const ImageInter
   __m128i ssse3_blue_indeces_2 = _mm_set_epi8(15, 12, 9, 6, 3, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
 
   uint16_t idx[16];
-  const rgb* p=&source_pointer[0];
-  const uint8_t* source_pixel = (const uint8_t*)p;
+  const uint8_t* source_pixel = (const uint8_t*)&source_pointer[i];
 
-  for (int i=0; i<source_size; i+=16) {
+  for (; i+16<=end; i+=16) {
 
     // crazy RGB unpacking
     const __m128i chunk0 = _mm_loadu_si128((const __m128i*)(source_pixel));
@@ -166,9 +135,9 @@ bool CMVisionThreshold::thresholdImageRGB(Image<raw8> * target, const ImageInter
     __m256i g = _mm256_cvtepu8_epi16(green);
 
     // do the original shifts on 16 values in parallel
-    __m256i rs = _mm256_slli_epi16(_mm256_srli_epi16(r, X_SHIFT), Z_AND_Y_BITS);
-    __m256i gs = _mm256_slli_epi16(_mm256_srli_epi16(g, Y_SHIFT), Z_BITS);
-    __m256i bs = _mm256_srli_epi16(b, Z_SHIFT);
+    __m256i rs = _mm256_slli_epi16(_mm256_srli_epi16(r, layout.xShift()), layout.zAndYBits());
+    __m256i gs = _mm256_slli_epi16(_mm256_srli_epi16(g, layout.yShift()), layout.zBits());
+    __m256i bs = _mm256_srli_epi16(b, layout.zShift());
 
     // construct LUT indices (ORing)
     __m256i result = _mm256_or_si256(rs, _mm256_or_si256(gs, bs));
@@ -177,16 +146,126 @@ bool CMVisionThreshold::thresholdImageRGB(Image<raw8> * target, const ImageInter
 
 #pragma GCC unroll 16
     for(int j=0; j<16; j++) {
-      target_pointer[i+j] = mask_pointer[i] & LUT[idx[j]];
+      target_pointer[i+j] = LUT[idx[j]];
     }
   }
-#else
+#endif
   #pragma GCC unroll 4
-  for (int i=0; i<source_size; i++) {
+  for (; i<end; i++) {
     rgb p=source_pointer[i];
-    target_pointer[i] = mask_pointer[i] & LUT[(((p.r >> X_SHIFT) << Z_AND_Y_BITS) | ((p.g >> Y_SHIFT) << Z_BITS) | (p.b >> Z_SHIFT))];
+    target_pointer[i] = LUT[(((p.r >> layout.xShift()) << layout.zAndYBits()) | ((p.g >> layout.yShift()) << layout.zBits()) | (p.b >> layout.zShift()))];
   }
-#endif
+}
+
+/// Runs kernel(begin, end) on the in-mask pixels of each row and clears
+/// the rest of the row, so masked-out pixels cost neither a source read
+/// nor a LUT lookup. Without spans, the whole image is one range.
+template <typename Kernel>
+static void thresholdRows(raw8 * target_pointer, int width, int height, const ImageRowSpan * mask_spans, Kernel kernel) {
+  if (mask_spans == nullptr) {
+    kernel(0, width * height);
+    return;
+  }
+  for (int y=0;y<height;y++) {
+    const int start = std::min(std::max(mask_spans[y].start, 0), width);
+    const int end = std::min(std::max(mask_spans[y].end, start), width);
+    raw8 * row = target_pointer + y * width;
+    if (end > start) {
+      kernel(y * width + start, y * width + end);
+    }
+    // after the kernel, which may have written a neighbour of an odd border
+    memset((void *) row, 0, start * sizeof(raw8));
+    memset((void *) (row + end), 0, (width - end) * sizeof(raw8));
+  }
+}
+
+bool CMVisionThreshold::thresholdImageYUV422_UYVY(Image<raw8> * target, const RawImage * source, YUVLUT * lut, const ImageRowSpan * mask_spans) {
+  if (source->getColorFormat()!=COLOR_YUV422_UYVY) {
+    //TODO add YUV444 and maybe even 411 mode
+    fprintf(stderr,"CMVision thresholdImageYUV422_UYVY assumes YUV422 as input, but found %s\n", Colors::colorFormatToString(source->getColorFormat()).c_str());
+    return false;
+  }
+
+  const uyvy *          source_pointer = (const uyvy*)(source->getData());
+  raw8 *                target_pointer = target->getPixelData();
+
+  if (target->getNumPixels() != source->getNumPixels()) {
+    fprintf(stderr, "CMVision YUV422_UYVY thresholding: source (num=%d  w=%d  h=%d) and target (num=%d w=%d h=%d) pixel counts do not match!\n", source->getNumPixels(),source->getWidth(),source->getHeight(), target->getNumPixels(),target->getWidth(),target->getHeight());
+    return false;
+  }
+
+  int lut_handle;
+  const lut_mask_t * LUT = lut->acquireTable(lut_handle);
+  const LUTLayout layout(lut);
+  const CompressedLUT * compressed = lut->getCompressedTable(lut_handle);
+  if (compressed != 0) {
+    thresholdRows(target->getPixelData(), target->getWidth(), target->getHeight(), mask_spans, [&](int begin, int end) {
+      thresholdYUV422_UYVY(layout, compressed, target_pointer, source_pointer, begin, end);
+    });
+  } else {
+    thresholdRows(target->getPixelData(), target->getWidth(), target->getHeight(), mask_spans, [&](int begin, int end) {
+      thresholdYUV422_UYVY(layout, LUT, target_pointer, source_pointer, begin, end);
+    });
+  }
+  lut->releaseTable(lut_handle);
+  return true;
+}
+
+bool CMVisionThreshold::thresholdImageYUV444(Image<raw8> * target, const ImageInterface * source, YUVLUT * lut, const ImageRowSpan * mask_spans) {
+  if (source->getColorFormat()!=COLOR_YUV444) {
+    fprintf(stderr,"CMVision thresholdImageYUV444 assumes YUV444 as input, but found %s\n", Colors::colorFormatToString(source->getColorFormat()).c_str());
+    return false;
+  }
+
+  const yuv *           source_pointer = (const yuv*)(source->getData());
+  raw8 *                target_pointer = target->getPixelData();
+
+  if (target->getNumPixels() != source->getNumPixels()) {
+     fprintf(stderr, "CMVision YUV444 thresholding: source (num=%d  w=%d  h=%d) and target (num=%d w=%d h=%d) pixel counts do not match!\n", source->getNumPixels(),source->getWidth(),source->getHeight(), target->getNumPixels(),target->getWidth(),target->getHeight());
+    return false;
+  }
+
+  int lut_handle;
+  const lut_mask_t * LUT = lut->acquireTable(lut_handle);
+  const LUTLayout layout(lut);
+  const CompressedLUT * compressed = lut->getCompressedTable(lut_handle);
+  if (compressed != 0) {
+    thresholdRows(target->getPixelData(), target->getWidth(), target->getHeight(), mask_spans, [&](int begin, int end) {
+      thresholdYUV444(layout, compressed, target_pointer, source_pointer, begin, end);
+    });
+  } else {
+    thresholdRows(target->getPixelData(), target->getWidth(), target->getHeight(), mask_spans, [&](int begin, int end) {
+      thresholdYUV444(layout, LUT, target_pointer, source_pointer, begin, end);
+    });
+  }
+  lut->releaseTable(lut_handle);
+
+  return true;
+}
+
+
+
+bool CMVisionThreshold::thresholdImageRGB(Image<raw8> * target, const ImageInterface * source, RGBLUT * lut, const ImageRowSpan * mask_spans) {
+  if (source->getColorFormat()!=COLOR_RGB8) {
+    fprintf(stderr,"CMVision RGB thresholding assumes RGB8 as input, but found %s\n", Colors::colorFormatToString(source->getColorFormat()).c_str());
+    return false;
+  }
+
+  const rgb * source_pointer = (const rgb*)(source->getData());
+  auto * target_pointer = (uint8_t*) target->getPixelData();
+
+  if (target->getNumPixels() != source->getNumPixels()) {
+    fprintf(stderr, "CMVision RGB thresholding: source (num=%d  w=%d  h=%d) and target (num=%d w=%d h=%d) pixel counts do not match!\n", source->getNumPixels(),source->getWidth(),source->getHeight(), target->getNumPixels(),target->getWidth(),target->getHeight());
+    return false;
+  }
+
+  int lut_handle;
+  const lut_mask_t * LUT = lut->acquireTable(lut_handle);
+  const LUTLayout layout(lut);
+  thresholdRows(target->getPixelData(), target->getWidth(), target->getHeight(), mask_spans, [&](int begin, int end) {
+    thresholdRGB(layout, LUT, target_pointer, source_pointer, begin, end);
+  });
+  lut->releaseTable(lut_handle);
 
   return true;
 }
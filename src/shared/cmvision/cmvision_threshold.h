@@ -27,6 +27,7 @@
 #include "image.h"
 #include "colors.h"
 #include "timer.h"
+#include "image_row_span.h"
 
 /**
 	@author James Bruce (Original CMVision implementation and algorithms),
@@ -38,9 +39,11 @@ public:
 
     ~CMVisionThreshold();
 
-  static bool thresholdImageYUV422_UYVY(Image<raw8> * target, const RawImage * source, YUVLUT * lut, const ImageInterface* mask);
-  static bool thresholdImageYUV444(Image<raw8> * target, const ImageInterface * source, YUVLUT * lut, const ImageInterface* mask);
-  static bool thresholdImageRGB(Image<raw8> * target, const ImageInterface * source, RGBLUT * lut, const ImageInterface* mask);
+  // mask_spans holds one span per target row, pixels outside of it are set to 0.
+  // Without spans, the whole image is thresholded.
+  static bool thresholdImageYUV422_UYVY(Image<raw8> * target, const RawImage * source, YUVLUT * lut, const ImageRowSpan * mask_spans = nullptr);
+  static bool thresholdImageYUV444(Image<raw8> * target, const ImageInterface * source, YUVLUT * lut, const ImageRowSpan * mask_spans = nullptr);
+  static bool thresholdImageRGB(Image<raw8> * target, const ImageInterface * source, RGBLUT * lut, const ImageRowSpan * mask_spans = nullptr);
 };
 
 #endif
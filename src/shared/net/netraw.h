@@ -9,6 +9,8 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <atomic>
+
 namespace Net{
 
 //====================================================================//
@@ -40,6 +42,10 @@ public:
     {reset();}
 
   in_addr_t getInAddr() const;
+  const sockaddr * getSockAddr() const
+    {return(&addr);}
+  socklen_t getSockAddrLen() const
+    {return(addr_len);}
 
   void print(FILE *out = stdout) const;
 
@@ -54,10 +60,11 @@ public:
 class UDP {
   int fd;
 public:
-  unsigned sent_packets;
-  unsigned sent_bytes;
-  unsigned recv_packets;
-  unsigned recv_bytes;
+  // atomic, as several threads may send on the same socket
+  std::atomic<unsigned> sent_packets;
+  std::atomic<unsigned> sent_bytes;
+  std::atomic<unsigned> recv_packets;
+  std::atomic<unsigned> recv_bytes;
 public:
   UDP() {fd=-1; close();}
   ~UDP() {close();}
@@ -20,6 +20,47 @@
 //========================================================================
 #include "robocup_ssl_server.h"
 #include "timer.h"
+#include <stdint.h>
+
+static int writeVarint(uint8_t * target, uint64_t value) {
+  int n=0;
+  while (value >= 0x80) {
+    target[n++]=(uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  target[n++]=(uint8_t)value;
+  return n;
+}
+
+static uint32_t makeTag(int field_number, int wire_type) {
+  return ((uint32_t)field_number << 3) | wire_type;
+}
+
+SSLDetectionPacket::SSLDetectionPacket()
+{
+  full_size=0;
+  legacy_size=0;
+  frame_number=-1;
+}
+
+void SSLDetectionPacket::encode(const SSL_DetectionFrame & frame, long long number) {
+  static const int WireTypeVarint = 0;
+  static const int WireTypeLengthDelimited = 2;
+  size_t frame_size = frame.ByteSizeLong();
+  //room for the detection tag and length, the frame, and the source tag and value:
+  buffer.resize(1 + 10 + frame_size + 1 + 10);
+  uint8_t * target = (uint8_t *) &buffer[0];
+  int n=0;
+  n += writeVarint(target + n, makeTag(SSL_WrapperPacket::kDetectionFieldNumber, WireTypeLengthDelimited));
+  n += writeVarint(target + n, frame_size);
+  frame.SerializeWithCachedSizesToArray(target + n);
+  n += frame_size;
+  legacy_size=n;
+  n += writeVarint(target + n, makeTag(SSL_WrapperPacket::kSourceFieldNumber, WireTypeVarint));
+  n += writeVarint(target + n, SSL_SOURCE_SSL_VISION);
+  full_size=n;
+  frame_number=number;
+}
 
 RoboCupSSLServer::RoboCupSSLServer(int port,
                      string net_address,
@@ -28,15 +69,36 @@ RoboCupSSLServer::RoboCupSSLServer(int port,
   _port=port;
   _net_address=net_address;
   _net_interface=net_interface;
-
+  sender=nullptr;
+  use_sender=false;
+  shm=nullptr;
 }
 
 
 RoboCupSSLServer::~RoboCupSSLServer()
 {
+  closeSharedMemory();
+}
+
+bool RoboCupSSLServer::openSharedMemory(const string & name) {
+  closeSharedMemory();
+  shm = new RoboCupSSLShmServer(name);
+  if (!shm->open()) {
+    closeSharedMemory();
+    return false;
+  }
+  return true;
+}
+
+void RoboCupSSLServer::closeSharedMemory() {
+  delete shm;
+  shm=nullptr;
 }
 
 void RoboCupSSLServer::close() {
+  //datagrams still queued for this socket must go out before it is closed
+  if (use_sender) sender->flush();
+  use_sender=false;
   mc.close();
 }
 
@@ -48,7 +110,7 @@ bool RoboCupSSLServer::open() {
     return(false);
   }
 
-  Net::Address multiaddr,interface;
+  Net::Address interface;
   multiaddr.setHost(_net_address.c_str(),_port);
   if(_net_interface.length() > 0){
     interface.setHost(_net_interface.c_str(),_port);
@@ -61,50 +123,95 @@ bool RoboCupSSLServer::open() {
     fflush(stderr);
     return(false);
   }
+
+  if (sender != nullptr) {
+    sender->configureSocket(mc.getFd());
+    use_sender=sender->isEnabled();
+  }
   return(true);
 }
 
-bool RoboCupSSLServer::send(const SSL_DetectionFrame & frame) {
-  SSL_WrapperPacket pkt;
-  pkt.set_source(SSL_SOURCE_SSL_VISION);
-  SSL_DetectionFrame * nframe = pkt.mutable_detection();
-  nframe->CopyFrom(frame);
-  mutex.lock();
-  nframe->set_t_sent(GetTimeSec());
-  bool ret = sendWrapperPacket<SSL_WrapperPacket>(pkt);
-  mutex.unlock();
+bool RoboCupSSLServer::sendBuffer(const char * data, int length) {
+  if (shm != nullptr) {
+    shm->send(data,length);
+  }
+  if (use_sender) {
+    return sender->enqueue(mc.getFd(),multiaddr,data,length);
+  }
+  bool result=mc.send(data,length,multiaddr);
+  if (result==false) {
+    perror("Sendto Error");
+    fprintf(stderr,
+            "Sending UDP datagram to %s:%d failed (maybe too large?). "
+            "Size was: %d byte(s)\n",
+            _net_address.c_str(),
+            _port,
+            length);
+  }
+  return(result);
+}
+
+bool RoboCupSSLServer::send(const SSLDetectionPacket & packet) {
+  lock.lockForRead();
+  bool ret = sendBuffer(packet.data(), packet.size());
+  lock.unlock();
   return ret;
 }
 
+bool RoboCupSSLServer::sendLegacyMessage(const SSLDetectionPacket & packet) {
+  lock.lockForRead();
+  bool ret = sendBuffer(packet.data(), packet.legacySize());
+  lock.unlock();
+  return ret;
+}
+
+bool RoboCupSSLServer::send(const SSL_DetectionFrame & frame) {
+  //one buffer per sending (capture) thread
+  static thread_local SSLDetectionPacket packet;
+  packet.encode(frame);
+  return send(packet);
+}
+
 bool RoboCupSSLServer::send(const SSL_GeometryData & geometry) {
   SSL_WrapperPacket pkt;
   pkt.set_source(SSL_SOURCE_SSL_VISION);
   SSL_GeometryData * gdata = pkt.mutable_geometry();
   gdata->CopyFrom(geometry);
-  mutex.lock();
+  lock.lockForRead();
   bool ret = sendWrapperPacket<SSL_WrapperPacket>(pkt);
-  mutex.unlock();
+  lock.unlock();
   return ret;
 }
 
-bool RoboCupSSLServer::sendLegacyMessage(const SSL_DetectionFrame& frame) {
-  RoboCup2014Legacy::Wrapper::SSL_WrapperPacket pkt;
-  SSL_DetectionFrame * nframe = pkt.mutable_detection();
-  nframe->CopyFrom(frame);
-  mutex.lock();
-  nframe->set_t_sent(GetTimeSec());
-  bool ret = sendWrapperPacket<RoboCup2014Legacy::Wrapper::SSL_WrapperPacket>(pkt);
-  mutex.unlock();
+bool RoboCupSSLServer::send(const SSL_WrapperPacket & packet, string & buffer) {
+  packet.SerializeToString(&buffer);
+  lock.lockForRead();
+  bool ret = sendBuffer(buffer.data(), buffer.length());
+  lock.unlock();
+  return ret;
+}
+
+bool RoboCupSSLServer::send(const TrackerWrapperPacket & packet, string & buffer) {
+  packet.SerializeToString(&buffer);
+  lock.lockForRead();
+  bool ret = sendBuffer(buffer.data(), buffer.length());
+  lock.unlock();
   return ret;
 }
 
+bool RoboCupSSLServer::sendLegacyMessage(const SSL_DetectionFrame& frame) {
+  static thread_local SSLDetectionPacket packet;
+  packet.encode(frame);
+  return sendLegacyMessage(packet);
+}
+
 bool RoboCupSSLServer::sendLegacyMessage(
     const RoboCup2014Legacy::Geometry::SSL_GeometryData& geometry) {
   RoboCup2014Legacy::Wrapper::SSL_WrapperPacket pkt;
   RoboCup2014Legacy::Geometry::SSL_GeometryData * gdata = pkt.mutable_geometry();
   gdata->CopyFrom(geometry);
-  mutex.lock();
+  lock.lockForRead();
   bool ret = sendWrapperPacket<RoboCup2014Legacy::Wrapper::SSL_WrapperPacket>(pkt);
-  mutex.unlock();
+  lock.unlock();
   return ret;
 }
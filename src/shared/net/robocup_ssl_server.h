@@ -21,14 +21,54 @@
 #ifndef ROBOCUP_SSL_SERVER_H
 #define ROBOCUP_SSL_SERVER_H
 #include "netraw.h"
+#include "udp_sender.h"
+#include "robocup_ssl_shm.h"
 #include <string>
-#include <QMutex>
+#include <QReadWriteLock>
 #include "messages_robocup_ssl_detection.pb.h"
 #include "messages_robocup_ssl_geometry.pb.h"
 #include "messages_robocup_ssl_geometry_legacy.pb.h"
 #include "messages_robocup_ssl_wrapper.pb.h"
 #include "messages_robocup_ssl_wrapper_legacy.pb.h"
+#include "messages_robocup_ssl_wrapper_tracked.pb.h"
 using namespace std;
+
+/*!
+  \class  SSLDetectionPacket
+  \brief  Reusable wire encoding of a detection wrapper packet
+
+  The detection frame is serialized directly behind the wrapper header
+  into a buffer that is kept across frames, so no wrapper message and no
+  copy of the frame are created. Protobuf writes fields in field number
+  order, and the current wrapper only adds the source field behind the
+  detection, so the legacy wrapper is a prefix of the same bytes.
+*/
+class SSLDetectionPacket {
+protected:
+  string buffer;
+  int full_size;
+  int legacy_size;
+  long long frame_number;
+public:
+  SSLDetectionPacket();
+
+  /// encode frame, frame_number identifies the FrameData it came from
+  void encode(const SSL_DetectionFrame & frame, long long frame_number=-1);
+  bool isEncoded(long long number) const {
+    return legacy_size > 0 && frame_number == number;
+  }
+
+  const char * data() const {
+    return buffer.data();
+  }
+  int size() const {
+    return full_size;
+  }
+  int legacySize() const {
+    return legacy_size;
+  }
+};
+
 /**
 	@author Stefan Zickler
 */
@@ -36,11 +76,18 @@ class RoboCupSSLServer{
 friend class MultiStackRoboCupSSL;
 protected:
   Net::UDP mc; // multicast server
-  QMutex mutex;
+  Net::Address multiaddr; // resolved in open()
+  UDPSender * sender; // optional, shared with other servers
+  bool use_sender; // sender setting, read in open()
+  RoboCupSSLShmServer * shm; // optional copy of every packet for local clients
+  // senders only share the socket, reconfiguration needs exclusive access
+  QReadWriteLock lock;
   int _port;
   string _net_address;
   string _net_interface;
 
+  bool sendBuffer(const char * data, int length);
+
 public:
     RoboCupSSLServer(int port,
                      string net_ref_address,
@@ -49,28 +96,31 @@ public:
     ~RoboCupSSLServer();
     bool open();
     void close();
+
+    /// send through the given sender thread instead of the calling thread.
+    /// takes effect on the next open().
+    void setSender(UDPSender * _sender) {
+      sender=_sender;
+      if (sender==nullptr) use_sender=false;
+    }
+
+    /// additionally write every packet into the shared-memory ring called name
+    bool openSharedMemory(const string & name);
+    void closeSharedMemory();
     template <typename T>
     bool sendWrapperPacket(const T & packet) {
       string buffer;
       packet.SerializeToString(&buffer);
-      Net::Address multiaddr;
-      multiaddr.setHost(_net_address.c_str(),_port);
-      bool result;
-      result=mc.send(buffer.c_str(),buffer.length(),multiaddr);
-      if (result==false) {
-        perror("Sendto Error");
-        fprintf(stderr,
-                "Sending UDP datagram to %s:%d failed (maybe too large?). "
-                "Size was: %zu byte(s)\n",
-                _net_address.c_str(),
-                _port,
-                buffer.length());
-      }
-      return(result);
+      return sendBuffer(buffer.data(),buffer.length());
     }
 
+    bool send(const SSLDetectionPacket & packet);
+    bool sendLegacyMessage(const SSLDetectionPacket & packet);
     bool send(const SSL_DetectionFrame & frame);
     bool send(const SSL_GeometryData & geometry);
+    /// these serialize into a buffer that the caller keeps across packets
+    bool send(const SSL_WrapperPacket & packet, string & buffer);
+    bool send(const TrackerWrapperPacket & packet, string & buffer);
     bool sendLegacyMessage(
         const RoboCup2014Legacy::Geometry::SSL_GeometryData & geometry);
     bool sendLegacyMessage(const SSL_DetectionFrame & frame);
@@ -0,0 +1,372 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    robocup_ssl_shm.cpp
+  \brief   C++ Implementation: RoboCupSSLShmServer, RoboCupSSLShmClient
+*/
+//========================================================================
+#include "robocup_ssl_shm.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <time.h>
+#include <thread>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+static const char ShmMagic[8] = {'S','S','L','S','H','M','R','G'};
+
+// how often a writer yields while the previous lap of its slot is still being written,
+// before it drops its packet
+static const int kMaxLapWait = 10000;
+
+const char * RoboCupSSLShmRing::DefaultName = "/ssl-vision";
+
+size_t RoboCupSSLShmRing::getSlotStride(uint32_t slot_size) {
+  //keep every slot header 8-byte aligned
+  return (sizeof(Slot) + slot_size + 7) & ~((size_t) 7);
+}
+
+size_t RoboCupSSLShmRing::getSegmentSize(uint32_t slot_count, uint32_t slot_size) {
+  return sizeof(Header) + (size_t) slot_count * getSlotStride(slot_size);
+}
+
+static inline RoboCupSSLShmRing::Slot * getSlot(char * slots, uint32_t slot_count, uint32_t slot_size, uint64_t seq) {
+  return (RoboCupSSLShmRing::Slot *) (slots + (seq % slot_count) * RoboCupSSLShmRing::getSlotStride(slot_size));
+}
+
+//========================================================================
+
+RoboCupSSLShmServer::RoboCupSSLShmServer(string name, uint32_t _slot_count, uint32_t _slot_size)
+{
+  _name=name;
+  fd=-1;
+  segment=nullptr;
+  segment_size=0;
+  header=nullptr;
+  slots=nullptr;
+  slot_count=_slot_count;
+  slot_size=_slot_size;
+}
+
+RoboCupSSLShmServer::~RoboCupSSLShmServer()
+{
+  close();
+}
+
+void RoboCupSSLShmServer::close() {
+  if (header != nullptr) {
+    //attached clients move on to the segment of the next server
+    header->closed.store(1, std::memory_order_release);
+    header->futex_word.fetch_add(1, std::memory_order_release);
+#ifdef __linux__
+    syscall(SYS_futex, &header->futex_word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+  }
+  if (segment != nullptr) munmap(segment, segment_size);
+  if (fd >= 0) {
+    ::close(fd);
+    shm_unlink(_name.c_str());
+  }
+  fd=-1;
+  segment=nullptr;
+  header=nullptr;
+  slots=nullptr;
+}
+
+bool RoboCupSSLShmServer::open() {
+  close();
+  //a segment left behind by a server that did not shut down is replaced by a fresh one
+  markStaleSegmentClosed();
+  shm_unlink(_name.c_str());
+  //only processes of the same user may attach
+  fd = shm_open(_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    perror("shm_open");
+    fprintf(stderr,"Unable to open shared memory output '%s'\n",_name.c_str());
+    return false;
+  }
+  segment_size = RoboCupSSLShmRing::getSegmentSize(slot_count, slot_size);
+  if (ftruncate(fd, segment_size) != 0) {
+    perror("ftruncate");
+    close();
+    return false;
+  }
+  segment = mmap(nullptr, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (segment == MAP_FAILED) {
+    perror("mmap");
+    segment=nullptr;
+    close();
+    return false;
+  }
+  header = (RoboCupSSLShmRing::Header *) segment;
+  slots = (char *) segment + sizeof(RoboCupSSLShmRing::Header);
+
+  //ftruncate zeroed the segment, so every slot starts out free
+  header->version = RoboCupSSLShmRing::Version;
+  header->slot_count = slot_count;
+  header->slot_size = slot_size;
+  header->write_seq.store(0);
+  header->futex_word.store(0);
+  header->waiters.store(0);
+  header->closed.store(0);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(header->magic, ShmMagic, sizeof(ShmMagic));
+  return true;
+}
+
+void RoboCupSSLShmServer::markStaleSegmentClosed() {
+  int stale_fd = shm_open(_name.c_str(), O_RDWR, 0);
+  if (stale_fd < 0) return;
+  struct stat st;
+  if (fstat(stale_fd, &st) == 0 && (size_t) st.st_size >= sizeof(RoboCupSSLShmRing::Header)) {
+    void * stale = mmap(nullptr, sizeof(RoboCupSSLShmRing::Header), PROT_READ | PROT_WRITE, MAP_SHARED, stale_fd, 0);
+    if (stale != MAP_FAILED) {
+      RoboCupSSLShmRing::Header * stale_header = (RoboCupSSLShmRing::Header *) stale;
+      if (memcmp(stale_header->magic, ShmMagic, sizeof(ShmMagic)) == 0 &&
+          stale_header->version == RoboCupSSLShmRing::Version) {
+        stale_header->closed.store(1, std::memory_order_release);
+        stale_header->futex_word.fetch_add(1, std::memory_order_release);
+#ifdef __linux__
+        syscall(SYS_futex, &stale_header->futex_word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+      }
+      munmap(stale, sizeof(RoboCupSSLShmRing::Header));
+    }
+  }
+  ::close(stale_fd);
+}
+
+bool RoboCupSSLShmServer::send(const char * data, int length) {
+  if (header == nullptr) return false;
+  if (length < 0 || (uint32_t) length > slot_size) {
+    fprintf(stderr,"Shared memory output: packet of %d bytes exceeds the slot size of %u bytes\n",length,slot_size);
+    return false;
+  }
+  uint64_t seq = header->write_seq.fetch_add(1);
+  RoboCupSSLShmRing::Slot * slot = getSlot(slots, slot_count, slot_size, seq);
+
+  //claim the slot by marking it busy. With several writers, the previous lap of
+  //this slot may still be in progress, or a later lap may already have claimed it
+  uint64_t current = slot->seq.load(std::memory_order_acquire);
+  for (int i = 0; ; ) {
+    if ((current & ~RoboCupSSLShmRing::SlotBusy) > seq + 1) {
+      //overtaken by a newer packet, readers count this one as overwritten
+      return false;
+    }
+    if ((current & RoboCupSSLShmRing::SlotBusy) == 0) {
+      if (slot->seq.compare_exchange_weak(current, (seq + 1) | RoboCupSSLShmRing::SlotBusy,
+                                          std::memory_order_acquire, std::memory_order_acquire)) break;
+      continue;
+    }
+    if (++i >= kMaxLapWait) {
+      //never write over a stalled writer. Mark the packet as dropped instead, so that
+      //readers move past it without waiting to be lapped
+      fprintf(stderr,"Shared memory output: slot of packet %lu is still being written, dropping the packet\n",
+              (unsigned long) seq);
+      uint64_t skipped = slot->skipped.load(std::memory_order_relaxed);
+      while (skipped < seq + 1 && !slot->skipped.compare_exchange_weak(skipped, seq + 1, std::memory_order_release)) {}
+      wakeReaders();
+      return false;
+    }
+    std::this_thread::yield();
+    current = slot->seq.load(std::memory_order_acquire);
+  }
+
+  std::atomic_thread_fence(std::memory_order_release);
+  slot->length = length;
+  memcpy((char *) slot + sizeof(RoboCupSSLShmRing::Slot), data, length);
+  slot->seq.store(seq + 1, std::memory_order_release);
+
+  wakeReaders();
+  return true;
+}
+
+void RoboCupSSLShmServer::wakeReaders() {
+  header->futex_word.fetch_add(1, std::memory_order_release);
+#ifdef __linux__
+  if (header->waiters.load() > 0) {
+    syscall(SYS_futex, &header->futex_word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+  }
+#endif
+}
+
+//========================================================================
+
+RoboCupSSLShmClient::RoboCupSSLShmClient(string name)
+{
+  _name=name;
+  fd=-1;
+  segment=nullptr;
+  segment_size=0;
+  header=nullptr;
+  slots=nullptr;
+  slot_count=0;
+  slot_size=0;
+  next_seq=0;
+  lost=0;
+  _blocking=false;
+  _open=false;
+}
+
+RoboCupSSLShmClient::~RoboCupSSLShmClient()
+{
+  close();
+}
+
+void RoboCupSSLShmClient::close() {
+  detach();
+  _open=false;
+}
+
+void RoboCupSSLShmClient::detach() {
+  if (segment != nullptr) munmap(segment, segment_size);
+  if (fd >= 0) ::close(fd);
+  fd=-1;
+  segment=nullptr;
+  header=nullptr;
+  slots=nullptr;
+}
+
+bool RoboCupSSLShmClient::open(bool blocking) {
+  _blocking=blocking;
+  lost=0;
+  _open=attach(true);
+  return _open;
+}
+
+bool RoboCupSSLShmClient::attach(bool verbose) {
+  detach();
+  fd = shm_open(_name.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    if (verbose) fprintf(stderr,"Unable to open shared memory '%s'. Is the shared memory output of ssl-vision enabled?\n",_name.c_str());
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(RoboCupSSLShmRing::Header)) {
+    if (verbose) fprintf(stderr,"Shared memory '%s' is not initialized\n",_name.c_str());
+    detach();
+    return false;
+  }
+  segment_size = st.st_size;
+  segment = mmap(nullptr, segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (segment == MAP_FAILED) {
+    if (verbose) perror("mmap");
+    segment=nullptr;
+    detach();
+    return false;
+  }
+  header = (RoboCupSSLShmRing::Header *) segment;
+  slots = (char *) segment + sizeof(RoboCupSSLShmRing::Header);
+  if (memcmp(header->magic, ShmMagic, sizeof(ShmMagic)) != 0 || header->version != RoboCupSSLShmRing::Version ||
+      RoboCupSSLShmRing::getSegmentSize(header->slot_count, header->slot_size) != segment_size) {
+    if (verbose) fprintf(stderr,"Shared memory '%s' has an unknown format\n",_name.c_str());
+    detach();
+    return false;
+  }
+  slot_count = header->slot_count;
+  slot_size = header->slot_size;
+  next_seq = header->write_seq.load();
+  return true;
+}
+
+bool RoboCupSSLShmClient::readNext(string & data) {
+  while (true) {
+    uint64_t write_seq = header->write_seq.load(std::memory_order_acquire);
+    if (write_seq < next_seq) {
+      //the server was restarted with a fresh segment
+      next_seq = write_seq;
+    }
+    if (next_seq >= write_seq) return false;
+    if (write_seq - next_seq > slot_count) {
+      lost += write_seq - next_seq - slot_count;
+      next_seq = write_seq - slot_count;
+    }
+
+    RoboCupSSLShmRing::Slot * slot = getSlot(slots, slot_count, slot_size, next_seq);
+    uint64_t seq = slot->seq.load(std::memory_order_acquire);
+    if (seq != next_seq + 1) {
+      uint64_t lap = seq & ~RoboCupSSLShmRing::SlotBusy;
+      uint64_t skipped = slot->skipped.load(std::memory_order_acquire);
+      //an older lap: handed out but not written yet, unless its writer gave up
+      if (lap < next_seq + 1 && skipped < next_seq + 1) return false;
+      //busy with this packet, unless a writer of a later lap gave up waiting for it
+      if (lap == next_seq + 1 && skipped <= next_seq + 1) return false;
+      //a newer lap, a dropped packet or a stalled writer: this packet is lost
+      lost++;
+      next_seq++;
+      continue;
+    }
+
+    uint32_t length = slot->length;
+    if (length > slot_size) length = slot_size;
+    data.assign((const char *) slot + sizeof(RoboCupSSLShmRing::Slot), length);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot->seq.load(std::memory_order_relaxed) != next_seq + 1) {
+      //overwritten while copying
+      lost++;
+      next_seq++;
+      continue;
+    }
+    next_seq++;
+    return true;
+  }
+}
+
+bool RoboCupSSLShmClient::wait(uint32_t futex_value, int timeout_ms) {
+#ifdef __linux__
+  struct timespec timeout;
+  timeout.tv_sec = timeout_ms / 1000;
+  timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+  header->waiters.fetch_add(1);
+  long result = syscall(SYS_futex, &header->futex_word, FUTEX_WAIT, futex_value,
+                        timeout_ms < 0 ? nullptr : &timeout, nullptr, 0);
+  header->waiters.fetch_sub(1);
+  return result == 0 || header->futex_word.load() != futex_value;
+#else
+  //no futex available, poll instead
+  (void)futex_value;
+  (void)timeout_ms;
+  usleep(1000);
+  return true;
+#endif
+}
+
+bool RoboCupSSLShmClient::receive(SSL_WrapperPacket & packet, int timeout_ms) {
+  while (true) {
+    if (header == nullptr || header->closed.load(std::memory_order_acquire) != 0) {
+      //the server shut down, continue with the segment of the next one
+      if (!_open) return false;
+      if (!attach(false)) {
+        if (_blocking) usleep(timeout_ms >= 0 && timeout_ms < 100 ? timeout_ms * 1000 : 100000);
+        return false;
+      }
+    }
+    uint32_t futex_value = header->futex_word.load(std::memory_order_acquire);
+    if (readNext(buffer)) {
+      return packet.ParseFromArray(buffer.data(), buffer.size());
+    }
+    if (!_blocking) return false;
+    if (!wait(futex_value, timeout_ms) && timeout_ms >= 0) return false;
+  }
+}
@@ -0,0 +1,156 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    robocup_ssl_shm.h
+  \brief   C++ Interface: RoboCupSSLShmServer, RoboCupSSLShmClient
+*/
+//========================================================================
+#ifndef ROBOCUP_SSL_SHM_H
+#define ROBOCUP_SSL_SHM_H
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include "messages_robocup_ssl_wrapper.pb.h"
+using namespace std;
+
+/*!
+  \class RoboCupSSLShmRing
+  \brief Layout of the shared-memory ring of serialized SSL_WrapperPackets
+
+  The segment starts with a header, followed by slot_count slots of
+  slot_size payload bytes each. Every packet gets a sequence number s when
+  it is written. It goes to slot s % slot_count, whose sequence field holds
+  s+1 with the SlotBusy bit set while the payload is being written and s+1
+  once it is complete. A writer only claims a slot that holds an older,
+  complete packet, so a stalled writer is never overwritten. A writer that
+  gives up waiting for its slot stores s+1 in the slot's skipped field
+  instead, so readers move past its packet, and the stalled one, at once.
+
+  A reader that is slot_count packets behind the writer has been lapped and
+  skips ahead. Readers sleep on the futex word, which the writer increments
+  after every packet. The server marks the segment as closed and unlinks it
+  on shutdown; clients then attach to the segment of the next server.
+**/
+class RoboCupSSLShmRing {
+public:
+  static const char * DefaultName;
+  static const uint32_t Version = 3;
+  static const uint32_t DefaultSlotCount = 256;
+  static const uint32_t DefaultSlotSize = 16384;
+  static const uint64_t SlotBusy = 1ULL << 63;
+
+  class Header {
+  public:
+    char magic[8];
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t slot_size;
+    std::atomic<uint64_t> write_seq; //next sequence number to hand out
+    std::atomic<uint32_t> futex_word;
+    std::atomic<uint32_t> waiters;
+    std::atomic<uint32_t> closed;
+  };
+
+  class Slot {
+  public:
+    std::atomic<uint64_t> seq;
+    std::atomic<uint64_t> skipped; //highest seq+1 of a packet dropped for this slot
+    uint32_t length;
+    uint32_t reserved;
+    //followed by slot_size bytes of payload
+  };
+
+  static size_t getSlotStride(uint32_t slot_size);
+  static size_t getSegmentSize(uint32_t slot_count, uint32_t slot_size);
+};
+
+/*!
+  \class RoboCupSSLShmServer
+  \brief Writes serialized packets into the shared-memory ring
+
+  send() may be called from several threads at once.
+**/
+class RoboCupSSLShmServer {
+protected:
+  string _name;
+  int fd;
+  void * segment;
+  size_t segment_size;
+  RoboCupSSLShmRing::Header * header;
+  char * slots;
+  uint32_t slot_count;
+  uint32_t slot_size;
+public:
+  explicit RoboCupSSLShmServer(string name=RoboCupSSLShmRing::DefaultName,
+                               uint32_t slot_count=RoboCupSSLShmRing::DefaultSlotCount,
+                               uint32_t slot_size=RoboCupSSLShmRing::DefaultSlotSize);
+  ~RoboCupSSLShmServer();
+  bool open();
+  void close();
+  bool isOpen() const {
+    return header != nullptr;
+  }
+  const string & getName() const {
+    return _name;
+  }
+  bool send(const char * data, int length);
+protected:
+  void markStaleSegmentClosed();
+  void wakeReaders();
+};
+
+/*!
+  \class RoboCupSSLShmClient
+  \brief Reads SSL_WrapperPackets from the shared-memory ring of a local ssl-vision
+
+  A client starts with the next packet written after open(). Packets that
+  were overwritten before they could be read are counted by getLost().
+  When the server shuts down, receive() reopens the segment once a new
+  server has created it.
+**/
+class RoboCupSSLShmClient {
+protected:
+  string _name;
+  int fd;
+  void * segment;
+  size_t segment_size;
+  RoboCupSSLShmRing::Header * header;
+  char * slots;
+  uint32_t slot_count;
+  uint32_t slot_size;
+  uint64_t next_seq;
+  uint64_t lost;
+  bool _blocking;
+  bool _open;
+  string buffer;
+public:
+  explicit RoboCupSSLShmClient(string name=RoboCupSSLShmRing::DefaultName);
+  ~RoboCupSSLShmClient();
+  bool open(bool blocking=false);
+  void close();
+  /// reads the next packet. blocks for up to timeout_ms if opened as blocking (-1: forever)
+  bool receive(SSL_WrapperPacket & packet, int timeout_ms=-1);
+  uint64_t getLost() const {
+    return lost;
+  }
+protected:
+  bool attach(bool verbose);
+  void detach();
+  bool readNext(string & data);
+  bool wait(uint32_t futex_value, int timeout_ms);
+};
+
+#endif
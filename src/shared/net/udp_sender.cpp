@@ -0,0 +1,293 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    udp_sender.cpp
+  \brief   C++ Implementation: UDPSender
+*/
+//========================================================================
+
+#include "udp_sender.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <errno.h>
+
+#include <algorithm>
+#include <cstring>
+
+// the sender thread wakes up at least this often, even without a notification
+static const std::chrono::milliseconds kIdleTimeout(10);
+
+UDPSender::UDPSender(int queue_size) :
+    enqueue_pos(0),
+    sent_pos(0),
+    dequeue_pos(0),
+    waiting(false),
+    running(true),
+    dropped(0),
+    stats_count(0),
+    stats_latency_sum(0.0),
+    stats_latency_max(0.0),
+    stats_depth_max(0),
+    stats_batch_max(0) {
+  settings = new VarList("Sender Thread");
+  settings->addChild(v_enable = new VarBool("enable", true));
+  settings->addChild(v_priority = new VarInt("socket priority (-1: default)", -1, -1, 7));
+  settings->addChild(v_dscp = new VarInt("DSCP (-1: default)", -1, -1, 63));
+  settings->addChild(v_busy_poll = new VarInt("busy poll (us, 0: off)", 0, 0, 1000));
+  settings->addChild(statistics = new VarList("Statistics"));
+  statistics->addChild(v_queue_depth = new VarInt("max queue depth", 0));
+  statistics->addChild(v_latency_avg = new VarDouble("avg send latency (us)", 0.0));
+  statistics->addChild(v_latency_max = new VarDouble("max send latency (us)", 0.0));
+  statistics->addChild(v_batch_max = new VarInt("max batch size", 0));
+  statistics->addChild(v_dropped = new VarInt("dropped datagrams", 0));
+  statistics->addFlags(VARTYPE_FLAG_NOSTORE);
+  for (VarType* item : statistics->getChildren()) {
+    item->addFlags(VARTYPE_FLAG_READONLY | VARTYPE_FLAG_NOSTORE);
+  }
+
+  // the queue indices wrap with a mask, so round up to a power of two
+  size_t size = 2;
+  while (size < (size_t) queue_size) size <<= 1;
+  slots = std::vector<Slot>(size);
+  mask = size - 1;
+  for (size_t i = 0; i < size; i++) {
+    slots[i].sequence.store(i, std::memory_order_relaxed);
+    slots[i].fd = -1;
+    slots[i].data.reset(new char[MaxDatagramSize]);
+    slots[i].length = 0;
+  }
+  stats_start = std::chrono::steady_clock::now();
+
+  worker = std::thread(&UDPSender::runWorker, this);
+}
+
+UDPSender::~UDPSender() {
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex);
+    running = false;
+  }
+  wake_condition.notify_all();
+  worker.join();
+
+  delete v_enable;
+  delete v_priority;
+  delete v_dscp;
+  delete v_busy_poll;
+  delete v_queue_depth;
+  delete v_latency_avg;
+  delete v_latency_max;
+  delete v_batch_max;
+  delete v_dropped;
+  delete statistics;
+  delete settings;
+}
+
+bool UDPSender::isEnabled() const {
+  return v_enable->getBool();
+}
+
+void UDPSender::configureSocket(int fd) const {
+  if (fd < 0) return;
+#ifdef SO_PRIORITY
+  int priority = v_priority->getInt();
+  if (priority >= 0 && setsockopt(fd, SOL_SOCKET, SO_PRIORITY, &priority, sizeof(priority)) != 0) {
+    perror("ERROR WHEN SETTING SO_PRIORITY ON UDP SOCKET");
+  }
+#endif
+  int dscp = v_dscp->getInt();
+  if (dscp >= 0) {
+    // DSCP is the upper six bits of the TOS byte
+    int tos = dscp << 2;
+    if (setsockopt(fd, IPPROTO_IP, IP_TOS, &tos, sizeof(tos)) != 0) {
+      perror("ERROR WHEN SETTING IP_TOS ON UDP SOCKET");
+    }
+  }
+#ifdef SO_BUSY_POLL
+  int busy_poll = v_busy_poll->getInt();
+  if (busy_poll > 0 && setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &busy_poll, sizeof(busy_poll)) != 0) {
+    perror("ERROR WHEN SETTING SO_BUSY_POLL ON UDP SOCKET");
+  }
+#endif
+}
+
+bool UDPSender::enqueue(int fd, const Net::Address& dest, const char* data, int length) {
+  if (length < 0 || length > MaxDatagramSize) {
+    fprintf(stderr, "Sending UDP datagram failed (too large). Size was: %d byte(s)\n", length);
+    dropped++;
+    return false;
+  }
+
+  // bounded MPMC queue after D. Vyukov: a slot is free for position pos if
+  // its sequence equals pos, and holds a datagram if it equals pos+1
+  Slot* slot;
+  size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+  while (true) {
+    slot = &slots[pos & mask];
+    size_t sequence = slot->sequence.load(std::memory_order_acquire);
+    intptr_t diff = (intptr_t) sequence - (intptr_t) pos;
+    if (diff == 0) {
+      if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+    } else if (diff < 0) {
+      dropped++;
+      return false;
+    } else {
+      pos = enqueue_pos.load(std::memory_order_relaxed);
+    }
+  }
+
+  slot->fd = fd;
+  slot->dest.copy(dest);
+  memcpy(slot->data.get(), data, length);
+  slot->length = length;
+  slot->t_enqueue = std::chrono::steady_clock::now();
+  slot->sequence.store(pos + 1, std::memory_order_release);
+
+  // Pairs with the fence in runWorker(): either the sender thread sees this
+  // datagram when it re-checks the queue, or we see it waiting and wake it.
+  // Without the fence the load could be ordered before the store above.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiting.load()) {
+    std::lock_guard<std::mutex> lock(wake_mutex);
+    wake_condition.notify_one();
+  }
+  return true;
+}
+
+void UDPSender::flush() {
+  size_t target = enqueue_pos.load();
+  std::unique_lock<std::mutex> lock(wake_mutex);
+  wake_condition.notify_one();
+  flush_condition.wait(lock, [this, target] { return sent_pos.load() >= target || !running; });
+}
+
+void UDPSender::sendBatch(size_t first, int n) {
+#ifdef __linux__
+  mmsghdr messages[MaxBatch];
+  iovec vectors[MaxBatch];
+  for (int i = 0; i < n; i++) {
+    Slot& slot = slots[(first + i) & mask];
+    vectors[i].iov_base = (void*) slot.data.get();
+    vectors[i].iov_len = slot.length;
+    messages[i].msg_hdr.msg_name = (void*) slot.dest.getSockAddr();
+    messages[i].msg_hdr.msg_namelen = slot.dest.getSockAddrLen();
+    messages[i].msg_hdr.msg_iov = &vectors[i];
+    messages[i].msg_hdr.msg_iovlen = 1;
+    messages[i].msg_hdr.msg_control = nullptr;
+    messages[i].msg_hdr.msg_controllen = 0;
+    messages[i].msg_hdr.msg_flags = 0;
+  }
+  int fd = slots[first & mask].fd;
+  int done = 0;
+  while (done < n) {
+    int result = sendmmsg(fd, messages + done, n - done, 0);
+    if (result < 0) {
+      if (errno == EINTR) continue;
+      // same as a failed sendto: report and drop the datagram that failed
+      Slot& slot = slots[(first + done) & mask];
+      perror("Sendto Error");
+      fprintf(stderr, "Sending UDP datagram failed (maybe too large?). Size was: %d byte(s)\n",
+              slot.length);
+      done++;
+    } else {
+      done += result;
+    }
+  }
+#else
+  for (int i = 0; i < n; i++) {
+    Slot& slot = slots[(first + i) & mask];
+    if (sendto(slot.fd, slot.data.get(), slot.length, 0,
+               slot.dest.getSockAddr(), slot.dest.getSockAddrLen()) != (ssize_t) slot.length) {
+      perror("Sendto Error");
+      fprintf(stderr, "Sending UDP datagram failed (maybe too large?). Size was: %d byte(s)\n",
+              slot.length);
+    }
+  }
+#endif
+}
+
+void UDPSender::updateStatistics() {
+  auto now = std::chrono::steady_clock::now();
+  if (now - stats_start < std::chrono::seconds(1)) return;
+  v_queue_depth->setInt(stats_depth_max);
+  v_latency_avg->setDouble(stats_count > 0 ? stats_latency_sum / stats_count : 0.0);
+  v_latency_max->setDouble(stats_latency_max);
+  v_batch_max->setInt(stats_batch_max);
+  v_dropped->setInt((int) dropped.load());
+  stats_count = 0;
+  stats_latency_sum = 0.0;
+  stats_latency_max = 0.0;
+  stats_depth_max = 0;
+  stats_batch_max = 0;
+  stats_start = now;
+}
+
+void UDPSender::runWorker() {
+  while (true) {
+    // collect the datagrams that are ready, in queue order
+    int n = 0;
+    while (n < (int) mask + 1) {
+      size_t sequence = slots[(dequeue_pos + n) & mask].sequence.load(std::memory_order_acquire);
+      if (sequence != dequeue_pos + n + 1) break;
+      n++;
+    }
+
+    if (n == 0) {
+      std::unique_lock<std::mutex> lock(wake_mutex);
+      flush_condition.notify_all();
+      if (!running) return;
+      waiting = true;
+      // pairs with the fence in enqueue()
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (slots[dequeue_pos & mask].sequence.load() != dequeue_pos + 1) {
+        wake_condition.wait_for(lock, kIdleTimeout);
+      }
+      waiting = false;
+      lock.unlock();
+      updateStatistics();
+      continue;
+    }
+
+    stats_depth_max = std::max(stats_depth_max, n);
+    int done = 0;
+    while (done < n) {
+      // a batch covers consecutive datagrams for the same socket
+      size_t first = dequeue_pos + done;
+      int count = 1;
+      int fd = slots[first & mask].fd;
+      while (count < MaxBatch && done + count < n && slots[(first + count) & mask].fd == fd) {
+        count++;
+      }
+      sendBatch(first, count);
+
+      auto now = std::chrono::steady_clock::now();
+      for (int i = 0; i < count; i++) {
+        Slot& slot = slots[(first + i) & mask];
+        double latency = std::chrono::duration<double, std::micro>(now - slot.t_enqueue).count();
+        stats_latency_sum += latency;
+        stats_latency_max = std::max(stats_latency_max, latency);
+        // hand the slot back to the producers for the next lap
+        slot.sequence.store(first + i + mask + 1, std::memory_order_release);
+      }
+      stats_count += count;
+      stats_batch_max = std::max(stats_batch_max, count);
+      done += count;
+    }
+    dequeue_pos += n;
+    sent_pos.store(dequeue_pos);
+    updateStatistics();
+  }
+}
@@ -0,0 +1,130 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    udp_sender.h
+  \brief   C++ Interface: UDPSender
+*/
+//========================================================================
+#ifndef UDP_SENDER_H
+#define UDP_SENDER_H
+
+#include <VarTypes.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "netraw.h"
+
+using namespace VarTypes;
+
+/*!
+  \class UDPSender
+  \brief A single thread that hands queued datagrams to the kernel
+
+  Any number of threads may enqueue datagrams. The payload is copied into a
+  preallocated slot of a bounded lock-free queue, so enqueue() never blocks,
+  never allocates and never waits for the network stack. If the queue is
+  full, the datagram is dropped and counted.
+
+  The sender thread passes runs of queued datagrams for the same socket to
+  the kernel with a single sendmmsg call where available.
+
+  The settings hold the socket options that the servers apply when their
+  socket is opened, and read-only send statistics which are refreshed
+  about once per second.
+**/
+class UDPSender {
+ public:
+  explicit UDPSender(int queue_size = 1024);
+  ~UDPSender();
+
+  VarList* getSettings() { return settings; }
+
+  /// whether servers should send through this thread (read when a server opens its socket)
+  bool isEnabled() const;
+
+  /// applies the configured priority, DSCP and busy poll options to a socket
+  void configureSocket(int fd) const;
+
+  /// copies the datagram into the queue, returns false if it was dropped
+  bool enqueue(int fd, const Net::Address& dest, const char* data, int length);
+
+  /// blocks until every datagram enqueued so far has been sent
+  void flush();
+
+ protected:
+  static const int MaxBatch = 32;
+  // largest UDP payload over IPv4
+  static const int MaxDatagramSize = 65507;
+
+  class Slot {
+   public:
+    std::atomic<size_t> sequence;
+    int fd;
+    Net::Address dest;
+    // MaxDatagramSize bytes, only the pages that are written become resident
+    std::unique_ptr<char[]> data;
+    int length;
+    std::chrono::steady_clock::time_point t_enqueue;
+  };
+
+  VarList* settings;
+  VarBool* v_enable;
+  VarInt* v_priority;
+  VarInt* v_dscp;
+  VarInt* v_busy_poll;
+  VarList* statistics;
+  VarInt* v_queue_depth;
+  VarDouble* v_latency_avg;
+  VarDouble* v_latency_max;
+  VarInt* v_batch_max;
+  VarInt* v_dropped;
+
+  // bounded multi-producer queue, see enqueue()
+  std::vector<Slot> slots;
+  size_t mask;
+  std::atomic<size_t> enqueue_pos;
+  std::atomic<size_t> sent_pos;
+  size_t dequeue_pos;  // sender thread only
+
+  std::mutex wake_mutex;
+  std::condition_variable wake_condition;
+  std::condition_variable flush_condition;
+  std::atomic<bool> waiting;
+  std::atomic<bool> running;
+
+  // statistics, written by the sender thread only except for dropped
+  std::atomic<unsigned long> dropped;
+  unsigned long stats_count;
+  double stats_latency_sum;
+  double stats_latency_max;
+  int stats_depth_max;
+  int stats_batch_max;
+  std::chrono::steady_clock::time_point stats_start;
+
+  std::thread worker;
+
+  void runWorker();
+  void sendBatch(size_t first, int n);
+  void updateStatistics();
+};
+
+#endif
@@ -36,9 +36,26 @@ CameraParameters::CameraParameters(int camera_index_, RoboCupField * field_) :
   intrinsic_parameters = new CameraIntrinsicParameters();
   extrinsic_parameters = new CameraExtrinsicParameters();
   use_opencv_model = new VarBool("use openCV camera model", false);
+
+  projection_lut = new CameraProjectionLUT(*this);
+  projection_lut->addCalibrationSettings(intrinsic_parameters->settings);
+  projection_lut->addCalibrationSettings(extrinsic_parameters->settings);
+  projection_lut->addCalibrationSettings(use_opencv_model);
+  projection_lut->addCalibrationSettings(focal_length);
+  projection_lut->addCalibrationSettings(principal_point_x);
+  projection_lut->addCalibrationSettings(principal_point_y);
+  projection_lut->addCalibrationSettings(distortion);
+  projection_lut->addCalibrationSettings(q0);
+  projection_lut->addCalibrationSettings(q1);
+  projection_lut->addCalibrationSettings(q2);
+  projection_lut->addCalibrationSettings(q3);
+  projection_lut->addCalibrationSettings(tx);
+  projection_lut->addCalibrationSettings(ty);
+  projection_lut->addCalibrationSettings(tz);
 }
 
 CameraParameters::~CameraParameters() {
+  delete projection_lut;
   delete focal_length;
   delete principal_point_x;
   delete principal_point_y;
@@ -163,6 +180,7 @@ void CameraParameters::addSettingsToList(VarList& list) const {
   list.addChild(tx);
   list.addChild(ty);
   list.addChild(tz);
+  list.addChild(projection_lut->getSettings());
 }
 
 double CameraParameters::radialDistortion(double ru) const {
@@ -359,6 +377,74 @@ void CameraParameters::image2field(
 }
 
 
+void CameraParameters::image2field(
+    double *p_f_x, double *p_f_y, const double *p_i_x, const double *p_i_y,
+    int n, double z) const {
+  if (n <= 0) return;
+  Eigen::Map<const Eigen::ArrayXd> image_x(p_i_x, n);
+  Eigen::Map<const Eigen::ArrayXd> image_y(p_i_y, n);
+  Eigen::Map<Eigen::ArrayXd> field_x(p_f_x, n);
+  Eigen::Map<Eigen::ArrayXd> field_y(p_f_y, n);
+
+  // Both camera models boil down to an affine map of the (undistorted) image
+  // point to a ray direction in world coordinates plus a fixed ray origin.
+  // The per-frame constants are set up once, the per-point math is done on
+  // whole arrays.
+  Eigen::Matrix3d m;
+  Eigen::Vector3d origin;
+  Eigen::ArrayXd ray_x, ray_y;
+
+  if(use_opencv_model->getBool()) {
+    const cv::Mat &rotation_mat_inv = extrinsic_parameters->rotation_mat_inv;
+    const cv::Mat &camera_mat_inv = intrinsic_parameters->camera_mat_inv;
+    const cv::Mat &right_side_mat = extrinsic_parameters->right_side_mat;
+    const cv::Mat ray_mat = rotation_mat_inv * camera_mat_inv;
+    for (int r = 0; r < 3; r++) {
+      for (int c = 0; c < 3; c++) {
+        m(r, c) = ray_mat.at<double>(r, c);
+      }
+      origin(r) = -right_side_mat.at<double>(r, 0);
+    }
+    ray_x = image_x;
+    ray_y = image_y;
+  } else {
+    const double f_inv = 1.0 / focal_length->getDouble();
+    Eigen::ArrayXd d_x = (image_x - principal_point_x->getDouble()) * f_inv;
+    Eigen::ArrayXd d_y = (image_y - principal_point_y->getDouble()) * f_inv;
+
+    // Compensate for distortion (undistort), see radialDistortionInv()
+    Eigen::ArrayXd scale = 1.0 + distortion->getDouble() * (d_x.square() + d_y.square());
+    ray_x = d_x * scale;
+    ray_y = d_y * scale;
+
+    Quaternion<double> q_field2cam_inv = Quaternion<double>(
+        q0->getDouble(),q1->getDouble(),q2->getDouble(),q3->getDouble());
+    q_field2cam_inv.norm();
+    q_field2cam_inv.invert();
+    for (int c = 0; c < 3; c++) {
+      GVector::vector3d<double> axis(c == 0, c == 1, c == 2);
+      GVector::vector3d<double> column = q_field2cam_inv.rotateVectorByQuaternion(axis);
+      m(0, c) = column.x;
+      m(1, c) = column.y;
+      m(2, c) = column.z;
+    }
+    GVector::vector3d<double> zero_in_w = q_field2cam_inv.rotateVectorByQuaternion(
+        GVector::vector3d<double>(0,0,0) -
+        GVector::vector3d<double>(tx->getDouble(),ty->getDouble(),tz->getDouble()));
+    origin << zero_in_w.x, zero_in_w.y, zero_in_w.z;
+  }
+
+  // ray direction in world coordinates for the homogeneous point (x, y, 1)
+  Eigen::ArrayXd v_x = m(0, 0) * ray_x + m(0, 1) * ray_y + m(0, 2);
+  Eigen::ArrayXd v_y = m(1, 0) * ray_x + m(1, 1) * ray_y + m(1, 2);
+  Eigen::ArrayXd v_z = m(2, 0) * ray_x + m(2, 1) * ray_y + m(2, 2);
+
+  // intersect with the plane at height z
+  Eigen::ArrayXd t = (z - origin(2)) / v_z;
+  field_x = origin(0) + v_x * t;
+  field_y = origin(1) + v_y * t;
+}
+
 double CameraParameters::calc_chisqr(
     std::vector<GVector::vector3d<double> > &p_f,
     std::vector<GVector::vector2d<double> > &p_i, Eigen::VectorXd &p,
@@ -30,6 +30,7 @@
 #include <opencv2/opencv.hpp>
 
 #include "camera_parameters.h"
+#include "camera_projection_lut.h"
 #include "field.h"
 #include "messages_robocup_ssl_geometry.pb.h"
 #include "timer.h"
@@ -76,10 +77,16 @@ class CameraParameters {
   CameraIntrinsicParameters* intrinsic_parameters;
   CameraExtrinsicParameters* extrinsic_parameters;
 
+  // precomputed image2field tables for the detection hot path
+  CameraProjectionLUT* projection_lut;
+
   void quaternionFromOpenCVCalibration(double Q[]) const;
   GVector::vector3d<double> getWorldLocation() const;
   void field2image(const GVector::vector3d<double>& p_f, GVector::vector2d<double>& p_i) const;
   void image2field(GVector::vector3d<double>& p_f, const GVector::vector2d<double>& p_i, double z) const;
+  /** project n image points onto the plane at height z in one call.
+      Points are passed as separate x and y arrays (structure-of-arrays), which lets Eigen vectorize the math. */
+  void image2field(double* p_f_x, double* p_f_y, const double* p_i_x, const double* p_i_y, int n, double z) const;
   void calibrate(std::vector<GVector::vector3d<double> >& p_f,
                  std::vector<GVector::vector2d<double> >& p_i,
                  int cal_type);
@@ -0,0 +1,290 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    camera_projection_lut.cpp
+  \brief   C++ Implementation: CameraProjectionLUT
+*/
+//========================================================================
+
+#include "camera_projection_lut.h"
+#include "camera_calibration.h"
+#include <algorithm>
+#include <cmath>
+
+// heights closer than this (in mm) share a table
+static const double kHeightTolerance = 1e-3;
+// error check samples per cell and axis, see build()
+static const int kErrorSamples = 4;
+
+CameraProjectionLUT::CameraProjectionLUT(const CameraParameters& _camera_parameters) :
+    camera_parameters(_camera_parameters),
+    enabled(true),
+    width(0),
+    height(0),
+    step(4),
+    generation(0),
+    latest_generation(0),
+    running(true) {
+  settings = new VarList("Projection LUT");
+  settings->addChild(v_enable = new VarBool("enable", true));
+  settings->addChild(v_grid_step = new VarInt("grid step (pixels)", 4, 1, 64));
+  settings->addChild(v_max_error = new VarDouble("max error (mm)", -1.0));
+  v_max_error->addFlags(VARTYPE_FLAG_READONLY | VARTYPE_FLAG_NOSTORE);
+  vnotify.addItem(v_enable);
+  vnotify.addItem(v_grid_step);
+  vnotify.setChanged(true);
+
+  // the field plane is always needed, everything else is registered on first use
+  heights.push_back(0.0);
+
+  worker = std::thread(&CameraProjectionLUT::runWorker, this);
+}
+
+CameraProjectionLUT::~CameraProjectionLUT() {
+  {
+    std::lock_guard<std::mutex> lock(worker_mutex);
+    running = false;
+  }
+  worker_condition.notify_all();
+  worker.join();
+
+  clearTables();
+  for (auto table : finished) {
+    delete table;
+  }
+  delete v_enable;
+  delete v_grid_step;
+  delete v_max_error;
+  delete settings;
+}
+
+void CameraProjectionLUT::addCalibrationSettings(VarType* item) {
+  vnotify.addRecursive(item);
+}
+
+void CameraProjectionLUT::clearTables() {
+  for (auto table : tables) {
+    delete table;
+  }
+  tables.clear();
+}
+
+void CameraProjectionLUT::requestBuild(double z) {
+  BuildRequest request;
+  request.generation = generation;
+  request.width = width;
+  request.height = height;
+  request.step = step;
+  request.z = z;
+  {
+    std::lock_guard<std::mutex> lock(worker_mutex);
+    pending.push_back(request);
+  }
+  worker_condition.notify_one();
+}
+
+void CameraProjectionLUT::update(int image_width, int image_height) {
+  bool rebuild = false;
+  if (vnotify.hasChanged()) {
+    enabled = v_enable->getBool();
+    step = v_grid_step->getInt();
+    rebuild = true;
+  }
+  if (image_width != width || image_height != height) {
+    width = image_width;
+    height = image_height;
+    rebuild = true;
+  }
+
+  if (rebuild) {
+    // stale tables must never be used, so drop them right away and let the
+    // lookups fall back to the exact model until the new ones are ready
+    generation++;
+    latest_generation = generation;
+    clearTables();
+    v_max_error->setDouble(-1.0);
+    if (enabled && width > 0 && height > 0) {
+      for (double z : heights) {
+        requestBuild(z);
+      }
+    }
+  }
+
+  if (!requested_heights.empty()) {
+    for (double z : requested_heights) {
+      heights.push_back(z);
+      if (enabled && width > 0 && height > 0) {
+        requestBuild(z);
+      }
+    }
+    requested_heights.clear();
+  }
+
+  std::vector<Table*> done;
+  {
+    std::lock_guard<std::mutex> lock(worker_mutex);
+    done.swap(finished);
+  }
+  if (!done.empty()) {
+    double max_error = v_max_error->getDouble();
+    for (auto table : done) {
+      if (table->generation == generation && enabled) {
+        tables.push_back(table);
+        max_error = std::max(max_error, table->max_error);
+      } else {
+        delete table;
+      }
+    }
+    v_max_error->setDouble(max_error);
+  }
+}
+
+const CameraProjectionLUT::Table* CameraProjectionLUT::getTable(double z) {
+  if (!enabled) return nullptr;
+  for (auto table : tables) {
+    if (fabs(table->z - z) < kHeightTolerance) return table;
+  }
+  for (double h : heights) {
+    if (fabs(h - z) < kHeightTolerance) return nullptr;
+  }
+  for (double h : requested_heights) {
+    if (fabs(h - z) < kHeightTolerance) return nullptr;
+  }
+  requested_heights.push_back(z);
+  return nullptr;
+}
+
+double CameraProjectionLUT::getMaxError(double z) const {
+  if (!enabled) return -1.0;
+  for (auto table : tables) {
+    if (fabs(table->z - z) < kHeightTolerance) return table->max_error;
+  }
+  return -1.0;
+}
+
+void CameraProjectionLUT::image2field(
+    GVector::vector3d<double>& p_f, const GVector::vector2d<double>& p_i, double z) {
+  const Table* table = getTable(z);
+  if (table != nullptr && table->lookup(p_i.x, p_i.y, p_f.x, p_f.y)) {
+    p_f.z = z;
+    return;
+  }
+  camera_parameters.image2field(p_f, p_i, z);
+}
+
+void CameraProjectionLUT::image2field(
+    double* p_f_x, double* p_f_y, const double* p_i_x, const double* p_i_y, int n, double z) {
+  const Table* table = getTable(z);
+  if (table == nullptr) {
+    camera_parameters.image2field(p_f_x, p_f_y, p_i_x, p_i_y, n, z);
+    return;
+  }
+  miss_index.clear();
+  miss_i_x.clear();
+  miss_i_y.clear();
+  for (int i = 0; i < n; i++) {
+    if (!table->lookup(p_i_x[i], p_i_y[i], p_f_x[i], p_f_y[i])) {
+      miss_index.push_back(i);
+      miss_i_x.push_back(p_i_x[i]);
+      miss_i_y.push_back(p_i_y[i]);
+    }
+  }
+  if (miss_index.empty()) return;
+
+  //a single batched call, so that the exact model is set up once and not per point
+  int misses = (int) miss_index.size();
+  miss_f_x.resize(misses);
+  miss_f_y.resize(misses);
+  camera_parameters.image2field(miss_f_x.data(), miss_f_y.data(), miss_i_x.data(), miss_i_y.data(), misses, z);
+  for (int j = 0; j < misses; j++) {
+    p_f_x[miss_index[j]] = miss_f_x[j];
+    p_f_y[miss_index[j]] = miss_f_y[j];
+  }
+}
+
+CameraProjectionLUT::Table* CameraProjectionLUT::build(const BuildRequest& request) const {
+  auto* table = new Table();
+  table->z = request.z;
+  table->step = request.step;
+  table->inv_step = 1.0 / request.step;
+  table->generation = request.generation;
+  // one extra row and column so that the last image pixel lies inside a cell
+  table->cols = (request.width - 1) / request.step + 2;
+  table->rows = (request.height - 1) / request.step + 2;
+  table->field_x.resize(table->cols * table->rows);
+  table->field_y.resize(table->cols * table->rows);
+
+  GVector::vector3d<double> p_f;
+  for (int r = 0; r < table->rows; r++) {
+    for (int c = 0; c < table->cols; c++) {
+      GVector::vector2d<double> p_i(c * request.step, r * request.step);
+      camera_parameters.image2field(p_f, p_i, request.z);
+      table->field_x[r * table->cols + c] = (float) p_f.x;
+      table->field_y[r * table->cols + c] = (float) p_f.y;
+    }
+    if (latest_generation != request.generation) {
+      delete table;
+      return nullptr;
+    }
+  }
+
+  // Compare against the exact projection on a sub-grid of each cell that
+  // includes its corners (float storage), edges and interior. This is a
+  // sampled estimate, not a strict bound: only with a grid step of up to
+  // kErrorSamples pixels is every integer pixel position checked.
+  double max_error_sq = 0.0;
+  int samples = std::min(request.step, kErrorSamples);
+  double sample_step = (double) request.step / samples;
+  for (int r = 0; r < table->rows - 1; r++) {
+    for (int c = 0; c < table->cols - 1; c++) {
+      for (int sy = 0; sy < samples; sy++) {
+        for (int sx = 0; sx < samples; sx++) {
+          GVector::vector2d<double> p_i(c * request.step + sx * sample_step, r * request.step + sy * sample_step);
+          camera_parameters.image2field(p_f, p_i, request.z);
+          double x = 0;
+          double y = 0;
+          table->lookup(p_i.x, p_i.y, x, y);
+          max_error_sq = std::max(max_error_sq, (x - p_f.x) * (x - p_f.x) + (y - p_f.y) * (y - p_f.y));
+        }
+      }
+    }
+    if (latest_generation != request.generation) {
+      delete table;
+      return nullptr;
+    }
+  }
+  table->max_error = sqrt(max_error_sq);
+  return table;
+}
+
+void CameraProjectionLUT::runWorker() {
+  while (true) {
+    BuildRequest request;
+    {
+      std::unique_lock<std::mutex> lock(worker_mutex);
+      worker_condition.wait(lock, [this] { return !running || !pending.empty(); });
+      if (!running) return;
+      request = pending.front();
+      pending.pop_front();
+    }
+    if (request.generation != latest_generation) continue;
+
+    Table* table = build(request);
+    if (table != nullptr) {
+      std::lock_guard<std::mutex> lock(worker_mutex);
+      finished.push_back(table);
+    }
+  }
+}
@@ -0,0 +1,166 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    camera_projection_lut.h
+  \brief   C++ Interface: CameraProjectionLUT
+*/
+//========================================================================
+
+#ifndef CAMERA_PROJECTION_LUT_H
+#define CAMERA_PROJECTION_LUT_H
+
+#include <VarTypes.h>
+#include <VarNotifier.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gvector.h"
+
+using namespace VarTypes;
+
+class CameraParameters;
+
+/*!
+  \class CameraProjectionLUT
+  \brief Precomputed image-to-field lookup tables for a handful of object heights
+
+  Each table stores the field coordinates of a regular pixel grid (every
+  grid_step pixels) for one fixed height. Lookups bilinearly interpolate
+  between the four surrounding grid points. Tables are (re-)built on a
+  background thread whenever the calibration changes. Until a valid table for
+  a height is available, lookups fall back to the exact
+  CameraParameters::image2field.
+
+  All lookup methods and update() must be called from the same thread, which
+  is the capture thread of the owning camera stack.
+**/
+class CameraProjectionLUT {
+ public:
+  class Table {
+   public:
+    double z;
+    int step;
+    int cols;
+    int rows;
+    double inv_step;
+    // max interpolation error in mm, estimated from samples within each cell
+    double max_error;
+    unsigned long generation;
+    std::vector<float> field_x;
+    std::vector<float> field_y;
+
+    /// interpolate field coordinates, returns false if p_i is outside of the table
+    inline bool lookup(double p_i_x, double p_i_y, double& p_f_x, double& p_f_y) const {
+      double gx = p_i_x * inv_step;
+      double gy = p_i_y * inv_step;
+      if (gx < 0.0 || gy < 0.0) return false;
+      int ix = (int) gx;
+      int iy = (int) gy;
+      if (ix >= cols - 1 || iy >= rows - 1) return false;
+      double ax = gx - ix;
+      double ay = gy - iy;
+      int i = iy * cols + ix;
+      double w00 = (1.0 - ax) * (1.0 - ay);
+      double w01 = ax * (1.0 - ay);
+      double w10 = (1.0 - ax) * ay;
+      double w11 = ax * ay;
+      p_f_x = w00 * field_x[i] + w01 * field_x[i + 1] + w10 * field_x[i + cols] + w11 * field_x[i + cols + 1];
+      p_f_y = w00 * field_y[i] + w01 * field_y[i + 1] + w10 * field_y[i + cols] + w11 * field_y[i + cols + 1];
+      return true;
+    }
+  };
+
+  explicit CameraProjectionLUT(const CameraParameters& camera_parameters);
+  ~CameraProjectionLUT();
+
+  VarList* getSettings() { return settings; }
+
+  /// register calibration values that invalidate the tables when changed
+  void addCalibrationSettings(VarType* item);
+
+  /// Checks for calibration changes, schedules rebuilds and publishes finished tables.
+  /// Call once per frame before any lookups.
+  void update(int image_width, int image_height);
+
+  /// Project an image point onto the plane at height z.
+  /// Uses the table of this height if available, the exact model otherwise.
+  void image2field(GVector::vector3d<double>& p_f, const GVector::vector2d<double>& p_i, double z);
+
+  /// Batch version of image2field for n points in structure-of-arrays layout.
+  void image2field(double* p_f_x, double* p_f_y, const double* p_i_x, const double* p_i_y, int n, double z);
+
+  /// Returns the table for height z, or null (and requests it) if none is available yet.
+  const Table* getTable(double z);
+
+  /// Estimated max error in mm of the table for height z, or -1 if there is no valid table.
+  double getMaxError(double z) const;
+
+  bool isEnabled() const { return enabled; }
+
+ protected:
+  class BuildRequest {
+   public:
+    unsigned long generation;
+    int width;
+    int height;
+    int step;
+    double z;
+  };
+
+  const CameraParameters& camera_parameters;
+
+  VarList* settings;
+  VarBool* v_enable;
+  VarInt* v_grid_step;
+  VarDouble* v_max_error;
+  VarNotifier vnotify;
+
+  // state owned by the calling (capture) thread
+  bool enabled;
+  int width;
+  int height;
+  int step;
+  unsigned long generation;
+  std::vector<double> heights;
+  std::vector<double> requested_heights;
+  std::vector<Table*> tables;
+  // points of a batch outside of the table, projected exactly in one call
+  std::vector<int> miss_index;
+  std::vector<double> miss_i_x;
+  std::vector<double> miss_i_y;
+  std::vector<double> miss_f_x;
+  std::vector<double> miss_f_y;
+
+  // state shared with the worker thread
+  std::mutex worker_mutex;
+  std::condition_variable worker_condition;
+  std::deque<BuildRequest> pending;
+  std::vector<Table*> finished;
+  std::atomic<unsigned long> latest_generation;
+  std::atomic<bool> running;
+  std::thread worker;
+
+  void requestBuild(double z);
+  void clearTables();
+  void runWorker();
+  Table* build(const BuildRequest& request) const;
+};
+
+#endif
@@ -0,0 +1,79 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    compressed_lut.cpp
+  \brief   C++ Implementation: CompressedLUT
+*/
+//========================================================================
+#include "compressed_lut.h"
+
+const uint16_t CompressedLUT::UNIFORM_FLAG;
+const int CompressedLUT::BLOCK_BITS;
+const int CompressedLUT::BLOCK_SIZE;
+
+CompressedLUT::CompressedLUT() : valid(false), coarse_z_bits(0), coarse_zy_bits(0) {
+}
+
+bool CompressedLUT::supportsLayout(unsigned int x_bits, unsigned int y_bits, unsigned int z_bits) {
+  if (x_bits < BLOCK_BITS || y_bits < BLOCK_BITS || z_bits < BLOCK_BITS) return false;
+  // block indices must fit next to the uniform flag
+  return (x_bits + y_bits + z_bits - 3 * BLOCK_BITS) <= 15;
+}
+
+void CompressedLUT::clear() {
+  valid = false;
+  coarse.clear();
+  fine.clear();
+}
+
+bool CompressedLUT::build(unsigned int x_bits, unsigned int y_bits, unsigned int z_bits, const uint8_t * table) {
+  if (!supportsLayout(x_bits, y_bits, z_bits)) {
+    clear();
+    return false;
+  }
+  coarse_z_bits = z_bits - BLOCK_BITS;
+  coarse_zy_bits = y_bits - BLOCK_BITS + coarse_z_bits;
+  unsigned int zy_bits = y_bits + z_bits;
+  int bx_n = 1 << (x_bits - BLOCK_BITS);
+  int by_n = 1 << (y_bits - BLOCK_BITS);
+  int bz_n = 1 << (z_bits - BLOCK_BITS);
+
+  coarse.resize(bx_n * by_n * bz_n);
+  fine.clear();
+  uint8_t block[BLOCK_SIZE];
+  for (int bx = 0; bx < bx_n; bx++) {
+    for (int by = 0; by < by_n; by++) {
+      for (int bz = 0; bz < bz_n; bz++) {
+        bool uniform = true;
+        for (int i = 0; i < BLOCK_SIZE; i++) {
+          unsigned int x = (bx << BLOCK_BITS) | (i >> (2 * BLOCK_BITS));
+          unsigned int y = (by << BLOCK_BITS) | ((i >> BLOCK_BITS) & 3);
+          unsigned int z = (bz << BLOCK_BITS) | (i & 3);
+          block[i] = table[(x << zy_bits) | (y << z_bits) | z];
+          uniform = uniform && block[i] == block[0];
+        }
+        uint16_t & entry = coarse[(bx << coarse_zy_bits) | (by << coarse_z_bits) | bz];
+        if (uniform) {
+          entry = UNIFORM_FLAG | block[0];
+        } else {
+          entry = fine.size() / BLOCK_SIZE;
+          fine.insert(fine.end(), block, block + BLOCK_SIZE);
+        }
+      }
+    }
+  }
+  valid = true;
+  return true;
+}
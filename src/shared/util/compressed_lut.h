@@ -0,0 +1,91 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    compressed_lut.h
+  \brief   C++ Interface: CompressedLUT
+*/
+//========================================================================
+
+#ifndef COMPRESSED_LUT_H
+#define COMPRESSED_LUT_H
+
+#include <stdint.h>
+#include <vector>
+
+/*!
+  \class CompressedLUT
+  \brief A two-level version of a flat 3D LUT table
+
+  The LUT is split into blocks of 4x4x4 cells. The coarse table holds one
+  entry per block which is either the label of a uniform block or the
+  index of a 64 byte (one cache line) fine block. Most of the color space
+  maps to a single label, so the coarse table plus the few fine blocks in
+  use are much smaller than the flat table.
+**/
+class CompressedLUT {
+public:
+  static const uint16_t UNIFORM_FLAG = 0x8000;
+  static const int BLOCK_BITS = 2;
+  static const int BLOCK_SIZE = 1 << (3 * BLOCK_BITS);
+
+  CompressedLUT();
+
+  /// true if a LUT with this bit layout can be compressed
+  static bool supportsLayout(unsigned int x_bits, unsigned int y_bits, unsigned int z_bits);
+
+  /// (re-)build from the flat table of a LUT with the given bit layout
+  bool build(unsigned int x_bits, unsigned int y_bits, unsigned int z_bits, const uint8_t * table);
+
+  void clear();
+
+  bool isValid() const {
+    return valid;
+  }
+
+  /// lookup by cell coordinates (already shifted to the LUT resolution)
+  inline uint8_t get_preshrunk(unsigned int x, unsigned int y, unsigned int z) const {
+    uint16_t block = coarse[((x >> BLOCK_BITS) << coarse_zy_bits) | ((y >> BLOCK_BITS) << coarse_z_bits) | (z >> BLOCK_BITS)];
+    if (block & UNIFORM_FLAG) return (uint8_t)block;
+    return fine[(block << (3 * BLOCK_BITS)) | ((x & 3) << (2 * BLOCK_BITS)) | ((y & 3) << BLOCK_BITS) | (z & 3)];
+  }
+
+  /// true if the cell lies in a uniform block, so that a lookup never touches the fine table
+  inline bool isUniform_preshrunk(unsigned int x, unsigned int y, unsigned int z) const {
+    return (coarse[((x >> BLOCK_BITS) << coarse_zy_bits) | ((y >> BLOCK_BITS) << coarse_z_bits) | (z >> BLOCK_BITS)] & UNIFORM_FLAG) != 0;
+  }
+
+  /// number of blocks that are not uniform
+  int getFineBlockCount() const {
+    return fine.size() / BLOCK_SIZE;
+  }
+
+  int getBlockCount() const {
+    return coarse.size();
+  }
+
+  /// memory used by both tables in bytes
+  int getSizeBytes() const {
+    return coarse.size() * sizeof(uint16_t) + fine.size();
+  }
+
+protected:
+  bool valid;
+  unsigned int coarse_z_bits;
+  unsigned int coarse_zy_bits;
+  std::vector<uint16_t> coarse;
+  std::vector<uint8_t> fine;
+};
+
+#endif
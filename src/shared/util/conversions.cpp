@@ -14,7 +14,7 @@
 //========================================================================
 /*!
   \file    conversions.cpp
-  \brief   Various color conversion operations, but NOT very optimized
+  \brief   Various color conversion operations
   \author
 */
 //========================================================================
@@ -25,20 +25,273 @@
 
 #include "conversions.h"
 
+#ifdef __SSSE3__
+  #include <tmmintrin.h>
+#endif
+
 using namespace std;
 // The following #define is there for the users who experience green/purple
 // images in the display. This seems to be a videocard driver problem.
 
 
+#ifdef __SSSE3__
+namespace {
+
+// Moves bytes between three 16-byte registers, where output byte i is
+// input byte perm(i) of the 48 input bytes. Covers interleaving and
+// deinterleaving of 3-channel pixels.
+class Shuffle48 {
+  public:
+    __m128i masks[3][3];
+
+    template <typename Perm>
+    explicit Shuffle48(Perm perm) {
+      for (int out = 0; out < 3; out++) {
+        for (int in = 0; in < 3; in++) {
+          alignas(16) signed char m[16];
+          for (int i = 0; i < 16; i++) {
+            int from = perm(out * 16 + i);
+            m[i] = (from >= 0 && from / 16 == in) ? (signed char) (from % 16) : (signed char) 0x80;
+          }
+          masks[out][in] = _mm_load_si128((const __m128i *) m);
+        }
+      }
+    }
+
+    inline void apply(const __m128i in[3], __m128i out[3]) const {
+      for (int o = 0; o < 3; o++) {
+        out[o] = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(in[0], masks[o][0]),
+                                           _mm_shuffle_epi8(in[1], masks[o][1])),
+                              _mm_shuffle_epi8(in[2], masks[o][2]));
+      }
+    }
+};
+
+// planar R,G,B registers to packed rgb pixels
+const Shuffle48 & planarToPacked() {
+  static const Shuffle48 shuffle([](int i) { return (i % 3) * 16 + i / 3; });
+  return shuffle;
+}
+
+// packed rgb pixels to planar R,G,B registers
+const Shuffle48 & packedToPlanar() {
+  static const Shuffle48 shuffle([](int i) { return (i % 16) * 3 + i / 16; });
+  return shuffle;
+}
+
+// rgb <-> bgr
+const Shuffle48 & swapRedBlue() {
+  static const Shuffle48 shuffle([](int i) { return (i / 3) * 3 + 2 - i % 3; });
+  return shuffle;
+}
+
+// grey values in the first register to packed rgb pixels
+const Shuffle48 & greyToPacked() {
+  static const Shuffle48 shuffle([](int i) { return i / 3; });
+  return shuffle;
+}
+
+// duplicates the 8 chroma values of 8 macro pixels for their 16 pixels
+inline void duplicateChroma(__m128i c, __m128i & lo, __m128i & hi) {
+  lo = _mm_unpacklo_epi16(c, c);
+  hi = _mm_unpackhi_epi16(c, c);
+}
+
+// Converts 16 pixels of YUV 4:2:2 to 16 bytes each of R, G and B with the
+// same integer math as Conversions::yuv2rgb. (v * 1436) >> 10 equals
+// mulhi(v << 6, 1436) exactly, and the green term is summed in 32 bits.
+template <bool YUYV>
+inline void yuv422ToPlanar(const unsigned char * src, __m128i planes[3]) {
+  const __m128i a = _mm_loadu_si128((const __m128i *) src);
+  const __m128i b = _mm_loadu_si128((const __m128i *) (src + 16));
+  const int y_off = YUYV ? 0 : 1;
+  const int u_off = YUYV ? 1 : 0;
+  const int v_off = YUYV ? 3 : 2;
+  const __m128i y_lo_mask = _mm_setr_epi8(y_off, y_off + 2, y_off + 4, y_off + 6, y_off + 8, y_off + 10, y_off + 12,
+                                          y_off + 14, -128, -128, -128, -128, -128, -128, -128, -128);
+  const __m128i y_hi_mask = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128, y_off, y_off + 2,
+                                          y_off + 4, y_off + 6, y_off + 8, y_off + 10, y_off + 12, y_off + 14);
+  // chroma as 16-bit values: 4 from a, 4 from b
+  const __m128i u_lo_mask = _mm_setr_epi8(u_off, -128, u_off + 4, -128, u_off + 8, -128, u_off + 12, -128,
+                                          -128, -128, -128, -128, -128, -128, -128, -128);
+  const __m128i u_hi_mask = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128,
+                                          u_off, -128, u_off + 4, -128, u_off + 8, -128, u_off + 12, -128);
+  const __m128i v_lo_mask = _mm_setr_epi8(v_off, -128, v_off + 4, -128, v_off + 8, -128, v_off + 12, -128,
+                                          -128, -128, -128, -128, -128, -128, -128, -128);
+  const __m128i v_hi_mask = _mm_setr_epi8(-128, -128, -128, -128, -128, -128, -128, -128,
+                                          v_off, -128, v_off + 4, -128, v_off + 8, -128, v_off + 12, -128);
+
+  const __m128i y8 = _mm_or_si128(_mm_shuffle_epi8(a, y_lo_mask), _mm_shuffle_epi8(b, y_hi_mask));
+  const __m128i offset = _mm_set1_epi16(128);
+  const __m128i u = _mm_sub_epi16(_mm_or_si128(_mm_shuffle_epi8(a, u_lo_mask), _mm_shuffle_epi8(b, u_hi_mask)), offset);
+  const __m128i v = _mm_sub_epi16(_mm_or_si128(_mm_shuffle_epi8(a, v_lo_mask), _mm_shuffle_epi8(b, v_hi_mask)), offset);
+
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i y_lo = _mm_unpacklo_epi8(y8, zero);
+  const __m128i y_hi = _mm_unpackhi_epi8(y8, zero);
+
+  const __m128i r_c = _mm_mulhi_epi16(_mm_slli_epi16(v, 6), _mm_set1_epi16(1436));
+  const __m128i b_c = _mm_mulhi_epi16(_mm_slli_epi16(u, 6), _mm_set1_epi16(1814));
+  const __m128i g_coef = _mm_setr_epi16(352, 731, 352, 731, 352, 731, 352, 731);
+  const __m128i g_c = _mm_packs_epi32(_mm_srai_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(u, v), g_coef), 10),
+                                      _mm_srai_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(u, v), g_coef), 10));
+
+  __m128i lo, hi;
+  duplicateChroma(r_c, lo, hi);
+  planes[0] = _mm_packus_epi16(_mm_add_epi16(y_lo, lo), _mm_add_epi16(y_hi, hi));
+  duplicateChroma(g_c, lo, hi);
+  planes[1] = _mm_packus_epi16(_mm_sub_epi16(y_lo, lo), _mm_sub_epi16(y_hi, hi));
+  duplicateChroma(b_c, lo, hi);
+  planes[2] = _mm_packus_epi16(_mm_add_epi16(y_lo, lo), _mm_add_epi16(y_hi, hi));
+}
+
+// returns the number of pixels converted, the caller converts the rest
+template <bool YUYV, bool BGR>
+int yuv422ToRgbSimd(const unsigned char * src, unsigned char * dest, int num_pixels) {
+  const Shuffle48 & pack = planarToPacked();
+  int i = 0;
+  for (; i + 16 <= num_pixels; i += 16) {
+    __m128i planes[3];
+    yuv422ToPlanar<YUYV>(src + i * 2, planes);
+    if (BGR) std::swap(planes[0], planes[2]);
+    __m128i out[3];
+    pack.apply(planes, out);
+    _mm_storeu_si128((__m128i *) (dest + i * 3), out[0]);
+    _mm_storeu_si128((__m128i *) (dest + i * 3 + 16), out[1]);
+    _mm_storeu_si128((__m128i *) (dest + i * 3 + 32), out[2]);
+  }
+  return i;
+}
+
+// Converts 16 rgb pixels to YUV 4:2:2 with the math of rgb2yuv422Pair().
+template <bool YUYV>
+int rgbToYuv422Simd(const unsigned char * src, unsigned char * dest, int num_pixels) {
+  const Shuffle48 & unpack = packedToPlanar();
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i ones = _mm_set1_epi8(1);
+  const __m128i y_rg = _mm_setr_epi16(306, 601, 306, 601, 306, 601, 306, 601);
+  const __m128i y_b = _mm_setr_epi16(117, 0, 117, 0, 117, 0, 117, 0);
+  const __m128i u_rg = _mm_setr_epi16(-172, -340, -172, -340, -172, -340, -172, -340);
+  const __m128i u_b = _mm_setr_epi16(512, 0, 512, 0, 512, 0, 512, 0);
+  const __m128i v_rg = _mm_setr_epi16(512, -429, 512, -429, 512, -429, 512, -429);
+  const __m128i v_b = _mm_setr_epi16(-83, 0, -83, 0, -83, 0, -83, 0);
+  const __m128i offset = _mm_set1_epi16(128);
+  int i = 0;
+  for (; i + 16 <= num_pixels; i += 16) {
+    __m128i in[3];
+    in[0] = _mm_loadu_si128((const __m128i *) (src + i * 3));
+    in[1] = _mm_loadu_si128((const __m128i *) (src + i * 3 + 16));
+    in[2] = _mm_loadu_si128((const __m128i *) (src + i * 3 + 32));
+    __m128i p[3];
+    unpack.apply(in, p);
+
+    // luma of each pixel, 8 at a time
+    __m128i y16[2];
+    for (int h = 0; h < 2; h++) {
+      __m128i r = h ? _mm_unpackhi_epi8(p[0], zero) : _mm_unpacklo_epi8(p[0], zero);
+      __m128i g = h ? _mm_unpackhi_epi8(p[1], zero) : _mm_unpacklo_epi8(p[1], zero);
+      __m128i b = h ? _mm_unpackhi_epi8(p[2], zero) : _mm_unpacklo_epi8(p[2], zero);
+      __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(r, g), y_rg),
+                                 _mm_madd_epi16(_mm_unpacklo_epi16(b, zero), y_b));
+      __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(r, g), y_rg),
+                                 _mm_madd_epi16(_mm_unpackhi_epi16(b, zero), y_b));
+      y16[h] = _mm_packs_epi32(_mm_srai_epi32(lo, 10), _mm_srai_epi32(hi, 10));
+    }
+    __m128i y8 = _mm_packus_epi16(y16[0], y16[1]);
+
+    // chroma of each pixel pair from the channel sums of the pair
+    __m128i rs = _mm_maddubs_epi16(p[0], ones);
+    __m128i gs = _mm_maddubs_epi16(p[1], ones);
+    __m128i bs = _mm_maddubs_epi16(p[2], ones);
+    __m128i rg_lo = _mm_unpacklo_epi16(rs, gs);
+    __m128i rg_hi = _mm_unpackhi_epi16(rs, gs);
+    __m128i b_lo = _mm_unpacklo_epi16(bs, zero);
+    __m128i b_hi = _mm_unpackhi_epi16(bs, zero);
+    __m128i u = _mm_packs_epi32(
+        _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(rg_lo, u_rg), _mm_madd_epi16(b_lo, u_b)), 11),
+        _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(rg_hi, u_rg), _mm_madd_epi16(b_hi, u_b)), 11));
+    __m128i v = _mm_packs_epi32(
+        _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(rg_lo, v_rg), _mm_madd_epi16(b_lo, v_b)), 11),
+        _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(rg_hi, v_rg), _mm_madd_epi16(b_hi, v_b)), 11));
+    // u and v bytes alternating, one pair per macro pixel
+    __m128i uv = _mm_packus_epi16(_mm_add_epi16(u, offset), _mm_add_epi16(v, offset));
+    uv = _mm_shuffle_epi8(uv, _mm_setr_epi8(0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14, 7, 15));
+
+    __m128i out_lo = YUYV ? _mm_unpacklo_epi8(y8, uv) : _mm_unpacklo_epi8(uv, y8);
+    __m128i out_hi = YUYV ? _mm_unpackhi_epi8(y8, uv) : _mm_unpackhi_epi8(uv, y8);
+    _mm_storeu_si128((__m128i *) (dest + i * 2), out_lo);
+    _mm_storeu_si128((__m128i *) (dest + i * 2 + 16), out_hi);
+  }
+  return i;
+}
+
+int shuffle48Simd(const Shuffle48 & shuffle, const unsigned char * src, int src_stride,
+                  unsigned char * dest, int num_pixels) {
+  int i = 0;
+  for (; i + 16 <= num_pixels; i += 16) {
+    __m128i in[3];
+    in[0] = _mm_loadu_si128((const __m128i *) (src + i * src_stride));
+    in[1] = src_stride > 1 ? _mm_loadu_si128((const __m128i *) (src + i * src_stride + 16)) : in[0];
+    in[2] = src_stride > 1 ? _mm_loadu_si128((const __m128i *) (src + i * src_stride + 32)) : in[0];
+    __m128i out[3];
+    shuffle.apply(in, out);
+    _mm_storeu_si128((__m128i *) (dest + i * 3), out[0]);
+    _mm_storeu_si128((__m128i *) (dest + i * 3 + 16), out[1]);
+    _mm_storeu_si128((__m128i *) (dest + i * 3 + 32), out[2]);
+  }
+  return i;
+}
+
+}  // namespace
+#endif
+
+// the reference for the vectorized rgb to YUV 4:2:2 conversion,
+// chroma is taken from the average of both pixels
+static inline void rgb2yuv422Pair(const unsigned char * src, unsigned char & y0, unsigned char & y1,
+                                  unsigned char & u, unsigned char & v) {
+  int rs = src[0] + src[3];
+  int gs = src[1] + src[4];
+  int bs = src[2] + src[5];
+  y0 = ( 306*src[0] + 601*src[1] + 117*src[2] ) >> 10;
+  y1 = ( 306*src[3] + 601*src[4] + 117*src[5] ) >> 10;
+  u = bound( ( ( -172*rs - 340*gs + 512*bs ) >> 11 ) + 128, 0, 255 );
+  v = bound( ( ( 512*rs - 429*gs - 83*bs ) >> 11 ) + 128, 0, 255 );
+}
+
+static inline void yuv422ToRgbPair(int y0, int y1, int u, int v, unsigned char * dest, bool bgr) {
+  int r, g, b;
+  Conversions::yuv2rgb ( y0, u - 128, v - 128, r, g, b );
+  dest[0] = bgr ? b : r;
+  dest[1] = g;
+  dest[2] = bgr ? r : b;
+  Conversions::yuv2rgb ( y1, u - 128, v - 128, r, g, b );
+  dest[3] = bgr ? b : r;
+  dest[4] = g;
+  dest[5] = bgr ? r : b;
+}
+
 void Conversions::bgr2rgb ( unsigned char *src,
                             unsigned char *dest,
                             int width,
                             int height ) {
+  int done = 0;
+#ifdef __SSSE3__
+  done = shuffle48Simd(swapRedBlue(), src, 3, dest, width*height);
+#endif
+  bgr2rgbScalar(src, dest, width, height, done);
+}
+
+void Conversions::bgr2rgbScalar ( unsigned char *src,
+                                  unsigned char *dest,
+                                  int width,
+                                  int height,
+                                  int first ) {
   int NumPixels = width*height;
-  for ( int i=0;i<NumPixels*3;i+=3 ) {
-    dest[i]   = src[i+2];
+  for ( int i=first*3;i<NumPixels*3;i+=3 ) {
+    unsigned char r = src[i+2];
     dest[i+1] = src[i+1];
     dest[i+2] = src[i];
+    dest[i]   = r;
   }
 }
 
@@ -46,12 +299,7 @@ void Conversions::rgb2bgr ( unsigned char *src,
                             unsigned char *dest,
                             int width,
                             int height ) {
-  int NumPixels = width*height;
-  for ( int i=0;i<NumPixels*3;i+=3 ) {
-    dest[i]   = src[i+2];
-    dest[i+1] = src[i+1];
-    dest[i+2] = src[i];
-  }
+  bgr2rgb(src, dest, width, height);
 }
 
 void Conversions::rgb482rgb ( unsigned char *src,
@@ -99,165 +347,113 @@ void Conversions::uyvy2rgb ( unsigned char *src,
                              unsigned char *dest,
                              int width,
                              int height ) {
-  #ifndef NO_DC1394_CONVERSIONS
-    dc1394_convert_to_RGB8(src,dest, width, height, DC1394_BYTE_ORDER_UYVY,
-                       DC1394_COLOR_CODING_YUV422, 8);
-  #else
-  
+  int done = 0;
+#ifdef __SSSE3__
+  done = yuv422ToRgbSimd<false, false>(src, dest, width*height);
+#elif !defined(NO_DC1394_CONVERSIONS)
+  dc1394_convert_to_RGB8(src,dest, width, height, DC1394_BYTE_ORDER_UYVY,
+                         DC1394_COLOR_CODING_YUV422, 8);
+  done = width*height;
+#endif
+  uyvy2rgbScalar(src, dest, width, height, done);
+}
+
+void Conversions::uyvy2rgbScalar ( unsigned char *src,
+                                   unsigned char *dest,
+                                   int width,
+                                   int height,
+                                   int first ) {
   int NumPixels = width*height;
-                             
-  register int max_i = ( NumPixels << 1 )-1;
-  //register int max_j = NumPixels + ( NumPixels << 1 ) -1;
-  register int i = 0;
-  register int j = 0;
-  register int y0, y1, u, v;
-  register int r, g, b;
-
-  while ( i < max_i ) {
-    u  = ( unsigned char ) src[i++] - 128;
-    y0 = ( unsigned char ) src[i++];
-    v  = ( unsigned char ) src[i++] - 128;
-    y1 = ( unsigned char ) src[i++];
-    yuv2rgb ( y0, u, v, r, g, b );
-    dest[j++] = r;
-    dest[j++] = g;
-    dest[j++] = b;
-    yuv2rgb ( y1, u, v, r, g, b );
-    dest[j++] = r;
-    dest[j++] = g;
-    dest[j++] = b;
+  for ( int i=first; i+1<NumPixels; i+=2 ) {
+    const unsigned char * s = src + i*2;
+    yuv422ToRgbPair ( s[1], s[3], s[0], s[2], dest + i*3, false );
   }
-  #endif
 }
 
 void Conversions::yuyv2rgb ( unsigned char *src,
                             unsigned char *dest,
                             int width,
                             int height ) {
-#ifndef NO_DC1394_CONVERSIONS
-    dc1394_convert_to_RGB8(src,dest, width, height, DC1394_BYTE_ORDER_YUYV,
-                           DC1394_COLOR_CODING_YUV422, 8);
-#else
-    
-    int NumPixels = width*height;
-    
-    register int max_i = ( NumPixels << 1 )-1;
-    //register int max_j = NumPixels + ( NumPixels << 1 ) -1;
-    register int i = 0;
-    register int j = 0;
-    register int y0, y1, u, v;
-    register int r, g, b;
-    
-    while ( i < max_i ) {
-        y0 = ( unsigned char ) src[i++];
-        u  = ( unsigned char ) src[i++];
-        y1 = ( unsigned char ) src[i++];
-        v  = ( unsigned char ) src[i++];
-        yuv2rgb ( y0, u, v, r, g, b );
-        dest[j++] = r;
-        dest[j++] = g;
-        dest[j++] = b;
-        yuv2rgb ( y1, u, v, r, g, b );
-        dest[j++] = r;
-        dest[j++] = g;
-        dest[j++] = b;
-    }
+  int done = 0;
+#ifdef __SSSE3__
+  done = yuv422ToRgbSimd<true, false>(src, dest, width*height);
+#elif !defined(NO_DC1394_CONVERSIONS)
+  dc1394_convert_to_RGB8(src,dest, width, height, DC1394_BYTE_ORDER_YUYV,
+                         DC1394_COLOR_CODING_YUV422, 8);
+  done = width*height;
 #endif
+  yuyv2rgbScalar(src, dest, width, height, done);
+}
+
+void Conversions::yuyv2rgbScalar ( unsigned char *src,
+                                   unsigned char *dest,
+                                   int width,
+                                   int height,
+                                   int first ) {
+  int NumPixels = width*height;
+  for ( int i=first; i+1<NumPixels; i+=2 ) {
+    const unsigned char * s = src + i*2;
+    yuv422ToRgbPair ( s[0], s[2], s[1], s[3], dest + i*3, false );
+  }
 }
 
 
 void Conversions::rgb2uyvy (unsigned char *src, unsigned char *dest, int width, int height)
 {
-#ifndef NO_DC1394_CONVERSIONS
-    dc1394_convert_to_RGB8(src,dest, width, height, DC1394_BYTE_ORDER_UYVY,
-                           DC1394_COLOR_CODING_RGB8, 8);
-#else
-    
-    int NumPixels = width*height;
-    
-    register int max_i = ( NumPixels << 1 )-1;
-    //register int max_j = NumPixels + ( NumPixels << 1 ) -1;
-    register int i = 0;
-    register int j = 0;
-    register int y0, y1, u, v;
-    register int r, g, b;
-    
-    while ( i < max_i ) {
-        r = ( unsigned char ) src[i++];
-        g = ( unsigned char ) src[i++];
-        b = ( unsigned char ) src[i++];
-        rgb2yuv ( r, g, b, y0, u, v );
-        r = ( unsigned char ) src[i++];
-        g = ( unsigned char ) src[i++];
-        b = ( unsigned char ) src[i++];
-        rgb2yuv ( r, g, b, y1, u, v );
-        dest[j++] = u+128;
-        dest[j++] = y0;
-        dest[j++] = v+128;
-        dest[j++] = y1;
-    }
+  int done = 0;
+#ifdef __SSSE3__
+  done = rgbToYuv422Simd<false>(src, dest, width*height);
 #endif
+  rgb2uyvyScalar(src, dest, width, height, done);
+}
 
+void Conversions::rgb2uyvyScalar (unsigned char *src, unsigned char *dest, int width, int height, int first)
+{
+  int NumPixels = width*height;
+  for ( int i=first; i+1<NumPixels; i+=2 ) {
+    unsigned char * d = dest + i*2;
+    rgb2yuv422Pair ( src + i*3, d[1], d[3], d[0], d[2] );
+  }
 }
 
 void Conversions::rgb2yuyv (unsigned char *src, unsigned char *dest, int width, int height)
 {
-#ifndef NO_DC1394_CONVERSIONS
-    dc1394_convert_to_RGB8(src,dest, width, height, DC1394_BYTE_ORDER_YUYV,
-                           DC1394_COLOR_CODING_RGB8, 8);
-#else
-    
-    int NumPixels = width*height;
-    
-    register int max_i = ( NumPixels << 1 )-1;
-    //register int max_j = NumPixels + ( NumPixels << 1 ) -1;
-    register int i = 0;
-    register int j = 0;
-    register int y0, y1, u, v;
-    register int r, g, b;
-    
-    while ( i < max_i ) {
-        r = ( unsigned char ) src[i++];
-        g = ( unsigned char ) src[i++];
-        b = ( unsigned char ) src[i++];
-        rgb2yuv ( r, g, b, y0, u, v );
-        r = ( unsigned char ) src[i++];
-        g = ( unsigned char ) src[i++];
-        b = ( unsigned char ) src[i++];
-        rgb2yuv ( r, g, b, y1, u, v );
-        dest[j++] = y0;
-        dest[j++] = u+128;
-        dest[j++] = y1;
-        dest[j++] = v+128;
-    }
+  int done = 0;
+#ifdef __SSSE3__
+  done = rgbToYuv422Simd<true>(src, dest, width*height);
 #endif
+  rgb2yuyvScalar(src, dest, width, height, done);
+}
+
+void Conversions::rgb2yuyvScalar (unsigned char *src, unsigned char *dest, int width, int height, int first)
+{
+  int NumPixels = width*height;
+  for ( int i=first; i+1<NumPixels; i+=2 ) {
+    unsigned char * d = dest + i*2;
+    rgb2yuv422Pair ( src + i*3, d[0], d[2], d[1], d[3] );
+  }
 }
 
 void Conversions::uyvy2bgr ( unsigned char *src,
                              unsigned char *dest,
                              int width,
                              int height ) {
+  int done = 0;
+#ifdef __SSSE3__
+  done = yuv422ToRgbSimd<false, true>(src, dest, width*height);
+#endif
+  uyvy2bgrScalar(src, dest, width, height, done);
+}
 
+void Conversions::uyvy2bgrScalar ( unsigned char *src,
+                                   unsigned char *dest,
+                                   int width,
+                                   int height,
+                                   int first ) {
   int NumPixels = width*height;
-
-  register int i = ( NumPixels << 1 )-1;
-  register int j = NumPixels + ( NumPixels << 1 ) -1;
-  register int y0, y1, u, v;
-  int r, g, b;
-
-  while ( i > 0 ) {
-    y1 = ( unsigned char ) src[i--];
-    v  = ( unsigned char ) src[i--] - 128;
-    y0 = ( unsigned char ) src[i--];
-    u  = ( unsigned char ) src[i--] - 128;
-    yuv2rgb ( y1, u, v, r, g, b );
-    dest[j--] = r;
-    dest[j--] = g;
-    dest[j--] = b;
-    yuv2rgb ( y0, u, v, r, g, b );
-    dest[j--] = r;
-    dest[j--] = g;
-    dest[j--] = b;
+  for ( int i=first; i+1<NumPixels; i+=2 ) {
+    const unsigned char * s = src + i*2;
+    yuv422ToRgbPair ( s[1], s[3], s[0], s[2], dest + i*3, true );
   }
 }
 
@@ -302,16 +498,23 @@ void Conversions::y2rgb ( unsigned char *src,
                           unsigned char *dest,
                           int width,
                           int height ) {
-  int NumPixels = width*height;
-  register int i = NumPixels-1;
-  register int j = NumPixels + ( NumPixels << 1 )-1;
-  register int y;
+  int done = 0;
+#ifdef __SSSE3__
+  done = shuffle48Simd(greyToPacked(), src, 1, dest, width*height);
+#endif
+  y2rgbScalar(src, dest, width, height, done);
+}
 
-  while ( i > 0 ) {
-    y = ( unsigned char ) src[i--];
-    dest[j--] = y;
-    dest[j--] = y;
-    dest[j--] = y;
+void Conversions::y2rgbScalar ( unsigned char *src,
+                                unsigned char *dest,
+                                int width,
+                                int height,
+                                int first ) {
+  int NumPixels = width*height;
+  for ( int i=first; i<NumPixels; i++ ) {
+    dest[i*3] = src[i];
+    dest[i*3+1] = src[i];
+    dest[i*3+2] = src[i];
   }
 }
 
@@ -14,7 +14,7 @@
 //========================================================================
 /*!
   \file    conversions.h
-  \brief   Various color conversion operations, but NOT very optimized
+  \brief   Various color conversion operations
   \author  
 */
 //========================================================================
@@ -31,9 +31,9 @@
 //#include "ccvt.h"
 
 //-------------------------------------------------
-//NOTE full image conversion routines (yuv->rgb) in this file
-//     have been measured to be REALLY slow
-//     Some functions will use dc1394 for speedup (if available)
+//NOTE the YUV 4:2:2 and rgb/bgr full image conversion routines
+//     use SSSE3 when the compiler targets it (-march=native in
+//     release builds). Otherwise, yuv->rgb uses dc1394 (if available)
 //-------------------------------------------------
 
 
@@ -122,6 +122,15 @@ static void uyv2rgb (unsigned char *src, unsigned char *dest, int width, int hei
 static void uyvy2bgr (unsigned char *src, unsigned char *dest, int width, int height);
 static void y162rgb (unsigned char *src, unsigned char *dest, int width, int height, int bits);
 
+//portable versions of the SSSE3 conversions. They also convert the pixels
+//that the SSSE3 kernels leave over, starting at pixel first.
+static void uyvy2rgbScalar (unsigned char *src, unsigned char *dest, int width, int height, int first=0);
+static void yuyv2rgbScalar (unsigned char *src, unsigned char *dest, int width, int height, int first=0);
+static void uyvy2bgrScalar (unsigned char *src, unsigned char *dest, int width, int height, int first=0);
+static void rgb2uyvyScalar (unsigned char *src, unsigned char *dest, int width, int height, int first=0);
+static void rgb2yuyvScalar (unsigned char *src, unsigned char *dest, int width, int height, int first=0);
+static void bgr2rgbScalar (unsigned char *src, unsigned char *dest, int width, int height, int first=0);
+static void y2rgbScalar (unsigned char *src, unsigned char *dest, int width, int height, int first=0);
 
 };
 
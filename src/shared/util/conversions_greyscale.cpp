@@ -59,8 +59,9 @@ void ConversionsGreyscale::cv16bit2_8bit(const RawImage &src, Image<raw8> *dst)
 }
 
 void ConversionsGreyscale::manualColor2Grey(const RawImage &src, Image<raw8> *dst) {
-  for (int i = 0; i < src.getWidth(); ++i) {
-    for (int j = 0; j < src.getHeight(); ++j) {
+  // row by row, to walk both images in memory order
+  for (int j = 0; j < src.getHeight(); ++j) {
+    for (int i = 0; i < src.getWidth(); ++i) {
       const auto pixel = src.getRgb(i, j);
       *(dst->getPixelPointer(i, j)) = (pixel.r + pixel.g + pixel.b) / 3;
     }
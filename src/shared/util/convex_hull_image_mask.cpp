@@ -3,6 +3,23 @@
 #include <tuple>
 #include <iostream>
 
+// the first and last white pixel of each row, the rows of the mask have
+// no gaps: they are either filled or cross a single line of the hull
+void computeRowSpans(const Image<raw8> &mask, std::vector<ImageRowSpan> &spans) {
+  const auto WHITE = raw8(255);
+  spans.resize(mask.getHeight());
+  for (int y = 0; y < mask.getHeight(); ++y) {
+    const raw8 *row = mask.getPixelData() + y * mask.getWidth();
+    int start = 0;
+    while (start < mask.getWidth() && row[start] != WHITE)
+      ++start;
+    int end = mask.getWidth();
+    while (end > start && row[end - 1] != WHITE)
+      --end;
+    spans[y] = ImageRowSpan(start, end);
+  }
+}
+
 void computeMask(const ConvexHull &convex_hull, Image<raw8> &mask) {
   const auto WHITE = raw8(255);
 
@@ -83,6 +100,7 @@ void ConvexHullImageMask::reset() {
 
   _convex_hull.clear();
   computeMask(_convex_hull, _mask);
+  computeRowSpans(_mask, _row_spans);
   _v_list->resetToDefault();
 
   unlock();
@@ -93,6 +111,7 @@ void ConvexHullImageMask::_addPoint(const int x, const int y, const bool add_to_
 
   if (changed) {
     computeMask(_convex_hull, _mask);
+    computeRowSpans(_mask, _row_spans);
 
     if (add_to_list) {
       VarTypes::VarList *point = new VarTypes::VarList();
@@ -120,6 +139,7 @@ void ConvexHullImageMask::removePoint(const int x, const int y, const int margin
 
   if (changed) {
     computeMask(_convex_hull, _mask);
+    computeRowSpans(_mask, _row_spans);
 
     _v_list->resetToDefault();
     for (auto it = _convex_hull.begin(); it != _convex_hull.end(); ++it) {
@@ -140,6 +160,7 @@ void ConvexHullImageMask::setSize(const int w, const int h) {
   lock();
   _mask.allocate(w, h);
   computeMask(_convex_hull, _mask);
+  computeRowSpans(_mask, _row_spans);
   unlock();
 }
 
@@ -179,6 +200,10 @@ const Image<raw8>& ConvexHullImageMask::getMask() const {
   return _mask;
 }
 
+const std::vector<ImageRowSpan>& ConvexHullImageMask::getRowSpans() const {
+  return _row_spans;
+}
+
 const ConvexHull& ConvexHullImageMask::getConvexHull() const {
   return _convex_hull;
 }
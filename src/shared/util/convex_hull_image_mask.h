@@ -3,6 +3,7 @@
 
 #include "image.h"
 #include "convex_hull.h"
+#include "image_row_span.h"
 #include "VarTypes.h"
 #include <qmutex.h>
 
@@ -11,6 +12,7 @@ class ConvexHullImageMask : public QObject {
  private:
   ConvexHull _convex_hull;
   Image<raw8> _mask;
+  std::vector<ImageRowSpan> _row_spans;
   VarTypes::VarExternal * _v_settings;
   VarTypes::VarList * _v_list;
   mutable QMutex mutex;
@@ -28,6 +30,8 @@ class ConvexHullImageMask : public QObject {
   int getWidth() const;
   int getHeight() const;
   const Image<raw8>& getMask() const;
+  /// one span per row of the mask, describes the same pixels as getMask()
+  const std::vector<ImageRowSpan>& getRowSpans() const;
   const ConvexHull& getConvexHull() const;
 
   void lock() const;
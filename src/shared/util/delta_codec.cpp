@@ -0,0 +1,164 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    delta_codec.cpp
+  \brief   C++ Implementation: DeltaCodec
+*/
+//========================================================================
+#include "delta_codec.h"
+#include <string.h>
+
+static const int kBlockSize = 16;
+
+enum BlockTag {
+  TagZero = 0,  // all differences zero, nothing stored
+  Tag4Bit = 1,  // differences in [-8,7], 8 bytes
+  Tag6Bit = 2,  // differences in [-32,31], 12 bytes
+  Tag8Bit = 3   // 16 bytes
+};
+
+int DeltaCodec::getPeriod(ColorFormat format) {
+  switch (format) {
+    case COLOR_YUV422_UYVY:
+    case COLOR_YUV422_YUYV:
+    case COLOR_RGBA8:
+    case COLOR_MONO16:
+    case COLOR_RAW16:
+      return 4;
+    case COLOR_RGB8:
+    case COLOR_YUV444:
+      return 3;
+    case COLOR_RAW8:
+      // bayer pattern, the same color repeats every other pixel
+      return 2;
+    case COLOR_RGB16:
+      return 6;
+    case COLOR_RAW32:
+      return 8;
+    default:
+      return 1;
+  }
+}
+
+size_t DeltaCodec::getMaxCompressedSize(size_t size) {
+  size_t blocks = size / kBlockSize;
+  return (blocks + 3) / 4 + size;
+}
+
+size_t DeltaCodec::compress(const uint8_t * src, size_t size, int period, uint8_t * dst) {
+  size_t blocks = size / kBlockSize;
+  size_t tag_bytes = (blocks + 3) / 4;
+  memset(dst, 0, tag_bytes);
+  uint8_t * tags = dst;
+  uint8_t * out = dst + tag_bytes;
+
+  size_t i = 0;
+  for (size_t b = 0; b < blocks; b++) {
+    // differences, and their maxima with the bias of each width, in plain loops that vectorize
+    uint8_t d[kBlockSize];
+    if (i >= (size_t) period) {
+      for (int k = 0; k < kBlockSize; k++) {
+        d[k] = (uint8_t) (src[i + k] - src[i + k - period]);
+      }
+    } else {
+      for (int k = 0; k < kBlockSize; k++) {
+        d[k] = (uint8_t) (src[i + k] - (i + k >= (size_t) period ? src[i + k - period] : 0));
+      }
+    }
+    uint8_t any = 0;
+    uint8_t max4 = 0;
+    uint8_t max6 = 0;
+    for (int k = 0; k < kBlockSize; k++) {
+      uint8_t v4 = (uint8_t) (d[k] + 8);
+      uint8_t v6 = (uint8_t) (d[k] + 32);
+      any |= d[k];
+      max4 = v4 > max4 ? v4 : max4;
+      max6 = v6 > max6 ? v6 : max6;
+    }
+
+    int tag;
+    if (any == 0) {
+      tag = TagZero;
+    } else if (max4 < 16) {
+      tag = Tag4Bit;
+      for (int k = 0; k < kBlockSize; k += 2) {
+        *out++ = (uint8_t) (((d[k] + 8) & 15) | (((d[k + 1] + 8) & 15) << 4));
+      }
+    } else if (max6 < 64) {
+      tag = Tag6Bit;
+      for (int k = 0; k < kBlockSize; k += 4) {
+        uint32_t v = (uint32_t) ((d[k] + 32) & 63) | ((uint32_t) ((d[k + 1] + 32) & 63) << 6) |
+                     ((uint32_t) ((d[k + 2] + 32) & 63) << 12) | ((uint32_t) ((d[k + 3] + 32) & 63) << 18);
+        *out++ = (uint8_t) v;
+        *out++ = (uint8_t) (v >> 8);
+        *out++ = (uint8_t) (v >> 16);
+      }
+    } else {
+      tag = Tag8Bit;
+      memcpy(out, d, kBlockSize);
+      out += kBlockSize;
+    }
+    tags[b >> 2] |= (uint8_t) (tag << ((b & 3) * 2));
+    i += kBlockSize;
+  }
+
+  // the tail is stored as plain differences
+  for (; i < size; i++) {
+    *out++ = (uint8_t) (src[i] - (i >= (size_t) period ? src[i - period] : 0));
+  }
+  return out - dst;
+}
+
+void DeltaCodec::decompress(const uint8_t * src, uint8_t * dst, size_t size, int period) {
+  size_t blocks = size / kBlockSize;
+  size_t tag_bytes = (blocks + 3) / 4;
+  const uint8_t * tags = src;
+  const uint8_t * in = src + tag_bytes;
+
+  size_t i = 0;
+  for (size_t b = 0; b < blocks; b++) {
+    int8_t d[kBlockSize];
+    int tag = (tags[b >> 2] >> ((b & 3) * 2)) & 3;
+    if (tag == TagZero) {
+      memset(d, 0, kBlockSize);
+    } else if (tag == Tag4Bit) {
+      for (int k = 0; k < kBlockSize; k += 2) {
+        uint8_t v = *in++;
+        d[k] = (int8_t) ((v & 15) - 8);
+        d[k + 1] = (int8_t) ((v >> 4) - 8);
+      }
+    } else if (tag == Tag6Bit) {
+      for (int k = 0; k < kBlockSize; k += 4) {
+        uint32_t v = (uint32_t) in[0] | ((uint32_t) in[1] << 8) | ((uint32_t) in[2] << 16);
+        in += 3;
+        d[k] = (int8_t) ((int) (v & 63) - 32);
+        d[k + 1] = (int8_t) ((int) ((v >> 6) & 63) - 32);
+        d[k + 2] = (int8_t) ((int) ((v >> 12) & 63) - 32);
+        d[k + 3] = (int8_t) ((int) (v >> 18) - 32);
+      }
+    } else {
+      memcpy(d, in, kBlockSize);
+      in += kBlockSize;
+    }
+    // sequential, the prediction may point into the same block
+    for (int k = 0; k < kBlockSize; k++) {
+      dst[i + k] = (uint8_t) (d[k] + (i + k >= (size_t) period ? dst[i + k - period] : 0));
+    }
+    i += kBlockSize;
+  }
+  for (; i < size; i++) {
+    dst[i] = (uint8_t) (*in++ + (i >= (size_t) period ? dst[i - period] : 0));
+  }
+}
@@ -0,0 +1,52 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    delta_codec.h
+  \brief   C++ Interface: DeltaCodec
+*/
+//========================================================================
+#ifndef DELTA_CODEC_H
+#define DELTA_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "colors.h"
+
+/*!
+  \class DeltaCodec
+  \brief Fast lossless compression of raw camera images
+
+  Every byte is predicted by the byte one period to its left, which is the
+  same color channel for the given format. The differences are coded in
+  blocks of 16 bytes, with 0, 4, 6 or 8 bits per byte, whichever is the
+  smallest that fits the whole block. A 2-bit tag per block selects the
+  width. The tags are stored in front of the coded blocks.
+
+  This trades compression ratio for speed: camera noise limits any
+  lossless scheme on these images, and the coder has to keep up with the
+  frame rate on the camera thread.
+**/
+class DeltaCodec {
+public:
+  /// distance in bytes to the previous sample of the same channel
+  static int getPeriod(ColorFormat format);
+  /// upper bound of the compressed size of size bytes
+  static size_t getMaxCompressedSize(size_t size);
+  /// returns the compressed size, dst must hold getMaxCompressedSize(size) bytes
+  static size_t compress(const uint8_t * src, size_t size, int period, uint8_t * dst);
+  static void decompress(const uint8_t * src, uint8_t * dst, size_t size, int period);
+};
+
+#endif
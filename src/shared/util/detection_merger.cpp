@@ -0,0 +1,187 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    detection_merger.cpp
+  \brief   C++ Implementation: DetectionMerger
+*/
+//========================================================================
+
+#include "detection_merger.h"
+#include "timer.h"
+
+#include <algorithm>
+#include <cmath>
+
+DetectionMerger::DetectionMerger(RoboCupSSLServer* _server) :
+    values([this](Values& v) { readValues(v); }),
+    server(_server),
+    frame_number(0) {
+  settings = new VarList("Merged Output");
+  settings->addChild(v_enable = new VarBool("enable", false));
+  settings->addChild(v_address = new VarString("Multicast Address", "224.5.23.2"));
+  settings->addChild(v_port = new VarInt("Multicast Port", 10020, 1, 65535));
+  settings->addChild(v_interface = new VarString("Multicast Interface", ""));
+  settings->addChild(v_camera_id = new VarInt("camera id of the merged frame", 0, 0));
+  settings->addChild(v_max_age = new VarDouble("max frame age (s)", 0.05));
+  settings->addChild(v_ball_distance = new VarDouble("ball merge distance (mm)", 100.0));
+  settings->addChild(v_robot_distance = new VarDouble("robot merge distance (mm)", 180.0));
+  settings->addChild(v_confidence_margin = new VarDouble("confidence margin", 0.1));
+  values.bind(settings);
+
+  for (int i = 0; i < MaxCameras; i++) {
+    cameras[i].valid = false;
+  }
+}
+
+DetectionMerger::~DetectionMerger() {
+  delete v_confidence_margin;
+  delete v_robot_distance;
+  delete v_ball_distance;
+  delete v_max_age;
+  delete v_camera_id;
+  delete v_interface;
+  delete v_port;
+  delete v_address;
+  delete v_enable;
+  delete settings;
+}
+
+void DetectionMerger::readValues(Values& v) {
+  v.enable = v_enable->getBool();
+  v.camera_id = v_camera_id->getInt();
+  v.max_age = v_max_age->getDouble();
+  v.ball_distance = v_ball_distance->getDouble();
+  v.robot_distance = v_robot_distance->getDouble();
+  v.confidence_margin = v_confidence_margin->getDouble();
+}
+
+void DetectionMerger::addFrame(const SSL_DetectionFrame& frame, double camera_x, double camera_y) {
+  std::lock_guard<std::mutex> lock(mutex);
+  values.update();
+  if (!values->enable) return;
+
+  int camera = frame.camera_id();
+  if (camera < 0 || camera >= MaxCameras) return;
+
+  // a camera delivering its next frame closes the current period
+  if (cameras[camera].valid) {
+    publish();
+    for (int i = 0; i < MaxCameras; i++) {
+      cameras[i].valid = false;
+    }
+  }
+
+  // CopyFrom() reuses the repeated elements of the previous frame
+  CameraFrame& slot = cameras[camera];
+  slot.frame.CopyFrom(frame);
+  slot.camera_x = camera_x;
+  slot.camera_y = camera_y;
+  slot.valid = true;
+}
+
+void DetectionMerger::addCandidate(std::vector<Candidate>& list, int camera, int id, double x, double y,
+                                   float confidence, const void* detection) {
+  const CameraFrame& slot = cameras[camera];
+  Candidate c;
+  c.camera = camera;
+  c.id = id;
+  c.x = x;
+  c.y = y;
+  c.confidence = confidence;
+  c.camera_distance_sq = (x - slot.camera_x) * (x - slot.camera_x) + (y - slot.camera_y) * (y - slot.camera_y);
+  c.keep = true;
+  c.detection = detection;
+  list.push_back(c);
+}
+
+void DetectionMerger::deduplicate(std::vector<Candidate>& list, double distance) {
+  const Values& v = values.get();
+  double distance_sq = distance * distance;
+  for (size_t i = 0; i < list.size(); i++) {
+    Candidate& a = list[i];
+    for (size_t j = i + 1; j < list.size() && a.keep; j++) {
+      Candidate& b = list[j];
+      // a camera does not report the same object twice
+      if (!b.keep || a.camera == b.camera) continue;
+      // two detections of one robot carry the same id and lie close together; objects
+      // without an id, like balls, are matched by distance alone
+      if (a.id != b.id) continue;
+      if ((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) >= distance_sq) continue;
+
+      bool a_wins;
+      if (std::fabs(a.confidence - b.confidence) > v.confidence_margin) {
+        a_wins = a.confidence > b.confidence;
+      } else {
+        a_wins = a.camera_distance_sq <= b.camera_distance_sq;
+      }
+      (a_wins ? b : a).keep = false;
+    }
+  }
+}
+
+void DetectionMerger::publish() {
+  const Values& v = values.get();
+
+  // the newest frame sets the time of the merged frame
+  double t_capture = 0.0;
+  for (int i = 0; i < MaxCameras; i++) {
+    if (cameras[i].valid) t_capture = std::max(t_capture, cameras[i].frame.t_capture());
+  }
+
+  balls.clear();
+  robots[0].clear();
+  robots[1].clear();
+  for (int camera = 0; camera < MaxCameras; camera++) {
+    const CameraFrame& slot = cameras[camera];
+    if (!slot.valid || t_capture - slot.frame.t_capture() > v.max_age) continue;
+    const SSL_DetectionFrame& frame = slot.frame;
+    for (int i = 0; i < frame.balls_size(); i++) {
+      const SSL_DetectionBall& ball = frame.balls(i);
+      addCandidate(balls, camera, -1, ball.x(), ball.y(), ball.confidence(), &ball);
+    }
+    for (int team = 0; team < 2; team++) {
+      const ::google::protobuf::RepeatedPtrField<SSL_DetectionRobot>& detections =
+          (team == 0) ? frame.robots_blue() : frame.robots_yellow();
+      for (int i = 0; i < detections.size(); i++) {
+        const SSL_DetectionRobot& robot = detections.Get(i);
+        addCandidate(robots[team], camera, robot.has_robot_id() ? (int) robot.robot_id() : -1,
+                     robot.x(), robot.y(), robot.confidence(), &robot);
+      }
+    }
+  }
+
+  deduplicate(balls, v.ball_distance);
+  deduplicate(robots[0], v.robot_distance);
+  deduplicate(robots[1], v.robot_distance);
+
+  // Clear() keeps the allocated repeated elements, so the add_*() below reuse them
+  SSL_DetectionFrame* merged = packet.mutable_detection();
+  merged->Clear();
+  merged->set_frame_number(frame_number++);
+  merged->set_t_capture(t_capture);
+  merged->set_camera_id(v.camera_id);
+  for (const Candidate& c : balls) {
+    if (c.keep) merged->add_balls()->CopyFrom(*(const SSL_DetectionBall*) c.detection);
+  }
+  for (const Candidate& c : robots[0]) {
+    if (c.keep) merged->add_robots_blue()->CopyFrom(*(const SSL_DetectionRobot*) c.detection);
+  }
+  for (const Candidate& c : robots[1]) {
+    if (c.keep) merged->add_robots_yellow()->CopyFrom(*(const SSL_DetectionRobot*) c.detection);
+  }
+  merged->set_t_sent(GetTimeSec());
+
+  server->send(packet, buffer);
+}
@@ -0,0 +1,131 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    detection_merger.h
+  \brief   C++ Interface: DetectionMerger
+*/
+//========================================================================
+#ifndef DETECTION_MERGER_H
+#define DETECTION_MERGER_H
+
+#include <VarTypes.h>
+#include <VarBinding.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "messages_robocup_ssl_detection.pb.h"
+#include "messages_robocup_ssl_wrapper.pb.h"
+#include "robocup_ssl_server.h"
+
+using namespace VarTypes;
+
+/*!
+  \class DetectionMerger
+  \brief Merges the detection frames of all cameras into one frame per period
+
+  Every camera stack passes its detection frame to addFrame(), together
+  with the field position of its camera. The latest frame of each camera
+  is kept. When a camera delivers its next frame, the kept frames form one
+  period and are merged into a single SSL_DetectionFrame. Frames that are
+  much older than the newest one, e.g. from a stalled camera, are left
+  out.
+
+  Where the fields of view overlap, detections of the same object by
+  different cameras are reduced to one. Robots match if they have the same
+  id and lie within the robot merge distance, so two robots that carry the
+  same pattern by mistake are both kept. The detection with the clearly
+  higher confidence wins, and for similar confidences the one closer to
+  its camera center, where the projection error is smallest.
+**/
+class DetectionMerger {
+ public:
+  static const int MaxCameras = 32;
+
+  explicit DetectionMerger(RoboCupSSLServer* server);
+  ~DetectionMerger();
+
+  VarList* getSettings() { return settings; }
+  VarInt* getPort() { return v_port; }
+  VarString* getAddress() { return v_address; }
+  VarString* getInterface() { return v_interface; }
+  bool isEnabled() const { return v_enable->getBool(); }
+
+  /// may be called from any camera thread, (camera_x, camera_y) is the camera's field position
+  void addFrame(const SSL_DetectionFrame& frame, double camera_x, double camera_y);
+
+ protected:
+  class CameraFrame {
+   public:
+    bool valid;
+    double camera_x;
+    double camera_y;
+    SSL_DetectionFrame frame;
+  };
+
+  /// one detection of a ball or robot, candidate for the merged frame
+  class Candidate {
+   public:
+    int camera;
+    int id;  // robot id, -1 for balls and robots without id
+    double x;
+    double y;
+    float confidence;
+    double camera_distance_sq;
+    bool keep;
+    const void* detection;
+  };
+
+  struct Values {
+    bool enable;
+    int camera_id;
+    double max_age;
+    double ball_distance;
+    double robot_distance;
+    double confidence_margin;
+  };
+
+  VarList* settings;
+  VarBool* v_enable;
+  VarInt* v_port;
+  VarString* v_address;
+  VarString* v_interface;
+  VarInt* v_camera_id;
+  VarDouble* v_max_age;
+  VarDouble* v_ball_distance;
+  VarDouble* v_robot_distance;
+  VarDouble* v_confidence_margin;
+  VarBinding<Values> values;
+
+  std::mutex mutex;
+  RoboCupSSLServer* server;
+  CameraFrame cameras[MaxCameras];
+  unsigned int frame_number;
+
+  // kept across periods, so that merging does not allocate
+  std::vector<Candidate> balls;
+  std::vector<Candidate> robots[2];  // blue, yellow
+  SSL_WrapperPacket packet;
+  std::string buffer;
+
+  void readValues(Values& v);
+  void addCandidate(std::vector<Candidate>& list, int camera, int id, double x, double y, float confidence,
+                    const void* detection);
+  void deduplicate(std::vector<Candidate>& list, double distance);
+  void publish();
+};
+
+#endif
@@ -0,0 +1,325 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    detection_tracker.cpp
+  \brief   C++ Implementation: DetectionTracker
+*/
+//========================================================================
+
+#include "detection_tracker.h"
+
+#include <QUuid>
+#include <algorithm>
+#include <cmath>
+
+// initial velocity variance of a new track, (mm/s)^2 and (rad/s)^2
+static const double kInitialVelocityVar = 1e6;
+static const double kInitialAngularVelocityVar = 100.0;
+
+// detections are in mm, the tracked frame is in m
+static const double kMillimetersToMeters = 0.001;
+
+static double wrapAngle(double a) {
+  while (a >= M_PI) a -= 2.0 * M_PI;
+  while (a < -M_PI) a += 2.0 * M_PI;
+  return a;
+}
+
+//========================================================================
+
+void DetectionTracker::Axis::reset(double z, double r, double v_var) {
+  x = z;
+  v = 0.0;
+  p00 = r;
+  p01 = 0.0;
+  p11 = v_var;
+}
+
+void DetectionTracker::Axis::predict(double dt, double q) {
+  x += v * dt;
+  // P = F P F^T + Q, with the discretized white acceleration noise Q
+  double dt2 = dt * dt;
+  p00 += dt * (2.0 * p01 + dt * p11) + q * dt2 * dt / 3.0;
+  p01 += dt * p11 + q * dt2 / 2.0;
+  p11 += q * dt;
+}
+
+void DetectionTracker::Axis::update(double z, double r) {
+  updateInnovation(z - x, r);
+}
+
+void DetectionTracker::Axis::updateInnovation(double y, double r) {
+  double s = p00 + r;
+  double k0 = p00 / s;
+  double k1 = p01 / s;
+  x += k0 * y;
+  v += k1 * y;
+  // P = (I - K H) P
+  p11 -= k1 * p01;
+  p01 -= k0 * p01;
+  p00 -= k0 * p00;
+}
+
+DetectionTracker::Track::Track() : active(false), hits(0), t(0.0), t_seen(0.0) {
+  ax.reset(0.0, 0.0, 0.0);
+  ay.reset(0.0, 0.0, 0.0);
+  aa.reset(0.0, 0.0, 0.0);
+}
+
+void DetectionTracker::Track::predict(double t_new, double q_pos, double q_angle) {
+  // measurements of other cameras may arrive slightly out of order, those are applied at the current state time
+  double dt = t_new - t;
+  if (dt <= 0.0) return;
+  ax.predict(dt, q_pos);
+  ay.predict(dt, q_pos);
+  aa.predict(dt, q_angle);
+  aa.x = wrapAngle(aa.x);
+  t = t_new;
+}
+
+//========================================================================
+
+DetectionTracker::DetectionTracker(RoboCupSSLServer* _server) :
+    values([this](Values& v) { readValues(v); }),
+    server(_server),
+    t_latest(0.0),
+    frame_number(0) {
+  settings = new VarList("Tracker");
+  settings->addChild(v_enable = new VarBool("enable", false));
+  settings->addChild(v_address = new VarString("Multicast Address", "224.5.23.2"));
+  settings->addChild(v_port = new VarInt("Multicast Port", 10010, 1, 65535));
+  settings->addChild(v_interface = new VarString("Multicast Interface", ""));
+  settings->addChild(v_source_name = new VarString("Source Name", "ssl-vision"));
+  settings->addChild(filter = new VarList("Filter"));
+  filter->addChild(v_q_ball = new VarDouble("ball acceleration noise (mm^2/s^3)", 1e7));
+  filter->addChild(v_q_robot = new VarDouble("robot acceleration noise (mm^2/s^3)", 1e6));
+  filter->addChild(v_q_angle = new VarDouble("robot angular acceleration noise (rad^2/s^3)", 100.0));
+  filter->addChild(v_r_pos = new VarDouble("position measurement stddev (mm)", 10.0));
+  filter->addChild(v_r_angle = new VarDouble("orientation measurement stddev (rad)", 0.05));
+  filter->addChild(v_gate = new VarDouble("ball association distance (mm)", 500.0));
+  filter->addChild(v_timeout = new VarDouble("track timeout (s)", 0.5));
+  filter->addChild(v_min_ball_conf = new VarDouble("min ball confidence", 0.1));
+  filter->addChild(v_min_hits = new VarInt("min ball detections", 3));
+  values.bind(settings);
+
+  for (int i = 0; i < MaxCameras; i++) {
+    camera_seen[i] = false;
+  }
+
+  // a random id per run, as required by the tracker protocol
+  uuid = QUuid::createUuid().toString().mid(1, 36).toStdString();
+  packet.set_uuid(uuid);
+  packet.mutable_tracked_frame()->add_capabilities(CAPABILITY_DETECT_MULTIPLE_BALLS);
+}
+
+DetectionTracker::~DetectionTracker() {
+  delete v_min_hits;
+  delete v_min_ball_conf;
+  delete v_timeout;
+  delete v_gate;
+  delete v_r_angle;
+  delete v_r_pos;
+  delete v_q_angle;
+  delete v_q_robot;
+  delete v_q_ball;
+  delete filter;
+  delete v_source_name;
+  delete v_interface;
+  delete v_port;
+  delete v_address;
+  delete v_enable;
+  delete settings;
+}
+
+void DetectionTracker::readValues(Values& v) {
+  v.enable = v_enable->getBool();
+  v.q_ball = v_q_ball->getDouble();
+  v.q_robot = v_q_robot->getDouble();
+  v.q_angle = v_q_angle->getDouble();
+  v.r_pos = v_r_pos->getDouble() * v_r_pos->getDouble();
+  v.r_angle = v_r_angle->getDouble() * v_r_angle->getDouble();
+  v.gate = v_gate->getDouble();
+  v.timeout = v_timeout->getDouble();
+  v.min_ball_conf = v_min_ball_conf->getDouble();
+  v.min_hits = v_min_hits->getInt();
+  packet.set_source_name(v_source_name->getString());
+}
+
+void DetectionTracker::updateRobot(Track& track, const SSL_DetectionRobot& robot, double t) {
+  const Values& v = values.get();
+  double orientation = robot.has_orientation() ? robot.orientation() : 0.0;
+  if (!track.active || t - track.t_seen > v.timeout) {
+    track.active = true;
+    track.hits = 0;
+    track.t = t;
+    track.t_seen = t;
+    track.ax.reset(robot.x(), v.r_pos, kInitialVelocityVar);
+    track.ay.reset(robot.y(), v.r_pos, kInitialVelocityVar);
+    track.aa.reset(orientation, v.r_angle, kInitialAngularVelocityVar);
+  } else {
+    track.predict(t, v.q_robot, v.q_angle);
+    track.ax.update(robot.x(), v.r_pos);
+    track.ay.update(robot.y(), v.r_pos);
+    if (robot.has_orientation()) {
+      track.aa.updateInnovation(wrapAngle(orientation - track.aa.x), v.r_angle);
+      track.aa.x = wrapAngle(track.aa.x);
+    }
+  }
+  track.hits++;
+  track.t_seen = std::max(track.t_seen, t);
+}
+
+void DetectionTracker::updateBall(const SSL_DetectionBall& ball, double t) {
+  const Values& v = values.get();
+  if (ball.confidence() < v.min_ball_conf) return;
+
+  // nearest live track within the gate, or the slot that was seen the longest time ago
+  Track* best = nullptr;
+  double best_dist_sq = v.gate * v.gate;
+  Track* oldest = &balls[0];
+  for (int i = 0; i < MaxBalls; i++) {
+    Track& track = balls[i];
+    if (!track.active || t - track.t_seen > v.timeout) {
+      if (oldest->active) oldest = &track;
+      continue;
+    }
+    double dt = std::max(0.0, t - track.t);
+    double dx = track.ax.x + track.ax.v * dt - ball.x();
+    double dy = track.ay.x + track.ay.v * dt - ball.y();
+    double dist_sq = dx * dx + dy * dy;
+    if (dist_sq < best_dist_sq) {
+      best_dist_sq = dist_sq;
+      best = &track;
+    }
+    if (oldest->active && track.t_seen < oldest->t_seen) oldest = &track;
+  }
+
+  if (best == nullptr) {
+    best = oldest;
+    best->active = true;
+    best->hits = 0;
+    best->t = t;
+    best->t_seen = t;
+    best->ax.reset(ball.x(), v.r_pos, kInitialVelocityVar);
+    best->ay.reset(ball.y(), v.r_pos, kInitialVelocityVar);
+    best->aa.reset(0.0, 0.0, 0.0);
+  } else {
+    best->predict(t, v.q_ball, 0.0);
+    best->ax.update(ball.x(), v.r_pos);
+    best->ay.update(ball.y(), v.r_pos);
+  }
+  best->hits++;
+  best->t_seen = std::max(best->t_seen, t);
+}
+
+void DetectionTracker::addFrame(const SSL_DetectionFrame& frame) {
+  std::lock_guard<std::mutex> lock(mutex);
+  values.update();
+  if (!values->enable) return;
+
+  int camera = frame.camera_id();
+  if (camera >= 0 && camera < MaxCameras) {
+    // a camera delivering its next frame closes the current period
+    if (camera_seen[camera]) {
+      publish();
+      for (int i = 0; i < MaxCameras; i++) {
+        camera_seen[i] = false;
+      }
+    }
+    camera_seen[camera] = true;
+  }
+
+  double t = frame.t_capture();
+  t_latest = std::max(t_latest, t);
+  for (int team = 0; team < 2; team++) {
+    const ::google::protobuf::RepeatedPtrField<SSL_DetectionRobot>& detections =
+        (team == 0) ? frame.robots_blue() : frame.robots_yellow();
+    for (int i = 0; i < detections.size(); i++) {
+      const SSL_DetectionRobot& robot = detections.Get(i);
+      if (!robot.has_robot_id() || robot.robot_id() >= (unsigned int) MaxRobotsPerTeam) continue;
+      updateRobot(robots[team][robot.robot_id()], robot, t);
+    }
+  }
+  for (int i = 0; i < frame.balls_size(); i++) {
+    updateBall(frame.balls(i), t);
+  }
+}
+
+void DetectionTracker::setRobot(TrackedRobot* out, const Track& track, int id, TeamColor color, double t) {
+  const Values& v = values.get();
+  double dt = std::max(0.0, t - track.t);
+  out->mutable_robot_id()->set_id(id);
+  out->mutable_robot_id()->set_team_color(color);
+  out->mutable_pos()->set_x((track.ax.x + track.ax.v * dt) * kMillimetersToMeters);
+  out->mutable_pos()->set_y((track.ay.x + track.ay.v * dt) * kMillimetersToMeters);
+  out->set_orientation(wrapAngle(track.aa.x + track.aa.v * dt));
+  out->mutable_vel()->set_x(track.ax.v * kMillimetersToMeters);
+  out->mutable_vel()->set_y(track.ay.v * kMillimetersToMeters);
+  out->set_vel_angular(track.aa.v);
+  out->set_visibility(std::max(0.0, 1.0 - (t - track.t_seen) / v.timeout));
+}
+
+void DetectionTracker::publish() {
+  const Values& v = values.get();
+  double t = t_latest;
+
+  // Clear() keeps the allocated repeated elements, so the add_*() below reuse them
+  TrackedFrame* tracked = packet.mutable_tracked_frame();
+  tracked->clear_balls();
+  tracked->clear_robots();
+  tracked->set_frame_number(frame_number++);
+  tracked->set_timestamp(t);
+
+  for (int team = 0; team < 2; team++) {
+    for (int i = 0; i < MaxRobotsPerTeam; i++) {
+      Track& track = robots[team][i];
+      if (!track.active) continue;
+      if (t - track.t_seen > v.timeout) {
+        track.active = false;
+        continue;
+      }
+      setRobot(tracked->add_robots(), track, i, team == 0 ? TEAM_COLOR_BLUE : TEAM_COLOR_YELLOW, t);
+    }
+  }
+
+  // the first ball is the primary one: the track with the most detections
+  int order[MaxBalls];
+  int n = 0;
+  for (int i = 0; i < MaxBalls; i++) {
+    Track& track = balls[i];
+    if (!track.active) continue;
+    if (t - track.t_seen > v.timeout) {
+      track.active = false;
+      continue;
+    }
+    if (track.hits < v.min_hits) continue;
+    order[n++] = i;
+    if (balls[order[n - 1]].hits > balls[order[0]].hits) std::swap(order[0], order[n - 1]);
+  }
+  for (int i = 0; i < n; i++) {
+    const Track& track = balls[order[i]];
+    double dt = std::max(0.0, t - track.t);
+    TrackedBall* ball = tracked->add_balls();
+    ball->mutable_pos()->set_x((track.ax.x + track.ax.v * dt) * kMillimetersToMeters);
+    ball->mutable_pos()->set_y((track.ay.x + track.ay.v * dt) * kMillimetersToMeters);
+    ball->mutable_pos()->set_z(0.0);
+    ball->mutable_vel()->set_x(track.ax.v * kMillimetersToMeters);
+    ball->mutable_vel()->set_y(track.ay.v * kMillimetersToMeters);
+    ball->mutable_vel()->set_z(0.0);
+    ball->set_visibility(std::max(0.0, 1.0 - (t - track.t_seen) / v.timeout));
+  }
+
+  server->send(packet, buffer);
+}
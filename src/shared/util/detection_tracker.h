@@ -0,0 +1,147 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    detection_tracker.h
+  \brief   C++ Interface: DetectionTracker
+*/
+//========================================================================
+#ifndef DETECTION_TRACKER_H
+#define DETECTION_TRACKER_H
+
+#include <VarTypes.h>
+#include <VarBinding.h>
+
+#include <mutex>
+#include <string>
+
+#include "messages_robocup_ssl_detection.pb.h"
+#include "messages_robocup_ssl_wrapper_tracked.pb.h"
+#include "robocup_ssl_server.h"
+
+using namespace VarTypes;
+
+/*!
+  \class DetectionTracker
+  \brief Tracks balls and robots over the detections of all cameras
+
+  Every camera stack passes its detection frame to addFrame(). The
+  detections update a fixed set of constant-velocity Kalman filters at the
+  frame's t_capture, so frames of overlapping cameras are merged
+  naturally. Robots are associated by team and id, balls by distance.
+
+  Once per camera period, that is when a camera delivers its next frame,
+  the current state is published as TrackerWrapperPacket. All storage,
+  including the packet and its serialization buffer, is reused, so there
+  are no allocations per frame once the tracker has warmed up.
+**/
+class DetectionTracker {
+ public:
+  static const int MaxRobotsPerTeam = 16;
+  static const int MaxBalls = 8;
+  static const int MaxCameras = 32;
+
+  explicit DetectionTracker(RoboCupSSLServer* server);
+  ~DetectionTracker();
+
+  VarList* getSettings() { return settings; }
+  VarInt* getPort() { return v_port; }
+  VarString* getAddress() { return v_address; }
+  VarString* getInterface() { return v_interface; }
+
+  /// merge the detections of one camera, may be called from any camera thread
+  void addFrame(const SSL_DetectionFrame& frame);
+
+ protected:
+  /// one axis of a constant-velocity model with white acceleration noise
+  class Axis {
+   public:
+    double x;
+    double v;
+    double p00;
+    double p01;
+    double p11;
+
+    void reset(double z, double r, double v_var);
+    void predict(double dt, double q);
+    void update(double z, double r);
+    /// innovation z - x, for angles wrapped to [-pi,pi)
+    void updateInnovation(double y, double r);
+  };
+
+  class Track {
+   public:
+    bool active;
+    int hits;
+    double t;  // time of the state
+    double t_seen;  // last measurement
+    Axis ax;
+    Axis ay;
+    Axis aa;  // orientation, robots only
+
+    Track();
+    void predict(double t_new, double q_pos, double q_angle);
+  };
+
+  struct Values {
+    bool enable;
+    double q_ball;
+    double q_robot;
+    double q_angle;
+    double r_pos;
+    double r_angle;
+    double gate;
+    double timeout;
+    double min_ball_conf;
+    int min_hits;
+  };
+
+  VarList* settings;
+  VarBool* v_enable;
+  VarInt* v_port;
+  VarString* v_address;
+  VarString* v_interface;
+  VarString* v_source_name;
+  VarList* filter;
+  VarDouble* v_q_ball;
+  VarDouble* v_q_robot;
+  VarDouble* v_q_angle;
+  VarDouble* v_r_pos;
+  VarDouble* v_r_angle;
+  VarDouble* v_gate;
+  VarDouble* v_timeout;
+  VarDouble* v_min_ball_conf;
+  VarInt* v_min_hits;
+  VarBinding<Values> values;
+
+  std::mutex mutex;
+  RoboCupSSLServer* server;
+  Track robots[2][MaxRobotsPerTeam];  // blue, yellow
+  Track balls[MaxBalls];
+  bool camera_seen[MaxCameras];
+  double t_latest;
+  unsigned int frame_number;
+
+  TrackerWrapperPacket packet;
+  std::string buffer;
+  std::string uuid;
+
+  void readValues(Values& v);
+  void updateRobot(Track& track, const SSL_DetectionRobot& robot, double t);
+  void updateBall(const SSL_DetectionBall& ball, double t);
+  void publish();
+  void setRobot(TrackedRobot* out, const Track& track, int id, TeamColor color, double t);
+};
+
+#endif
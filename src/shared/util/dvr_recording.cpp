@@ -0,0 +1,537 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    dvr_recording.cpp
+  \brief   C++ Implementation: DVRRecording, DVRRecorder, DVRReader
+*/
+//========================================================================
+#include "dvr_recording.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+const char DVRRecording::Magic[8] = {'S','S','L','D','V','R','\0','\1'};
+const char * DVRRecording::IndexSuffix = ".idx";
+
+// the file is extended by at least this much at a time
+static const uint64_t kPreallocateChunk = 256ull << 20;
+
+DVRRecorder::DVRRecorder(int pool_size_mb, int slab_size_mb, int num_threads) :
+    fd(-1),
+    index_fd(-1),
+    current(nullptr),
+    file_offset(0),
+    allocated(0),
+    index_count(0),
+    running(true),
+    frames_written(0),
+    frames_dropped(0),
+    bytes_written(0) {
+  slab_size = (size_t) std::max(1, slab_size_mb) << 20;
+  int num_slabs = std::max(2, pool_size_mb / std::max(1, slab_size_mb));
+  slabs = std::vector<Slab>(num_slabs);
+  for (Slab & slab : slabs) {
+    slab.data.resize(slab_size);
+    slab.used = 0;
+    slab.offset = 0;
+    slab.index_first = 0;
+    // touch every page now instead of on the camera thread
+    memset(slab.data.data(), 0, slab.data.size());
+    free_slabs.push_back(&slab);
+  }
+  for (int i = 0; i < std::max(1, num_threads); i++) {
+    writers.push_back(std::thread(&DVRRecorder::runWriter, this));
+  }
+}
+
+DVRRecorder::~DVRRecorder() {
+  close();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+  }
+  full_condition.notify_all();
+  for (std::thread & writer : writers) {
+    writer.join();
+  }
+}
+
+bool DVRRecorder::open(const std::string & _filename) {
+  close();
+  filename = _filename;
+  fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    perror("open");
+    fprintf(stderr, "Unable to create DVR recording '%s'\n", filename.c_str());
+    return false;
+  }
+  std::string index_filename = filename + DVRRecording::IndexSuffix;
+  index_fd = ::open(index_filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (index_fd < 0) {
+    perror("open");
+    fprintf(stderr, "Unable to create DVR index '%s'\n", index_filename.c_str());
+    ::close(fd);
+    fd = -1;
+    return false;
+  }
+
+  DVRRecording::FileHeader header;
+  memcpy(header.magic, DVRRecording::Magic, sizeof(header.magic));
+  header.version = DVRRecording::Version;
+  header.header_size = sizeof(header);
+  if (!writeAll(fd, (const char *) &header, sizeof(header), 0)) {
+    ::close(index_fd);
+    ::close(fd);
+    index_fd = -1;
+    fd = -1;
+    return false;
+  }
+  file_offset = sizeof(header);
+  allocated = 0;
+  index_count = 0;
+  frames_written = 0;
+  frames_dropped = 0;
+  bytes_written = 0;
+  return true;
+}
+
+void DVRRecorder::close() {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (fd < 0) return;
+  if (current != nullptr) {
+    if (current->used > 0) {
+      seal(current);
+    } else {
+      free_slabs.push_back(current);
+    }
+    current = nullptr;
+  }
+  free_condition.wait(lock, [this] { return free_slabs.size() == slabs.size(); });
+
+  // release the preallocated space behind the last record
+  if (ftruncate(fd, file_offset) != 0) {
+    perror("ftruncate");
+  }
+  ::close(index_fd);
+  ::close(fd);
+  index_fd = -1;
+  fd = -1;
+}
+
+DVRRecorder::Slab * DVRRecorder::takeFreeSlab() {
+  if (free_slabs.empty()) return nullptr;
+  Slab * slab = free_slabs.back();
+  free_slabs.pop_back();
+  slab->used = 0;
+  slab->index.clear();
+  return slab;
+}
+
+bool DVRRecorder::write(const RawImage & image, long long frame_number, double time, double time_cam,
+                        const SSL_DetectionFrame * detection) {
+  size_t image_size = image.getNumBytes() > 0 ? image.getNumBytes() : 0;
+  size_t detection_size = detection != nullptr ? detection->ByteSizeLong() : 0;
+  size_t record_size = DVRRecording::getRecordSize(image_size, detection_size);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (fd < 0) return false;
+  if (current != nullptr && current->used + record_size > current->data.size()) {
+    seal(current);
+    current = nullptr;
+  }
+  if (current == nullptr) {
+    current = takeFreeSlab();
+    if (current == nullptr) {
+      frames_dropped++;
+      return false;
+    }
+    if (record_size > current->data.size()) {
+      // a frame larger than a slab, only happens once per slab
+      current->data.resize(record_size);
+    }
+  }
+
+  char * record = current->data.data() + current->used;
+  DVRRecording::RecordHeader header;
+  header.magic = DVRRecording::RecordMagic;
+  header.record_size = (uint32_t) record_size;
+  header.frame_number = frame_number;
+  header.time = time;
+  header.time_cam = time_cam;
+  header.width = image.getWidth();
+  header.height = image.getHeight();
+  header.color_format = (int32_t) image.getColorFormat();
+  header.image_size = (uint32_t) image_size;
+  header.detection_size = (uint32_t) detection_size;
+  header.reserved = 0;
+  memcpy(record, &header, sizeof(header));
+  char * payload = record + sizeof(header);
+  if (image_size > 0) {
+    memcpy(payload, image.getData(), image_size);
+  }
+  if (detection_size > 0) {
+    detection->SerializeWithCachedSizesToArray((uint8_t *) payload + image_size);
+  }
+  size_t padding = record_size - sizeof(header) - image_size - detection_size;
+  memset(payload + image_size + detection_size, 0, padding);
+
+  DVRRecording::IndexEntry entry;
+  entry.offset = current->used;
+  entry.frame_number = frame_number;
+  entry.time = time;
+  current->index.push_back(entry);
+  current->used += record_size;
+  return true;
+}
+
+void DVRRecorder::seal(Slab * slab) {
+  slab->offset = file_offset;
+  slab->index_first = index_count;
+  for (DVRRecording::IndexEntry & entry : slab->index) {
+    entry.offset += slab->offset;
+  }
+  file_offset += slab->used;
+  index_count += slab->index.size();
+
+  full_slabs.push_back(slab);
+  full_condition.notify_one();
+}
+
+bool DVRRecorder::writeAll(int _fd, const char * data, size_t length, uint64_t offset) {
+  while (length > 0) {
+    ssize_t result = pwrite(_fd, data, length, offset);
+    if (result < 0) {
+      if (errno == EINTR) continue;
+      perror("pwrite");
+      fprintf(stderr, "Writing DVR recording '%s' failed\n", filename.c_str());
+      return false;
+    }
+    data += result;
+    length -= result;
+    offset += result;
+  }
+  return true;
+}
+
+void DVRRecorder::runWriter() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    full_condition.wait(lock, [this] { return !full_slabs.empty() || !running; });
+    if (full_slabs.empty()) return;
+    Slab * slab = full_slabs.front();
+    full_slabs.pop_front();
+
+    // stay a chunk ahead of the writers, fallocate() can take long enough to stall a camera thread
+    uint64_t allocate_offset = 0;
+    uint64_t allocate_length = 0;
+    if (slab->offset + slab->used + kPreallocateChunk / 2 > allocated) {
+      allocate_offset = allocated;
+      allocate_length = std::max(kPreallocateChunk, slab->offset + slab->used - allocated + kPreallocateChunk);
+      allocated += allocate_length;
+    }
+    lock.unlock();
+
+#ifdef __linux__
+    // keep the size, so that the file always ends behind the last record written
+    if (allocate_length > 0 && fallocate(fd, FALLOC_FL_KEEP_SIZE, allocate_offset, allocate_length) != 0 &&
+        errno != EOPNOTSUPP) {
+      perror("fallocate");
+    }
+#endif
+
+    // slabs and their index entries have disjoint file ranges, so writers do not need to take turns
+    if (writeAll(fd, slab->data.data(), slab->used, slab->offset)) {
+      writeAll(index_fd, (const char *) slab->index.data(), slab->index.size() * sizeof(DVRRecording::IndexEntry),
+               slab->index_first * sizeof(DVRRecording::IndexEntry));
+      frames_written += slab->index.size();
+      bytes_written += slab->used;
+    }
+
+    lock.lock();
+    free_slabs.push_back(slab);
+    free_condition.notify_all();
+  }
+}
+
+//========================================================================
+
+DVRReader::DVRReader(int read_ahead) :
+    fd(-1),
+    miss_loading(false),
+    position(0),
+    running(true) {
+  slots = std::vector<Slot>(std::max(1, read_ahead));
+  for (Slot & slot : slots) {
+    slot.record = -1;
+    slot.ready = false;
+    slot.loading = false;
+  }
+  frame.index = -1;
+  frame.image = nullptr;
+  thread = std::thread(&DVRReader::runReadAhead, this);
+}
+
+DVRReader::~DVRReader() {
+  close();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    running = false;
+  }
+  condition.notify_all();
+  thread.join();
+}
+
+bool DVRReader::open(const std::string & _filename) {
+  close();
+  int new_fd = ::open(_filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (new_fd < 0) {
+    perror("open");
+    fprintf(stderr, "Unable to open DVR recording '%s'\n", _filename.c_str());
+    return false;
+  }
+  struct stat st;
+  DVRRecording::FileHeader header;
+  if (fstat(new_fd, &st) != 0 || pread(new_fd, &header, sizeof(header), 0) != (ssize_t) sizeof(header) ||
+      memcmp(header.magic, DVRRecording::Magic, sizeof(header.magic)) != 0 ||
+      header.version != DVRRecording::Version || header.header_size < sizeof(header)) {
+    fprintf(stderr, "'%s' is not a DVR recording\n", _filename.c_str());
+    ::close(new_fd);
+    return false;
+  }
+#ifdef __linux__
+  posix_fadvise(new_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+  std::lock_guard<std::mutex> lock(mutex);
+  fd = new_fd;
+  filename = _filename;
+  records.clear();
+  if (!loadIndex(st.st_size)) {
+    fprintf(stderr, "DVR index of '%s' is missing, scanning the recording\n", filename.c_str());
+    records.clear();
+    scanRecords(st.st_size);
+  }
+  position = 0;
+  frame.index = -1;
+  condition.notify_all();
+  return true;
+}
+
+void DVRReader::close() {
+  std::unique_lock<std::mutex> lock(mutex);
+  // neither the read-ahead thread nor a cache miss must read from a closed file
+  condition.wait(lock, [this] {
+    if (miss_loading) return false;
+    for (const Slot & slot : slots) {
+      if (slot.loading) return false;
+    }
+    return true;
+  });
+  if (fd >= 0) ::close(fd);
+  fd = -1;
+  records.clear();
+  for (Slot & slot : slots) {
+    slot.record = -1;
+    slot.ready = false;
+  }
+  frame.index = -1;
+  frame.image = nullptr;
+}
+
+bool DVRReader::loadIndex(uint64_t file_size) {
+  int index_fd = ::open((filename + DVRRecording::IndexSuffix).c_str(), O_RDONLY | O_CLOEXEC);
+  if (index_fd < 0) return false;
+  struct stat st;
+  if (fstat(index_fd, &st) != 0) {
+    ::close(index_fd);
+    return false;
+  }
+  std::vector<DVRRecording::IndexEntry> index(st.st_size / sizeof(DVRRecording::IndexEntry));
+  size_t length = index.size() * sizeof(DVRRecording::IndexEntry);
+  bool ok = length == 0 || pread(index_fd, index.data(), length, 0) == (ssize_t) length;
+  ::close(index_fd);
+  if (!ok || index.empty()) return false;
+
+  for (const DVRRecording::IndexEntry & entry : index) {
+    // slabs that were never written leave zero entries behind
+    if (entry.offset == 0 || entry.offset + sizeof(DVRRecording::RecordHeader) > file_size) continue;
+    if (!records.empty() && entry.offset <= records.back().offset) return false;
+    Record record;
+    record.offset = entry.offset;
+    record.size = 0;
+    record.time = entry.time;
+    records.push_back(record);
+  }
+  // records are back to back, except where slabs are missing
+  for (size_t i = 0; i < records.size(); i++) {
+    uint64_t end = i + 1 < records.size() ? records[i + 1].offset : file_size;
+    records[i].size = (uint32_t) std::min<uint64_t>(end - records[i].offset, UINT32_MAX);
+  }
+  return !records.empty();
+}
+
+bool DVRReader::scanRecords(uint64_t file_size) {
+  uint64_t offset = sizeof(DVRRecording::FileHeader);
+  DVRRecording::RecordHeader header;
+  while (offset + sizeof(header) <= file_size) {
+    if (pread(fd, &header, sizeof(header), offset) != (ssize_t) sizeof(header) ||
+        header.magic != DVRRecording::RecordMagic || header.record_size < sizeof(header) ||
+        offset + header.record_size > file_size) {
+      break;
+    }
+    Record record;
+    record.offset = offset;
+    record.size = header.record_size;
+    record.time = header.time;
+    records.push_back(record);
+    offset += header.record_size;
+  }
+  return !records.empty();
+}
+
+int DVRReader::findFrame(double time) const {
+  // recording times only increase, so the index is sorted
+  auto it = std::upper_bound(records.begin(), records.end(), time,
+                             [](double t, const Record & record) { return t < record.time; });
+  return it == records.begin() ? 0 : (int) (it - records.begin()) - 1;
+}
+
+bool DVRReader::readRecord(const Record & record, int file, std::vector<char> & buffer) {
+  if (buffer.size() < record.size) buffer.resize(record.size);
+  char * data = buffer.data();
+  size_t length = record.size;
+  uint64_t offset = record.offset;
+  while (length > 0) {
+    ssize_t result = pread(file, data, length, offset);
+    if (result < 0 && errno == EINTR) continue;
+    if (result <= 0) {
+      if (result < 0) perror("pread");
+      return false;
+    }
+    data += result;
+    length -= result;
+    offset += result;
+  }
+  return true;
+}
+
+bool DVRReader::parseRecord(int i, std::vector<char> & buffer) {
+  DVRRecording::RecordHeader header;
+  memcpy(&header, buffer.data(), sizeof(header));
+  if (header.magic != DVRRecording::RecordMagic || header.record_size > records[i].size ||
+      sizeof(header) + (uint64_t) header.image_size + header.detection_size > header.record_size) {
+    fprintf(stderr, "DVR recording '%s' has a corrupt record at offset %llu\n", filename.c_str(),
+            (unsigned long long) records[i].offset);
+    return false;
+  }
+  char * payload = buffer.data() + sizeof(header);
+  frame.index = i;
+  frame.number = header.frame_number;
+  frame.time = header.time;
+  frame.time_cam = header.time_cam;
+  frame.width = header.width;
+  frame.height = header.height;
+  frame.format = (ColorFormat) header.color_format;
+  frame.image = (const unsigned char *) payload;
+  frame.image_size = header.image_size;
+  frame.has_detection = header.detection_size > 0 &&
+                        frame.detection.ParseFromArray(payload + header.image_size, header.detection_size);
+  return true;
+}
+
+bool DVRReader::Frame::copyImageTo(RawImage & target) const {
+  if (image == nullptr || width <= 0 || height <= 0 ||
+      (size_t) RawImage::computeImageSize(format, width * height) != image_size) {
+    return false;
+  }
+  target.ensure_allocation(format, width, height);
+  memcpy(target.getData(), image, image_size);
+  return true;
+}
+
+const DVRReader::Frame * DVRReader::getFrame(int i) {
+  std::unique_lock<std::mutex> lock(mutex);
+  if (fd < 0 || i < 0 || i >= (int) records.size()) return nullptr;
+  position = i;
+  condition.notify_all();
+  for (Slot & slot : slots) {
+    // slots at the play position are not reused until the position moves on
+    if (slot.record == i && slot.ready) {
+      return parseRecord(i, slot.data) ? &frame : nullptr;
+    }
+  }
+  Record record = records[i];
+  int file = fd;
+  miss_loading = true;
+  lock.unlock();
+  bool ok = readRecord(record, file, miss_buffer);
+  lock.lock();
+  miss_loading = false;
+  condition.notify_all();
+  return ok && parseRecord(i, miss_buffer) ? &frame : nullptr;
+}
+
+bool DVRReader::findWork(int & record, Slot *& slot) {
+  if (fd < 0) return false;
+  int end = std::min(position + (int) slots.size(), (int) records.size());
+  record = -1;
+  for (int i = position; i < end && record < 0; i++) {
+    record = i;
+    for (const Slot & s : slots) {
+      if (s.record == i) {
+        record = -1;
+        break;
+      }
+    }
+  }
+  if (record < 0) return false;
+  for (Slot & s : slots) {
+    if (!s.loading && (s.record < position || s.record >= end)) {
+      slot = &s;
+      return true;
+    }
+  }
+  return false;
+}
+
+void DVRReader::runReadAhead() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    int record = -1;
+    Slot * slot = nullptr;
+    condition.wait(lock, [&] { return !running || findWork(record, slot); });
+    if (!running) return;
+    slot->record = record;
+    slot->ready = false;
+    slot->loading = true;
+    Record copy = records[record];
+    int file = fd;
+    lock.unlock();
+
+    bool ok = readRecord(copy, file, slot->data);
+
+    lock.lock();
+    slot->loading = false;
+    // a failed record keeps its slot, so that it is not retried until the position moves past it
+    slot->ready = ok;
+    condition.notify_all();
+  }
+}
@@ -0,0 +1,269 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    dvr_recording.h
+  \brief   C++ Interface: DVRRecording, DVRRecorder, DVRReader
+*/
+//========================================================================
+#ifndef DVR_RECORDING_H
+#define DVR_RECORDING_H
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rawimage.h"
+#include "messages_robocup_ssl_detection.pb.h"
+
+/*!
+  \class DVRRecording
+  \brief File layout of a continuous DVR recording
+
+  A recording file starts with a FileHeader, followed by one record per
+  frame. A record is a RecordHeader, the raw image in its native color
+  format, and the binary SSL_DetectionFrame of the frame, if any. Records
+  are padded to a multiple of 8 bytes.
+
+  The seek index lives next to the recording, in a file with the suffix
+  ".idx". It is an array of IndexEntry, one per record, in recording
+  order. Entries with a zero offset were not written, e.g. after a crash.
+**/
+class DVRRecording {
+public:
+  static const char Magic[8];
+  static const uint32_t Version = 1;
+  static const uint32_t RecordMagic = 0x4d415246;  // "FRAM"
+  static const char * IndexSuffix;
+
+  class FileHeader {
+  public:
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+  };
+
+  class RecordHeader {
+  public:
+    uint32_t magic;
+    uint32_t record_size;  // including this header and the padding
+    int64_t frame_number;
+    double time;
+    double time_cam;
+    int32_t width;
+    int32_t height;
+    int32_t color_format;
+    uint32_t image_size;
+    uint32_t detection_size;
+    uint32_t reserved;
+  };
+
+  class IndexEntry {
+  public:
+    uint64_t offset;
+    int64_t frame_number;
+    double time;
+  };
+
+  static size_t getRecordSize(size_t image_size, size_t detection_size) {
+    return (sizeof(RecordHeader) + image_size + detection_size + 7) & ~((size_t) 7);
+  }
+};
+
+/*!
+  \class DVRRecorder
+  \brief Writes a continuous DVR recording at full frame rate
+
+  write() copies the frame into a slab of a preallocated buffer pool and
+  returns right away. Full slabs get their final file offset and are
+  written by a set of writer threads with one large pwrite() each, so
+  several slabs can be in flight at once. The writers also extend the
+  file in large preallocated chunks ahead of the data.
+
+  A frame that finds no free slab is dropped and counted, the camera
+  thread never waits for the disk.
+**/
+class DVRRecorder {
+public:
+  DVRRecorder(int pool_size_mb, int slab_size_mb, int num_threads);
+  ~DVRRecorder();
+
+  bool open(const std::string & filename);
+  /// writes the remaining frames and closes the files
+  void close();
+  bool isOpen() const {
+    return fd >= 0;
+  }
+  const std::string & getFileName() const {
+    return filename;
+  }
+
+  /// returns false if the frame was dropped
+  bool write(const RawImage & image, long long frame_number, double time, double time_cam,
+             const SSL_DetectionFrame * detection);
+
+  uint64_t getFramesWritten() const {
+    return frames_written;
+  }
+  uint64_t getFramesDropped() const {
+    return frames_dropped;
+  }
+  uint64_t getBytesWritten() const {
+    return bytes_written;
+  }
+
+protected:
+  class Slab {
+  public:
+    std::vector<char> data;
+    size_t used;
+    uint64_t offset;  // file offset, assigned when the slab is full
+    uint64_t index_first;
+    std::vector<DVRRecording::IndexEntry> index;  // offsets relative to the slab until then
+  };
+
+  std::string filename;
+  int fd;
+  int index_fd;
+  size_t slab_size;
+
+  std::vector<Slab> slabs;
+  std::vector<Slab *> free_slabs;
+  std::deque<Slab *> full_slabs;
+  Slab * current;
+  uint64_t file_offset;  // where the next full slab goes
+  uint64_t allocated;  // preallocated file size, or requested to be
+  uint64_t index_count;
+
+  std::mutex mutex;
+  std::condition_variable full_condition;
+  std::condition_variable free_condition;
+  bool running;
+  std::vector<std::thread> writers;
+
+  std::atomic<uint64_t> frames_written;
+  std::atomic<uint64_t> frames_dropped;
+  std::atomic<uint64_t> bytes_written;
+
+  Slab * takeFreeSlab();
+  void seal(Slab * slab);
+  void runWriter();
+  bool writeAll(int fd, const char * data, size_t length, uint64_t offset);
+};
+
+/*!
+  \class DVRReader
+  \brief Plays a continuous DVR recording directly from disk
+
+  open() only loads the seek index, so any frame can be reached with a
+  single read, no matter how long the recording is. If the index is
+  missing, e.g. after a crash, it is rebuilt by walking the record
+  headers once.
+
+  getFrame() moves the play position. A background thread keeps the
+  frames behind the play position in a small cache, so that playback
+  does not wait for the disk. A frame that is not cached yet, e.g. right
+  after a jump, is read on the calling thread.
+**/
+class DVRReader {
+public:
+  class Frame {
+  public:
+    int index;
+    long long number;
+    double time;
+    double time_cam;
+    int width;
+    int height;
+    ColorFormat format;
+    const unsigned char * image;  // points into the reader
+    size_t image_size;
+    bool has_detection;
+    SSL_DetectionFrame detection;
+
+    /// false if the image size does not match its format
+    bool copyImageTo(RawImage & target) const;
+  };
+
+  explicit DVRReader(int read_ahead);
+  ~DVRReader();
+
+  bool open(const std::string & filename);
+  void close();
+  bool isOpen() const {
+    return fd >= 0;
+  }
+  const std::string & getFileName() const {
+    return filename;
+  }
+
+  int getFrameCount() const {
+    return (int) records.size();
+  }
+  double getFrameTime(int i) const {
+    return records[i].time;
+  }
+  /// the last frame recorded at or before the given time, 0 if there is none
+  int findFrame(double time) const;
+
+  /// reads frame i, the result stays valid until the next call
+  const Frame * getFrame(int i);
+
+protected:
+  class Record {
+  public:
+    uint64_t offset;
+    uint32_t size;  // upper bound, the record header has the exact size
+    double time;
+  };
+
+  class Slot {
+  public:
+    std::vector<char> data;
+    int record;  // -1 if empty
+    bool ready;
+    bool loading;
+  };
+
+  std::string filename;
+  int fd;
+  std::vector<Record> records;
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  std::vector<Slot> slots;
+  std::vector<char> miss_buffer;
+  bool miss_loading;  // getFrame() reads a frame that was not cached
+  int position;
+  bool running;
+  std::thread thread;
+
+  Frame frame;
+
+  bool loadIndex(uint64_t file_size);
+  bool scanRecords(uint64_t file_size);
+  /// reads without the lock, from a copy of the record taken under it
+  bool readRecord(const Record & record, int file, std::vector<char> & buffer);
+  bool parseRecord(int i, std::vector<char> & buffer);
+  /// next record to read ahead and the slot to read it into, false if there is nothing to do
+  bool findWork(int & record, Slot *& slot);
+  void runReadAhead();
+};
+
+#endif
@@ -0,0 +1,43 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    image_row_span.h
+  \brief   C++ Interface: ImageRowSpan
+*/
+//========================================================================
+#ifndef IMAGE_ROW_SPAN_H
+#define IMAGE_ROW_SPAN_H
+
+/*!
+  \class ImageRowSpan
+  \brief The columns [start, end) of one image row that lie inside a mask
+
+  A convex mask covers a single span per row, so an array with one span
+  per row describes the whole mask. An empty row has start == end.
+*/
+class ImageRowSpan {
+public:
+  int start;
+  int end;
+
+  ImageRowSpan() : start(0), end(0) {}
+  ImageRowSpan(int _start, int _end) : start(_start), end(_end) {}
+
+  int getLength() const {
+    return end > start ? end - start : 0;
+  }
+};
+
+#endif
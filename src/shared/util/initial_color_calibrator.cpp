@@ -25,6 +25,8 @@
 #include "camera_calibration.h"
 #include "lut3d.h"
 #include "initial_color_calibrator.h"
+#include <algorithm>
+#include <cmath>
 
 
 ColorClazz::ColorClazz(
@@ -40,66 +42,158 @@ ColorClazz::ColorClazz(
         maxAngle(maxAngle) {
 }
 
-float InitialColorCalibrator::ratedYuvColorDist(const yuv &c1, const ColorClazz &colorClazz) {
-  yuv c2 = colorClazz.color_yuv;
-  float midToC1U = c1.u - 127;
-  float midToC2U = c2.u - 127;
-  float midToC1V = c1.v - 127;
-  float midToC2V = c2.v - 127;
-  float normFac1 = std::sqrt(midToC1U * midToC1U + midToC1V * midToC1V);
-  float normFac2 = std::sqrt(midToC2U * midToC2U + midToC2V * midToC2V);
-  midToC1U *= 1 / normFac1;
-  midToC1V *= 1 / normFac1;
-  midToC2U *= 1 / normFac2;
-  midToC2V *= 1 / normFac2;
-  float scalar = midToC1U * midToC2U + midToC1V * midToC2V;
-  float angle = std::acos(scalar);
-  float relAngle = angle / colorClazz.maxAngle;
-  float dMaxHalf = colorClazz.maxDistance * 0.5f;
+InitialColorCalibrator::InitialColorCalibrator() :
+        job_pending(false),
+        job_lut(nullptr),
+        finished(false),
+        running(true) {
+  worker = std::thread(&InitialColorCalibrator::runWorker, this);
+}
 
-  float bonus;
-  if (relAngle < 1) {
-    // give bonus for good angles
-    bonus = (1 - relAngle) * dMaxHalf;
-  } else {
-    // give penalty for bad angles
-    bonus = -relAngle * dMaxHalf;
+InitialColorCalibrator::~InitialColorCalibrator() {
+  {
+    std::lock_guard<std::mutex> lock(worker_mutex);
+    running = false;
   }
+  worker_condition.notify_all();
+  worker.join();
+}
 
-  float y = c1.y - c2.y;
-  float u = c1.u - c2.u;
-  float v = c1.v - c2.v;
-
-  float yuvDist = y * y + u * u + v * v;
-  return (yuvDist - bonus) * colorClazz.weight;
+/// acos with an absolute error below 7e-5 rad (Abramowitz and Stegun 4.4.45),
+/// branch free so that the calling loops can be vectorized
+static inline float fastAcos(float x) {
+  x = std::min(1.0f, std::max(-1.0f, x));
+  float a = std::fabs(x);
+  float r = std::sqrt(1.0f - a) * (1.5707288f + a * (-0.2121144f + a * (0.0742610f - 0.0187293f * a)));
+  return x < 0 ? (float) M_PI - r : r;
 }
 
-void InitialColorCalibrator::process(const std::vector<ColorClazz> &calibration_points, YUVLUT *global_lut) {
-  global_lut->lock();
-  for (int y = 0; y <= 255; y += (0x1u << global_lut->X_SHIFT)) {
-    for (int u = 0; u <= 255; u += (0x1u << global_lut->Y_SHIFT)) {
-      for (int v = 0; v <= 255; v += (0x1u << global_lut->Z_SHIFT)) {
-        yuv color = yuv(static_cast<unsigned char>(y),
-                        static_cast<unsigned char>(u),
-                        static_cast<unsigned char>(v));
-        float minScore = 1e10;
-        int clazz = 0;
-        float maxDistance = 0;
-        for (auto &colorClazz : calibration_points) {
-          float score = ratedYuvColorDist(color, colorClazz);
-          if (score < minScore) {
-            minScore = score;
-            clazz = colorClazz.clazz;
-            maxDistance = colorClazz.maxDistance;
-          }
+void InitialColorCalibrator::processSlices(const std::vector<PreparedClazz> &clazzes, const YUVLUT *global_lut,
+                                           int y_begin, int y_end, std::vector<int> &labels) const {
+  int nu = global_lut->getSizeY();
+  int nv = global_lut->getSizeZ();
+  std::vector<float> v_mid(nv), inv_norm(nv), min_score(nv), max_distance(nv);
+  std::vector<int> best(nv);
+
+  for (int y = y_begin; y < y_end; y++) {
+    float y_norm = global_lut->lut2normX(y);
+    for (int u = 0; u < nu; u++) {
+      float u_norm = global_lut->lut2normY(u);
+      float u_mid = u_norm - 127;
+      for (int v = 0; v < nv; v++) {
+        v_mid[v] = global_lut->lut2normZ(v) - 127.0f;
+        float norm = std::sqrt(u_mid * u_mid + v_mid[v] * v_mid[v]);
+        inv_norm[v] = norm > 0 ? 1 / norm : 0;
+        min_score[v] = 1e10;
+        max_distance[v] = 0;
+        best[v] = 0;
+      }
+
+      for (const PreparedClazz &c : clazzes) {
+        float du = u_norm - c.u;
+        float dy = y_norm - c.y;
+        float dyu = dy * dy + du * du;
+        for (int v = 0; v < nv; v++) {
+          // the angle between both colors around the center of the UV plane
+          float scalar = (u_mid * c.dir_u + v_mid[v] * c.dir_v) * inv_norm[v];
+          float rel_angle = fastAcos(scalar) * c.inv_max_angle;
+          // give bonus for good angles, penalty for bad angles
+          float bonus = rel_angle < 1 ? (1 - rel_angle) * c.max_distance_half : -rel_angle * c.max_distance_half;
+          float dv = (v_mid[v] + 127.0f) - c.v;
+          float score = (dyu + dv * dv - bonus) * c.weight;
+          bool better = score < min_score[v];
+          min_score[v] = better ? score : min_score[v];
+          best[v] = better ? c.clazz : best[v];
+          max_distance[v] = better ? c.max_distance : max_distance[v];
         }
+      }
 
-        if (minScore < maxDistance) {
-          global_lut->set(color.y, color.u, color.v, static_cast<lut_mask_t>(clazz));
+      int row = (y << global_lut->Z_AND_Y_BITS) | (u << global_lut->Z_BITS);
+      for (int v = 0; v < nv; v++) {
+        // colors without a hue have no angle, these are never assigned
+        if (inv_norm[v] > 0 && min_score[v] < max_distance[v]) {
+          labels[row | v] = best[v];
         }
       }
     }
   }
+}
+
+void InitialColorCalibrator::process(const std::vector<ColorClazz> &calibration_points, YUVLUT *global_lut) {
+  std::vector<PreparedClazz> clazzes;
+  for (const ColorClazz &colorClazz : calibration_points) {
+    PreparedClazz c;
+    c.y = colorClazz.color_yuv.y;
+    c.u = colorClazz.color_yuv.u;
+    c.v = colorClazz.color_yuv.v;
+    float mid_u = c.u - 127;
+    float mid_v = c.v - 127;
+    float norm = std::sqrt(mid_u * mid_u + mid_v * mid_v);
+    if (norm == 0) {
+      // a sample without a hue has no angle and can never win
+      continue;
+    }
+    c.dir_u = mid_u / norm;
+    c.dir_v = mid_v / norm;
+    c.inv_max_angle = 1 / colorClazz.maxAngle;
+    c.max_distance_half = colorClazz.maxDistance * 0.5f;
+    c.weight = colorClazz.weight;
+    c.max_distance = colorClazz.maxDistance;
+    c.clazz = colorClazz.clazz;
+    clazzes.push_back(c);
+  }
+
+  // compute all labels without holding the LUT, -1 keeps the current value
+  std::vector<int> labels(global_lut->getCellCount(), -1);
+  int ny = global_lut->getSizeX();
+  int threads = std::max(1, std::min(ny, (int) std::thread::hardware_concurrency()));
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back(&InitialColorCalibrator::processSlices, this, std::cref(clazzes), global_lut,
+                         (ny * t) / threads, (ny * (t + 1)) / threads, std::ref(labels));
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+
+  global_lut->lock();
+  lut_mask_t *table = global_lut->getTable();
+  for (size_t i = 0; i < labels.size(); i++) {
+    if (labels[i] >= 0) {
+      table[i] = static_cast<lut_mask_t>(labels[i]);
+    }
+  }
   global_lut->unlock();
   global_lut->updateDerivedLUTs();
 }
+
+void InitialColorCalibrator::processAsync(const std::vector<ColorClazz> &calibration_points, YUVLUT *global_lut) {
+  {
+    std::lock_guard<std::mutex> lock(worker_mutex);
+    job_points = calibration_points;
+    job_lut = global_lut;
+    job_pending = true;
+  }
+  worker_condition.notify_one();
+}
+
+bool InitialColorCalibrator::takeFinished() {
+  return finished.exchange(false);
+}
+
+void InitialColorCalibrator::runWorker() {
+  while (true) {
+    std::vector<ColorClazz> points;
+    YUVLUT *lut;
+    {
+      std::unique_lock<std::mutex> lock(worker_mutex);
+      worker_condition.wait(lock, [this] { return !running || job_pending; });
+      if (!running) return;
+      points.swap(job_points);
+      lut = job_lut;
+      job_pending = false;
+    }
+    process(points, lut);
+    finished = true;
+  }
+}
@@ -22,6 +22,13 @@
 #define INITIAL_COLOR_CALIBRATOR_H
 
 #include "colors.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class YUVLUT;
 
 class ColorClazz {
 public:
@@ -42,14 +49,47 @@ public:
 class InitialColorCalibrator {
 
 public:
-    InitialColorCalibrator() = default;
+    InitialColorCalibrator();
 
-    ~InitialColorCalibrator() = default;
+    ~InitialColorCalibrator();
 
+    /// Calibrate the LUT from the given points and publish the result.
+    /// Runs in parallel over the Y slices of the LUT, blocks until done.
     void process(const std::vector<ColorClazz> &calibration_points, YUVLUT *global_lut);
 
+    /// Run process() on a background thread. If a calibration is still pending,
+    /// it is replaced by this one.
+    void processAsync(const std::vector<ColorClazz> &calibration_points, YUVLUT *global_lut);
+
+    /// Returns true once for every finished asynchronous calibration
+    bool takeFinished();
+
 private:
-    float ratedYuvColorDist(const yuv &c1, const ColorClazz &colorClazz);
+    /// per calibration point values, precomputed once per run
+    class PreparedClazz {
+    public:
+        float y, u, v;
+        float dir_u, dir_v;
+        float inv_max_angle;
+        float max_distance_half;
+        float weight;
+        float max_distance;
+        int clazz;
+    };
+
+    void processSlices(const std::vector<PreparedClazz> &clazzes, const YUVLUT *global_lut,
+                       int y_begin, int y_end, std::vector<int> &labels) const;
+
+    void runWorker();
+
+    std::mutex worker_mutex;
+    std::condition_variable worker_condition;
+    bool job_pending;
+    std::vector<ColorClazz> job_points;
+    YUVLUT *job_lut;
+    std::atomic<bool> finished;
+    std::atomic<bool> running;
+    std::thread worker;
 };
 
 
@@ -19,7 +19,195 @@
 */
 //========================================================================
 #include "lut3d.h"
+#include <algorithm>
+#include <QFile>
+#include <QSaveFile>
+#include "VarXML.h"
 
+// derivation is split over threads in chunks of at least this many cells
+static const int kMinCellsPerThread = 1 << 14;
 
+/// Run f(begin,end) in parallel over [0,n)
+template <typename F>
+static void parallelFor(int n, const F & f) {
+  int threads = std::max(1, (int)std::thread::hardware_concurrency());
+  threads = std::min(threads, std::max(1, n / kMinCellsPerThread));
+  if (threads == 1) {
+    f(0, n);
+    return;
+  }
+  vector<std::thread> workers;
+  for (int t = 0; t < threads; t++) {
+    workers.push_back(std::thread(f, (int)(((long)n * t) / threads), (int)(((long)n * (t + 1)) / threads)));
+  }
+  for (auto & worker : workers) {
+    worker.join();
+  }
+}
 
+void LUT3D::buildDeriveIndex(const LUT3D * lut) {
+  // the color conversion only depends on the layout of both LUTs, so compute
+  // the source cell of every cell once and reuse it for all later updates
+  int cells = getCellCount();
+  derive_index.resize(cells);
+  parallelFor(cells, [this, lut](int begin, int end) {
+    int sx, sy, sz;
+    for (int i = begin; i < end; i++) {
+      int x = i >> Z_AND_Y_BITS;
+      int y = (i >> Z_BITS) & getMaxY();
+      int z = i & getMaxZ();
+      mapToSource(lut2normX(x), lut2normY(y), lut2normZ(z), sx, sy, sz);
+      derive_index[i] = lut->getPointer(sx, sy, sz) - lut->getTable();
+    }
+  });
 
+  // invert the mapping, so incremental updates can find the cells depending on a source cell
+  int source_cells = lut->getCellCount();
+  derive_offsets.assign(source_cells + 1, 0);
+  for (int i = 0; i < cells; i++) {
+    derive_offsets[derive_index[i] + 1]++;
+  }
+  for (int i = 0; i < source_cells; i++) {
+    derive_offsets[i + 1] += derive_offsets[i];
+  }
+  derive_targets.resize(cells);
+  vector<uint32_t> fill(derive_offsets.begin(), derive_offsets.end() - 1);
+  for (int i = 0; i < cells; i++) {
+    derive_targets[fill[derive_index[i]]++] = i;
+  }
+  derive_source = lut;
+}
+
+void LUT3D::deriveFromLUT(LUT3D * lut) {
+  if (!checkDeriveSource(lut)) return;
+  if (derive_source != lut) {
+    buildDeriveIndex(lut);
+  }
+  const lut_mask_t * source = lut->getTable();
+  parallelFor(getCellCount(), [this, source](int begin, int end) {
+    for (int i = begin; i < end; i++) {
+      LUT[i] = source[derive_index[i]];
+    }
+  });
+}
+
+void LUT3D::deriveFromLUT(LUT3D * lut, const vector<uint32_t> & changed_cells) {
+  if (derive_source != lut) {
+    deriveFromLUT(lut);
+    return;
+  }
+  const lut_mask_t * source = lut->getTable();
+  for (uint32_t cell : changed_cells) {
+    lut_mask_t mask = source[cell];
+    for (uint32_t k = derive_offsets[cell]; k < derive_offsets[cell + 1]; k++) {
+      LUT[derive_targets[k]] = mask;
+    }
+  }
+}
+
+// binary LUT data file: a fixed header followed by the raw table
+static const char kDataFileMagic[8] = {'S','S','L','L','U','T','3','D'};
+static const uint32_t kDataFileVersion = 1;
+
+struct LUTDataFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t x_bits;
+  uint32_t y_bits;
+  uint32_t z_bits;
+  uint32_t size;
+  uint32_t reserved;
+  uint64_t checksum;
+};
+
+/// 64 bit FNV-1a hash
+static uint64_t dataChecksum(const uint8_t * data, size_t size) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ data[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+string LUT3D::getDataFileName(const string & xml_filename) {
+  string base = xml_filename;
+  if (base.size() > 4 && base.compare(base.size() - 4, 4, ".xml") == 0) {
+    base.resize(base.size() - 4);
+  }
+  return base + ".lut";
+}
+
+bool LUT3D::readDataFile(const string & filename) {
+  QFile file(QString::fromStdString(filename));
+  if (!file.exists()) {
+    // not written yet, e.g. the first start after migrating from the base64 xml data
+    return false;
+  }
+  if (!file.open(QIODevice::ReadOnly)) {
+    fprintf(stderr, "LUT3D: Unable to open LUT data file '%s'.\n", filename.c_str());
+    return false;
+  }
+  size_t data_size = LUT_SIZE * sizeof(lut_mask_t);
+  if ((size_t)file.size() != sizeof(LUTDataFileHeader) + data_size) {
+    fprintf(stderr, "LUT3D: LUT data file '%s' has an unexpected size, ignoring it.\n", filename.c_str());
+    return false;
+  }
+  const uchar * mapped = file.map(0, file.size());
+  if (mapped == 0) {
+    fprintf(stderr, "LUT3D: Unable to map LUT data file '%s'.\n", filename.c_str());
+    return false;
+  }
+  LUTDataFileHeader header;
+  memcpy(&header, mapped, sizeof(header));
+  const uint8_t * data = mapped + sizeof(header);
+  bool ok = false;
+  if (memcmp(header.magic, kDataFileMagic, sizeof(kDataFileMagic)) != 0 || header.version != kDataFileVersion) {
+    fprintf(stderr, "LUT3D: '%s' is not a LUT data file, ignoring it.\n", filename.c_str());
+  } else if (header.x_bits != X_BITS || header.y_bits != Y_BITS || header.z_bits != Z_BITS || header.size != data_size) {
+    fprintf(stderr, "LUT3D: LUT data file '%s' has layout %d-%d-%d, expected %d-%d-%d, ignoring it.\n", filename.c_str(),
+            header.x_bits, header.y_bits, header.z_bits, X_BITS, Y_BITS, Z_BITS);
+  } else if (header.checksum != dataChecksum(data, data_size)) {
+    fprintf(stderr, "LUT3D: Checksum mismatch in LUT data file '%s', ignoring it.\n", filename.c_str());
+  } else {
+    lock();
+    memcpy(LUT, data, data_size);
+    unlock();
+    ok = true;
+  }
+  file.unmap((uchar *)mapped);
+  return ok;
+}
+
+bool LUT3D::writeDataFile(const string & filename) {
+  size_t data_size = LUT_SIZE * sizeof(lut_mask_t);
+  LUTDataFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kDataFileMagic, sizeof(kDataFileMagic));
+  header.version = kDataFileVersion;
+  header.x_bits = X_BITS;
+  header.y_bits = Y_BITS;
+  header.z_bits = Z_BITS;
+  header.size = data_size;
+
+  string buffer;
+  buffer.resize(sizeof(header) + data_size);
+  lock();
+  memcpy(&buffer[sizeof(header)], LUT, data_size);
+  unlock();
+  header.checksum = dataChecksum((const uint8_t *)buffer.data() + sizeof(header), data_size);
+  memcpy(&buffer[0], &header, sizeof(header));
+
+  VarXMLFileSet * snapshot = VarXML::getActiveSnapshot();
+  if (snapshot != 0) {
+    snapshot->binary_files.push_back(make_pair(filename, buffer));
+    return true;
+  }
+
+  // write to a temporary file and rename it, so a crash never leaves a truncated table behind
+  QSaveFile file(QString::fromStdString(filename));
+  if (!file.open(QIODevice::WriteOnly) || file.write(buffer.data(), buffer.size()) != (qint64)buffer.size() || !file.commit()) {
+    fprintf(stderr, "LUT3D: Unable to write LUT data file '%s'.\n", filename.c_str());
+    return false;
+  }
+  return true;
+}
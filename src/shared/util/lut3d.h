@@ -26,8 +26,11 @@
 #include <assert.h>
 #include <vector>
 #include <string>
+#include <atomic>
+#include <thread>
 #include <qmutex.h>
 #include "VarTypes.h"
+#include "compressed_lut.h"
 #define LUTFILL_MAXDEPTH 10000
 #define LUTFILL_PUSH(XL, XR, Y, DY) \
     if( sp < stack+LUTFILL_MAXDEPTH && Y+(DY) >= 0 && Y+(DY) <= getMaxZ() ) \
@@ -72,6 +75,13 @@ class LUTChannel {
 /*!
   \class LUT3D
   \brief  A general 3D LUT class, allowing fast bit-wise lookup
+
+  The LUT is double-buffered: all editing (set, maskFillYZ, the VarBlob, ...)
+  happens on the back table, which is protected by lock()/unlock(). Once an
+  edit is complete, publish() copies the back table into the inactive front
+  table and atomically swaps it in. Image processing only ever reads a
+  published front table through acquireTable()/releaseTable() and never
+  takes the lock, so editing the LUT cannot stall the capture threads.
   \author Stefan Zickler
 */
 class LUT3D : public QObject {
@@ -94,16 +104,74 @@ class LUT3D : public QObject {
     unsigned int TOTAL_BITS; //total number of index bits
     unsigned int LUT_SIZE; //total size of LUT in bytes
 
-    lut_mask_t * LUT;
-    VarBlob * v_blob;
-    VarList * v_settings;
+    lut_mask_t * LUT; //back table, used for editing
+    VarBlob * v_blob; //only read, for files written before the binary sidecar file existed
+    VarString * v_data_file;
+    VarExternal * v_settings;
     vector<LUTChannel> channels;
     vector<LUT3D *> derived_LUTs;
     QMutex mutex;
+  protected:
+    lut_mask_t * front_LUT[2]; //published tables, read by image processing
+    std::atomic<int> front_idx;
+    std::atomic<int> front_readers[2];
+    std::atomic<unsigned int> version;
+    //optional two-level versions of the front tables:
+    CompressedLUT front_compressed[2];
+    std::atomic<bool> compression; //written under the lock, read by getCompression() without it
+
+    //derivation state, used when this LUT is derived from another one:
+    const LUT3D * derive_source;
+    vector<uint32_t> derive_index;   //for each cell of this LUT: the source cell it is derived from
+    vector<uint32_t> derive_offsets; //for each source cell: start of its cells in derive_targets
+    vector<uint32_t> derive_targets; //cells of this LUT, grouped by the source cell they are derived from
+    //state of this LUT at the last update of its derived LUTs:
+    vector<lut_mask_t> derive_snapshot;
+
+    void buildDeriveIndex(const LUT3D * lut);
+
+    /// returns false (and warns) if this LUT can not be derived from lut
+    virtual bool checkDeriveSource(const LUT3D * lut) const {
+      (void)lut;
+      return true;
+    }
+
+    /// convert the (normalized) color of a cell of this LUT into the color-space of the source LUT
+    virtual void mapToSource(int x, int y, int z, int & sx, int & sy, int & sz) const {
+      sx=x;
+      sy=y;
+      sz=z;
+    }
+
+    //copy the back table into the inactive front table and swap it in.
+    //the caller must hold the lock.
+    void publishLocked() {
+      int next = 1 - front_idx.load();
+      //wait for readers that still hold the table published before the current one
+      while (front_readers[next].load() != 0) {
+        std::this_thread::yield();
+      }
+      memcpy(front_LUT[next],LUT,LUT_SIZE*sizeof(lut_mask_t));
+      if (compression) {
+        front_compressed[next].build(X_BITS,Y_BITS,Z_BITS,LUT);
+      } else {
+        front_compressed[next].clear();
+      }
+      front_idx.store(next);
+      version++;
+    }
   protected slots:
     void slotVBlobChange() {
       updateDerivedLUTs();
     }
+    void slotDataFileRead() {
+      if (readDataFile(v_data_file->getString())) {
+        updateDerivedLUTs();
+      }
+    }
+    void slotDataFileWritten() {
+      writeDataFile(v_data_file->getString());
+    }
   public:
     //set filename to "" if this LUT should not be stored.
     LUT3D(unsigned int x_bits=7, unsigned int y_bits=7, unsigned int z_bits=7, string filename="3dlut.xml") {
@@ -126,14 +194,30 @@ class LUT3D : public QObject {
       LUT_SIZE = (0x01 << (TOTAL_BITS+1));// + 1;
       channels.resize(sizeof(lut_mask_t));
       LUT=new lut_mask_t[LUT_SIZE];
+      for (int i = 0; i < 2; i++) {
+        front_LUT[i]=new lut_mask_t[LUT_SIZE];
+        memset(front_LUT[i],0x00,LUT_SIZE*sizeof(lut_mask_t));
+        front_readers[i]=0;
+      }
+      front_idx=0;
+      version=0;
+      derive_source=0;
+      compression=false;
 
       if (filename=="") {
         v_settings=0;
         v_blob=0;
+        v_data_file=0;
       } else {
         v_settings=new VarExternal(filename,"LUT 3D");
+        //the table itself is stored in a binary file next to the xml file,
+        //the blob is only kept to migrate files that still contain the base64 data
         v_settings->addChild(v_blob=new VarBlob((uint8_t *)LUT,(int)LUT_SIZE*sizeof(lut_mask_t),"LUT Data"));
+        v_blob->addFlags(VARTYPE_FLAG_NOSAVE);
         connect(v_blob,SIGNAL(XMLwasRead(VarType *)),this,SLOT(slotVBlobChange()));
+        v_settings->addChild(v_data_file=new VarString("LUT Data File",getDataFileName(filename)));
+        connect(v_data_file,SIGNAL(XMLwasRead(VarType *)),this,SLOT(slotDataFileRead()));
+        connect(v_data_file,SIGNAL(XMLwasWritten(VarType *)),this,SLOT(slotDataFileWritten()));
       }
 
       reset();
@@ -166,10 +250,81 @@ class LUT3D : public QObject {
     void unlock() {
       mutex.unlock();
     }
+
+    /// Make the current state of the back table visible to image processing
+    void publish() {
+      lock();
+      publishLocked();
+      unlock();
+    }
+
+    /// Number of publishes so far
+    unsigned int getVersion() const {
+      return version.load();
+    }
+
+    /// Get the most recently published table for reading without locking.
+    /// The table stays valid until releaseTable(handle) is called.
+    const lut_mask_t * acquireTable(int & handle) {
+      while (true) {
+        int idx = front_idx.load();
+        front_readers[idx]++;
+        //the table might have been swapped out between reading the index and
+        //registering as a reader, in which case it may be overwritten any time
+        if (front_idx.load() == idx) {
+          handle = idx;
+          return front_LUT[idx];
+        }
+        front_readers[idx]--;
+      }
+    }
+
+    void releaseTable(int handle) {
+      front_readers[handle]--;
+    }
+
+    /// The compressed version of the table returned by acquireTable(handle),
+    /// or null if compression is disabled.
+    const CompressedLUT * getCompressedTable(int handle) const {
+      return front_compressed[handle].isValid() ? &front_compressed[handle] : 0;
+    }
+
+    /// Additionally publish a two-level compressed table, see CompressedLUT.
+    /// Returns false if compression was requested but is not supported for the bit layout of this LUT.
+    bool setCompression(bool enable) {
+      bool supported = true;
+      lock();
+      if (enable && !CompressedLUT::supportsLayout(X_BITS,Y_BITS,Z_BITS)) {
+        fprintf(stderr,"LUT3D: compression is not supported for a %d-%d-%d LUT\n",X_BITS,Y_BITS,Z_BITS);
+        enable=false;
+        supported=false;
+      }
+      if (enable != compression) {
+        compression=enable;
+        publishLocked();
+      }
+      unlock();
+      return supported;
+    }
+
+    bool getCompression() const {
+      return compression;
+    }
     VarList * getSettings() {
       return v_settings;
     }
 
+    /// name of the binary data file that belongs to the xml file of this LUT
+    static string getDataFileName(const string & xml_filename);
+
+    /// Load the table from a binary data file written by writeDataFile.
+    /// The file is memory-mapped, verified against its checksum and bit layout and copied into the back table.
+    bool readDataFile(const string & filename);
+
+    /// Atomically (re-)write the back table to a binary data file.
+    /// While a settings snapshot is taken (see VarXML::snapshot), the file is added to the snapshot instead.
+    bool writeDataFile(const string & filename);
+
     LUTChannel getChannel(unsigned int idx) const {
       if (idx >= channels.size()) {
         fprintf(stderr,"invalid channel selected in getChannel(...)\n");
@@ -224,26 +379,48 @@ class LUT3D : public QObject {
       return result;
     }
 
+    /// Publish the back table and re-derive and publish all derived LUTs from it.
+    /// Only the cells of the derived LUTs which depend on cells that changed
+    /// since the last update are recomputed.
     void updateDerivedLUTs() {
       lock();
+      publishLocked();
       int n = derived_LUTs.size();
-      for (int i = 0; i < n; i ++) {
-        derived_LUTs[i]->copyChannels(*this);
-        derived_LUTs[i]->deriveFromLUT(this);
-      }
-      unlock(); 
-    }
-
-    virtual void deriveFromLUT(LUT3D * lut) {
-      for (int x=0;x<=255;x++) {
-        for (int y=0;y<=255;y++) {
-          for (int z=0;z<=255;z++) {
-            set((unsigned char)x,(unsigned char)y,(unsigned char)z,lut->get((unsigned char)x,(unsigned char)y,(unsigned char)z));
+      if (n > 0) {
+        int cells = getCellCount();
+        bool full = (derive_snapshot.size() != (size_t)cells);
+        vector<uint32_t> changed;
+        if (!full) {
+          for (int i = 0; i < cells; i++) {
+            if (LUT[i] != derive_snapshot[i]) changed.push_back(i);
+          }
+        }
+        derive_snapshot.assign(LUT, LUT + cells);
+        for (int i = 0; i < n; i ++) {
+          derived_LUTs[i]->copyChannels(*this);
+          derived_LUTs[i]->lock();
+          if (full || derived_LUTs[i]->derive_source != this) {
+            derived_LUTs[i]->deriveFromLUT(this);
+          } else if (!changed.empty()) {
+            derived_LUTs[i]->deriveFromLUT(this, changed);
           }
+          derived_LUTs[i]->publishLocked();
+          derived_LUTs[i]->unlock();
         }
       }
+      unlock(); 
+      //table edits do not go through VarTypes, so flag the xml file (and with it
+      //the data file, which is written along with it) for the next save
+      if (v_settings != 0) v_settings->markChanged();
     }
 
+    /// Derive all cells of this LUT from lut.
+    /// Iterates over the cells of this LUT and runs in parallel.
+    void deriveFromLUT(LUT3D * lut);
+
+    /// Re-derive only the cells of this LUT that depend on the given cells of lut
+    void deriveFromLUT(LUT3D * lut, const vector<uint32_t> & changed_cells);
+
     int getChannelID(const string & label) const {
       for (int i = 0; i < getChannelCount(); i++) {
         if (channels[i].label.compare(label)==0) return i;
@@ -263,6 +440,11 @@ class LUT3D : public QObject {
       return channels.size();
     }
 
+    /// number of cells, the table itself is allocated twice as large
+    int getCellCount() const {
+      return (0x01 << TOTAL_BITS);
+    }
+
     int getSizeX() const {
       return ((0x01 << (X_BITS)));
     }
@@ -292,7 +474,10 @@ class LUT3D : public QObject {
       channels.clear();
       clearDerivedLUTs(true);
       delete[] LUT;
+      delete[] front_LUT[0];
+      delete[] front_LUT[1];
       if (v_blob!=0) delete v_blob;
+      if (v_data_file!=0) delete v_data_file;
       if (v_settings!=0) delete v_settings;
     };
 
@@ -303,9 +488,11 @@ class LUT3D : public QObject {
     void reset() {
       lock();
       memset(LUT,0x00,LUT_SIZE*sizeof(lut_mask_t));
+      publishLocked();
       unlock();
     };
 
+    /// The back table. For reading from image processing use acquireTable() instead.
     lut_mask_t * getTable() const {
       return LUT;
     }
@@ -502,38 +689,21 @@ class LUT3D : public QObject {
 class RGBLUT : public LUT3D {
   public:
   RGBLUT(unsigned int r_bits=5, unsigned int g_bits=5, unsigned int b_bits=5, string filename="rgblut.xml") : LUT3D(r_bits, g_bits, b_bits,filename) {};
-  virtual void deriveFromLUT(LUT3D * lut) {
+
+  protected:
+  virtual bool checkDeriveSource(const LUT3D * lut) const {
     if (lut->getColorSpace()!=CSPACE_YUV) {
       fprintf(stderr,"Warning: deriveFromLUT input on RGBLUT does not seem to be in YUV color-space\n");
-    } else {
-      // OLD :
-      /*int y,u,v;
-      for (int r=0;r<=255;r++) {
-        for (int g=0;g<=255;g++) {
-          for (int b=0;b<=255;b++) {
-            Conversions::rgb2yuv(r,g,b,y,u,v);
-            set((unsigned char)r,(unsigned char)g,(unsigned char)b,lut->get((unsigned char)y,(unsigned char)u,(unsigned char)v));
-          }
-        }
-      }*/
-      
-      //new, faster:
-      int y,u,v;
-      int rn=this->getSizeX();
-      int gn=this->getSizeY();
-      int bn=this->getSizeZ();
-      for (int r=0;r!=rn;r++) {
-        for (int g=0;g!=gn;g++) {
-          for (int b=0;b!=bn;b++) {
-            Conversions::rgb2yuv((int)lut2normX((unsigned char)r),(int)lut2normY((unsigned char)g),(int)lut2normZ((unsigned char)b),y,u,v);
-            set_preshrunk(r,g,b,lut->get((unsigned char)y,(unsigned char)u,(unsigned char)v));
-          }
-        }
-      }
-      
+      return false;
     }
+    return true;
   }
 
+  virtual void mapToSource(int r, int g, int b, int & y, int & u, int & v) const {
+    Conversions::rgb2yuv(r,g,b,y,u,v);
+  }
+
+  public:
   virtual ColorSpace getColorSpace() const {
     return CSPACE_RGB;
   }
@@ -549,34 +719,20 @@ class YUVLUT : public LUT3D {
   public:
   YUVLUT(unsigned int y_bits=4, unsigned int u_bits=5, unsigned int v_bits=5, string filename="yuvlut.xml") : LUT3D(y_bits, u_bits, v_bits,filename) {};
 
-  virtual void deriveFromLUT(LUT3D * lut) {
+  protected:
+  virtual bool checkDeriveSource(const LUT3D * lut) const {
     if (lut->getColorSpace()!=CSPACE_RGB) {
       fprintf(stderr,"Warning: deriveFromLUT input on YUVLUT does not seem to be in RGB color-space\n");
-    } else {
-      /*int r,g,b;
-      for (int y=0;y<=255;y++) {
-        for (int u=0;u<=255;u++) {
-          for (int v=0;v<=255;v++) {
-            Conversions::yuv2rgb(y,u,v,r,g,b);
-            set((unsigned char)y,(unsigned char)u,(unsigned char)v,lut->get((unsigned char)r,(unsigned char)g,(unsigned char)b));
-          }
-        }
-      }*/
-      int r,g,b;
-      int yn=this->getSizeX();
-      int un=this->getSizeY();
-      int vn=this->getSizeZ();
-      for (int y=0;y!=yn;y++) {
-        for (int u=0;u!=un;u++) {
-          for (int v=0;v!=vn;v++) {
-            Conversions::yuv2rgb((int)lut2normX((unsigned char)y),(int)lut2normY((unsigned char)u),(int)lut2normZ((unsigned char)v),r,g,b);
-            set_preshrunk((unsigned char)y,(unsigned char)u,(unsigned char)v,lut->get((unsigned char)r,(unsigned char)g,(unsigned char)b));
-          }
-        }
-      }
+      return false;
     }
+    return true;
+  }
+
+  virtual void mapToSource(int y, int u, int v, int & r, int & g, int & b) const {
+    Conversions::yuv2rgb(y,u,v,r,g,b);
   }
 
+  public:
   /// This will clear the LUT and create a new LUT-dataset modeling a NN-lookup based solely on color labels
   virtual void computeLUTfromLabels(int max_dist=0) {
     this->lock();
@@ -606,6 +762,7 @@ class YUVLUT : public LUT3D {
         }
       }
     }
+    publishLocked();
     this->unlock();
   }
   virtual ColorSpace getColorSpace() const {
@@ -0,0 +1,86 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    VarBinding.h
+  \brief   C++ Interface: VarBinding
+*/
+//========================================================================
+#ifndef VARBINDING_H
+#define VARBINDING_H
+#include "VarNotifier.h"
+#include <atomic>
+#include <functional>
+
+namespace VarTypes {
+  /**
+    @brief  A plain struct of values that mirrors a set of VarTypes
+
+    The bound items are watched by a VarNotifier. Whenever one of them
+    changes, the next call to update() re-reads the values from the tree
+    through the given read function. Between changes, get() returns the
+    cached struct without touching any VarType mutex or copying strings,
+    which makes it suitable for per-frame code.
+
+    update() and get() must be called from the same (processing) thread.
+    A change that arrives while update() is reading the tree is picked up
+    by the following update().
+  */
+  template <class T>
+  class VarBinding {
+  public:
+    typedef std::function<void(T &)> ReadFunction;
+
+    explicit VarBinding(ReadFunction _read) : read(_read), dirty(true) {
+      QObject::connect(&notifier, &VarNotifier::changeOccured, &notifier, [this](VarType *) {
+        dirty.store(true, std::memory_order_release);
+      });
+    }
+
+    /// watch item and all of its children
+    void bind(VarType * item) {
+      notifier.addRecursive(item);
+      invalidate();
+    }
+
+    /// force a re-read on the next update()
+    void invalidate() {
+      dirty.store(true, std::memory_order_release);
+    }
+
+    /// re-reads the values if any bound item changed, returns true if it did
+    bool update() {
+      //plain load first, so that the common case stays a single read:
+      if (!dirty.load(std::memory_order_acquire)) return false;
+      if (!dirty.exchange(false, std::memory_order_acq_rel)) return false;
+      read(values);
+      return true;
+    }
+
+    const T & get() const {
+      return values;
+    }
+
+    const T * operator->() const {
+      return &values;
+    }
+
+  protected:
+    VarNotifier notifier;
+    ReadFunction read;
+    std::atomic<bool> dirty;
+    T values;
+  };
+};
+#endif
@@ -20,6 +20,7 @@
 //========================================================================
 
 #include "VarXML.h"
+#include <stdio.h>
 
 namespace VarTypes {
   VarXML::VarXML() {};
@@ -33,16 +34,69 @@ namespace VarTypes {
   }
   void VarXML::write(vector<VarType *> rootVars, string filename)
   {
+    VarXMLFileSet * files = snapshot(rootVars, filename);
+    writeFiles(files);
+    delete files;
+  }
+
+  thread_local VarXMLFileSet * VarXML::active_snapshot = 0;
 
+  VarXMLFileSet * VarXML::getActiveSnapshot()
+  {
+    return active_snapshot;
+  }
+
+  VarXMLFileSet * VarXML::snapshot(vector<VarType *> rootVars, string filename)
+  {
+    VarXMLFileSet * files = new VarXMLFileSet();
+    active_snapshot = files;
     XMLNode root = XMLNode::openFileHelper(filename.c_str(),"VarXML");
     VarType::deleteAllVarChildren(root);
     for (unsigned int i=0;i<rootVars.size();i++) {
       rootVars[i]->writeXML(root,true);
     }
-    const VarTypes::XMLError error = root.writeToFile(filename.c_str());
-    if (error != VarTypes::eXMLErrorNone) {
-      fprintf(stderr, "Error saving XML: %d\n", error);
+    files->xml_files.push_back(make_pair(filename, root));
+    active_snapshot = 0;
+    return files;
+  }
+
+  static void raiseFailureFlag(const VarXMLFileSet * files, const string & filename)
+  {
+    map<string, std::shared_ptr<std::atomic<bool> > >::const_iterator flag = files->failure_flags.find(filename);
+    if (flag != files->failure_flags.end()) *flag->second = true;
+  }
+
+  bool VarXML::writeFiles(const VarXMLFileSet * files)
+  {
+    bool ok = true;
+    for (unsigned int i=0;i<files->xml_files.size();i++) {
+      const string & filename = files->xml_files[i].first;
+      string tmp_filename = filename + ".tmp";
+      const VarTypes::XMLError error = files->xml_files[i].second.writeToFile(tmp_filename.c_str());
+      if (error != VarTypes::eXMLErrorNone) {
+        fprintf(stderr, "Error saving XML: %d\n", error);
+        raiseFailureFlag(files, filename);
+        ok = false;
+      } else if (rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+        fprintf(stderr, "Error saving XML: unable to replace %s\n", filename.c_str());
+        raiseFailureFlag(files, filename);
+        ok = false;
+      }
+    }
+    for (unsigned int i=0;i<files->binary_files.size();i++) {
+      const string & filename = files->binary_files[i].first;
+      const string & data = files->binary_files[i].second;
+      string tmp_filename = filename + ".tmp";
+      FILE * f = fopen(tmp_filename.c_str(), "wb");
+      bool written = (f != 0 && fwrite(data.data(), 1, data.size(), f) == data.size());
+      if (f != 0 && fclose(f) != 0) written = false;
+      if (!written || rename(tmp_filename.c_str(), filename.c_str()) != 0) {
+        fprintf(stderr, "Error saving file: %s\n", filename.c_str());
+        raiseFailureFlag(files, filename);
+        ok = false;
+      }
     }
+    return ok;
   }
 
   vector<VarType *> VarXML::read(vector<VarType *> existing_nodes, string filename)
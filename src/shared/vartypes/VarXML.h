@@ -22,8 +22,27 @@
 #define VARXML_H_
 #include "VarTypes.h"
 #include "xml/xmlParser.h"
+#include <atomic>
+#include <map>
+#include <memory>
 
 namespace VarTypes {
+  /*!
+    \class  VarXMLFileSet
+    \brief  The files produced by serializing a VarTypes tree
+
+    Once created, a file set no longer references the VarTypes tree, so it
+    can be written by any thread using \c VarXML::writeFiles.
+  */
+  class VarXMLFileSet
+  {
+  public:
+    vector<pair<string, XMLNode> > xml_files;
+    vector<pair<string, string> > binary_files;
+    /// flags raised by \c VarXML::writeFiles when the file of that name could not be written
+    map<string, std::shared_ptr<std::atomic<bool> > > failure_flags;
+  };
+
   /*!
     \class  VarXML
     \brief  XML helper functions of the VarType system.
@@ -56,6 +75,22 @@ namespace VarTypes {
     /// any existing nodes, or create new nodes if they are missing in the existing
     /// tree.
     static vector<VarType *> read(vector<VarType *> existing_nodes, string filename);
+
+    /// serialize a vector of VarType nodes (and all of their children) without writing anything.
+    /// External lists and other files which are part of the tree are added to the returned set.
+    /// The caller takes ownership of the returned set.
+    static VarXMLFileSet * snapshot(vector<VarType *> rootVars, string filename);
+
+    /// write all files of a snapshot. Each file is written to a temporary file first
+    /// and then renamed, so readers never see partially written files.
+    static bool writeFiles(const VarXMLFileSet * files);
+
+    /// the file set of the snapshot currently being created by this thread, or null
+    /// if the tree is being written directly.
+    static VarXMLFileSet * getActiveSnapshot();
+
+  protected:
+    static thread_local VarXMLFileSet * active_snapshot;
   };
 };
 #endif /*VARXML_H_*/
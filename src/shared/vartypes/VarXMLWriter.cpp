@@ -0,0 +1,77 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    VarXMLWriter.cpp
+  \brief   C++ Implementation: VarXMLWriter
+*/
+//========================================================================
+
+#include "VarXMLWriter.h"
+
+namespace VarTypes {
+  VarXMLWriter::VarXMLWriter() : busy(false), running(true)
+  {
+    worker = std::thread(&VarXMLWriter::run, this);
+  }
+
+  VarXMLWriter::~VarXMLWriter()
+  {
+    flush();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      running = false;
+    }
+    condition.notify_all();
+    worker.join();
+  }
+
+  void VarXMLWriter::write(vector<VarType *> rootVars, string filename)
+  {
+    VarXMLFileSet * files = VarXML::snapshot(rootVars, filename);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      pending.push_back(files);
+    }
+    condition.notify_all();
+  }
+
+  void VarXMLWriter::flush()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this] { return pending.empty() && !busy; });
+  }
+
+  void VarXMLWriter::run()
+  {
+    while (true) {
+      VarXMLFileSet * files;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [this] { return !running || !pending.empty(); });
+        if (pending.empty()) return;
+        files = pending.front();
+        pending.pop_front();
+        busy = true;
+      }
+      VarXML::writeFiles(files);
+      delete files;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        busy = false;
+      }
+      condition.notify_all();
+    }
+  }
+};
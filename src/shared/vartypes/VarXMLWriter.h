@@ -0,0 +1,61 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    VarXMLWriter.h
+  \brief   C++ Interface: VarXMLWriter
+*/
+//========================================================================
+#ifndef VARXMLWRITER_H_
+#define VARXMLWRITER_H_
+#include "VarXML.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace VarTypes {
+  /*!
+    \class  VarXMLWriter
+    \brief  Writes VarTypes trees to XML on a background thread
+
+    \c write() only serializes the tree on the calling thread (see
+    \c VarXML::snapshot) and leaves the file I/O to a worker thread.
+    Snapshots are written in the order they were taken. The destructor
+    writes all pending snapshots before returning.
+  */
+  class VarXMLWriter
+  {
+  public:
+    VarXMLWriter();
+    virtual ~VarXMLWriter();
+
+    /// snapshot a vector of VarType nodes and write them to an xml file in the background
+    void write(vector<VarType *> rootVars, string filename);
+
+    /// block until all pending snapshots are written
+    void flush();
+
+  protected:
+    void run();
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<VarXMLFileSet *> pending;
+    bool busy;
+    bool running;
+    std::thread worker;
+  };
+};
+#endif /*VARXMLWRITER_H_*/
@@ -19,12 +19,15 @@
 */
 
 #include "primitives/VarExternal.h"
+#include "VarXML.h"
+#include <stdio.h>
 
 namespace VarTypes {
 
 VarExternal::VarExternal(string _filename, VarList * vlist) : VarList(vlist->getName())
 {
   list=vlist->getChildren();
+  saved=false;
   lock();
   filename=_filename;
   unlock();
@@ -32,6 +35,7 @@ VarExternal::VarExternal(string _filename, VarList * vlist) : VarList(vlist->get
 
 VarExternal::VarExternal(string _filename, string _name) : VarList(_name)
 {
+  saved=false;
   lock();
   filename=_filename;
   unlock();
@@ -57,6 +61,46 @@ void VarExternal::loadExternal() {
   unlock();
 }
 
+void VarExternal::updateChildren(XMLNode & us) const
+{
+  (void)us;
+  FILE * f = fopen(filename.c_str(), "rb");
+  bool exists = (f != 0);
+  if (f != 0) fclose(f);
+  bool retry = (write_failed && *write_failed);
+  if (saved && exists && !retry && save_notifier.hasChanged() == false) {
+    //nothing changed since the last successful write
+    return;
+  }
+  //watch the current subtree, including items added since the last write
+  save_notifier.clear();
+  save_notifier.addRecursive(const_cast<VarExternal *>(this));
+  save_notifier.setChanged(false);
+  saved=true;
+  //a fresh flag, so that the outcome of an older write still pending does not count
+  write_failed = std::make_shared<std::atomic<bool> >(false);
+
+  XMLNode parent = XMLNode::openFileHelper(filename.c_str(),"VarXML");
+  VarXMLFileSet * snapshot = VarXML::getActiveSnapshot();
+  unsigned int binary_before = (snapshot != 0) ? snapshot->binary_files.size() : 0;
+  //and update it...
+  VarList::updateChildren(parent);
+  if (snapshot != 0) {
+    //written later, together with the rest of the snapshot. Files of nested
+    //external lists already carry their own flags.
+    snapshot->xml_files.push_back(make_pair(filename, parent));
+    snapshot->failure_flags.insert(make_pair(filename, write_failed));
+    for (unsigned int i=binary_before;i<snapshot->binary_files.size();i++) {
+      snapshot->failure_flags.insert(make_pair(snapshot->binary_files[i].first, write_failed));
+    }
+  } else {
+    //save file to empty parent
+    if (parent.writeToFile(filename.c_str()) != eXMLErrorNone) {
+      *write_failed = true;
+    }
+  }
+}
+
 void VarExternal::readChildren(XMLNode & us) {
   (void)us;
   loadExternal();
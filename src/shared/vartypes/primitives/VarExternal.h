@@ -22,6 +22,9 @@
 #ifndef DATAGROUPEXTERNAL_H_
 #define DATAGROUPEXTERNAL_H_
 #include "primitives/VarList.h"
+#include "VarNotifier.h"
+#include <atomic>
+#include <memory>
 
 using namespace std;
 namespace VarTypes {
@@ -38,6 +41,9 @@ namespace VarTypes {
     entire data-tree in the same XML file, but rather put
     a certain subtree into its own file.
   
+    The external file is only re-written if any of its items changed since
+    it was last written, or if that write failed.
+
     If you don't know what VarTypes are, please see \c VarTypes.h 
   */
   class VarExternal : public VarList
@@ -45,6 +51,10 @@ namespace VarTypes {
     Q_OBJECT
   protected:
     string filename;
+    mutable VarNotifier save_notifier;
+    mutable bool saved;
+    //raised when the last write of the file (or of a file written along with it) failed
+    mutable std::shared_ptr<std::atomic<bool> > write_failed;
   
   public:
     /// Construct a VarExternal list from an existing VarList
@@ -55,6 +65,12 @@ namespace VarTypes {
   
     virtual ~VarExternal();
     virtual VarTypeId getType() const { return VARTYPE_ID_EXTERNAL; } ;
+
+    /// Have the external file re-written with the next save. For data that is
+    /// written along with this list but changes without any VarType changing.
+    void markChanged() {
+      save_notifier.setChanged(true);
+    }
   
   
   #ifndef VDATA_NO_XML
@@ -71,15 +87,7 @@ namespace VarTypes {
       VarList::readAttributes(us);
     }
   
-    virtual void updateChildren(XMLNode & us) const
-    {
-      (void)us;
-      XMLNode parent = XMLNode::openFileHelper(filename.c_str(),"VarXML");
-      //and update it...
-      VarList::updateChildren(parent);
-      //save file to empty parent
-      parent.writeToFile(filename.c_str());
-    }
+    virtual void updateChildren(XMLNode & us) const;
   
     virtual void readChildren(XMLNode & us);
   
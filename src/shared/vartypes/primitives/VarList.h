@@ -57,7 +57,15 @@ namespace VarTypes {
     virtual string getString() const { return ""; }
 
     /// this will clear the list
-    virtual void resetToDefault() {lock(); for (unsigned int i=0;i<list.size();i++) { emit(childRemoved(list[i])); } list.clear();  unlock(); };
+    virtual void resetToDefault() {
+      lock();
+      bool removed=!list.empty();
+      for (unsigned int i=0;i<list.size();i++) { emit(childRemoved(list[i])); }
+      list.clear();
+      unlock();
+      //like removeChild, so that watchers (e.g. VarExternal) see the removal
+      if (removed) changed();
+    };
 
     /// prints the label and number of elements
     virtual void printdebug() const { printf("VarList named %s containing %zu element(s)\n",getName().c_str(), list.size()); }
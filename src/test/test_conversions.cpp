@@ -0,0 +1,94 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    test_conversions.cpp
+  \brief   The SSSE3 image conversions match the portable ones bit for bit
+*/
+//========================================================================
+#include "conversions.h"
+#include "test_util.h"
+#include <cstring>
+#include <vector>
+
+// Converts random images with the accelerated and with the portable
+// function and compares the complete destination buffers, including a
+// guard area behind the image. Widths and heights cover images smaller
+// than one 16 pixel block, every tail length and odd pixel counts, whose
+// last pixel has no partner and is left untouched by both versions.
+
+typedef void (*Conversion)(unsigned char * src, unsigned char * dest, int width, int height);
+typedef void (*ScalarConversion)(unsigned char * src, unsigned char * dest, int width, int height, int first);
+
+static const int kGuardBytes = 64;
+static const unsigned char kUntouched = 0xa5;
+
+static void fillRandom(std::vector<unsigned char> & data, unsigned int seed) {
+  for (size_t i = 0; i < data.size(); i++) {
+    seed = seed * 1664525u + 1013904223u;
+    data[i] = (unsigned char) (seed >> 24);
+  }
+}
+
+static void checkConversion(const char * name, Conversion fast, ScalarConversion scalar,
+                            int src_bytes_per_pixel, int dest_bytes_per_pixel, int width, int height) {
+  int num_pixels = width * height;
+  std::vector<unsigned char> src(num_pixels * src_bytes_per_pixel + kGuardBytes);
+  fillRandom(src, width * 7919u + height);
+  std::vector<unsigned char> expected(num_pixels * dest_bytes_per_pixel + kGuardBytes, kUntouched);
+  std::vector<unsigned char> actual(expected.size(), kUntouched);
+  scalar(src.data(), expected.data(), width, height, 0);
+  fast(src.data(), actual.data(), width, height);
+  if (actual != expected) {
+    size_t i = 0;
+    while (actual[i] == expected[i]) i++;
+    fprintf(stderr, "%s %dx%d: byte %zu is %d, expected %d\n", name, width, height, i, actual[i], expected[i]);
+    test_failures++;
+  }
+}
+
+static void checkAllConversions(int width, int height) {
+#if defined(__SSSE3__) || defined(NO_DC1394_CONVERSIONS)
+  // without SSSE3, these two go through dc1394, which rounds differently
+  checkConversion("uyvy2rgb", Conversions::uyvy2rgb, Conversions::uyvy2rgbScalar, 2, 3, width, height);
+  checkConversion("yuyv2rgb", Conversions::yuyv2rgb, Conversions::yuyv2rgbScalar, 2, 3, width, height);
+#endif
+  checkConversion("uyvy2bgr", Conversions::uyvy2bgr, Conversions::uyvy2bgrScalar, 2, 3, width, height);
+  checkConversion("rgb2uyvy", Conversions::rgb2uyvy, Conversions::rgb2uyvyScalar, 3, 2, width, height);
+  checkConversion("rgb2yuyv", Conversions::rgb2yuyv, Conversions::rgb2yuyvScalar, 3, 2, width, height);
+  checkConversion("bgr2rgb", Conversions::bgr2rgb, Conversions::bgr2rgbScalar, 3, 3, width, height);
+  checkConversion("y2rgb", Conversions::y2rgb, Conversions::y2rgbScalar, 1, 3, width, height);
+}
+
+int main() {
+#ifdef __SSSE3__
+  printf("comparing the SSSE3 conversions with the portable ones\n");
+#else
+  printf("built without SSSE3, both versions are portable\n");
+#endif
+  // every tail length up to two blocks, in single rows and in odd-sized images
+  for (int width = 1; width <= 48; width++) {
+    checkAllConversions(width, 1);
+    checkAllConversions(width, 3);
+  }
+  // odd widths next to the camera resolutions
+  const int widths[] = {779, 781, 1279, 1281, 1919, 1921};
+  for (int width : widths) {
+    checkAllConversions(width, 1);
+    checkAllConversions(width, 5);
+  }
+  checkAllConversions(780, 580);
+  checkAllConversions(1280, 1024);
+  return testResult();
+}
@@ -0,0 +1,119 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    test_detection_tracker.cpp
+  \brief   Life cycle of a robot track: first sight, coast, timeout, re-acquire
+*/
+//========================================================================
+#include "detection_tracker.h"
+#include "test_util.h"
+#include <cmath>
+
+// Feeds detections of one robot straight into the track update and reads
+// the state that would be published, without a network server. The
+// tracker settings keep their defaults, so the track timeout is 0.5 s.
+
+static const int kRobotId = 3;
+static const double kTimeout = 0.5;
+
+class TrackerProbe : public DetectionTracker {
+public:
+  TrackerProbe() : DetectionTracker(nullptr) {
+    values.update();
+  }
+
+  const Track & track() const {
+    return robots[0][kRobotId];
+  }
+
+  void see(double t, double x, double y) {
+    SSL_DetectionRobot robot;
+    robot.set_confidence(1.0);
+    robot.set_robot_id(kRobotId);
+    robot.set_x(x);
+    robot.set_y(y);
+    robot.set_orientation(0.0);
+    robot.set_pixel_x(0.0);
+    robot.set_pixel_y(0.0);
+    updateRobot(robots[0][kRobotId], robot, t);
+  }
+
+  TrackedRobot state(double t) {
+    TrackedRobot out;
+    setRobot(&out, track(), kRobotId, TEAM_COLOR_BLUE, t);
+    return out;
+  }
+};
+
+static bool near(double a, double b, double tolerance) {
+  return std::fabs(a - b) <= tolerance;
+}
+
+int main() {
+  TrackerProbe tracker;
+  EXPECT(!tracker.track().active);
+  EXPECT(tracker.track().hits == 0);
+
+  // first sight: the state is the detection, fully visible
+  double t = 10.0;
+  tracker.see(t, 1000.0, 500.0);
+  EXPECT(tracker.track().active);
+  EXPECT(tracker.track().hits == 1);
+  EXPECT(tracker.track().t_seen == t);
+  TrackedRobot first = tracker.state(t);
+  EXPECT(near(first.pos().x(), 1.0, 1e-6));
+  EXPECT(near(first.pos().y(), 0.5, 1e-6));
+  EXPECT(near(first.visibility(), 1.0, 1e-6));
+
+  // half a second at 1 m/s along x, at 60 Hz
+  double x = 1000.0;
+  for (int i = 0; i < 30; i++) {
+    t += 1.0 / 60.0;
+    x += 1000.0 / 60.0;
+    tracker.see(t, x, 500.0);
+  }
+  EXPECT(tracker.track().hits == 31);
+  EXPECT(tracker.track().t_seen == t);
+  TrackedRobot moving = tracker.state(t);
+  EXPECT(near(moving.vel().x(), 1.0, 0.1));
+  EXPECT(near(moving.vel().y(), 0.0, 0.05));
+
+  // coast: without detections the state is extrapolated and fades out
+  TrackedRobot coast = tracker.state(t + 0.2);
+  EXPECT(near(coast.pos().x(), (x + 200.0) * 0.001, 0.02));
+  EXPECT(near(coast.visibility(), 1.0 - 0.2 / kTimeout, 1e-6));
+  EXPECT(tracker.track().t_seen == t);
+
+  // timeout: no longer visible
+  TrackedRobot lost = tracker.state(t + kTimeout + 0.1);
+  EXPECT(lost.visibility() == 0.0);
+
+  // re-acquire after the timeout: a fresh track at the new position, at rest
+  double t_back = t + kTimeout + 0.1;
+  tracker.see(t_back, -2000.0, 300.0);
+  EXPECT(tracker.track().hits == 1);
+  EXPECT(tracker.track().t_seen == t_back);
+  TrackedRobot back = tracker.state(t_back);
+  EXPECT(near(back.pos().x(), -2.0, 1e-6));
+  EXPECT(near(back.pos().y(), 0.3, 1e-6));
+  EXPECT(back.vel().x() == 0.0);
+  EXPECT(near(back.visibility(), 1.0, 1e-6));
+
+  // a detection within the timeout continues the track
+  tracker.see(t_back + 0.1, -2000.0, 300.0);
+  EXPECT(tracker.track().hits == 2);
+
+  return testResult();
+}
@@ -0,0 +1,158 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    test_encode_runs.cpp
+  \brief   The vectorized run scans of encodeRuns match a byte-wise scan
+*/
+//========================================================================
+#include "cmvision_region.h"
+#include "test_util.h"
+#include <cstdint>
+#include <vector>
+
+// encodeRuns finds run ends 32 (AVX2) or 16 (SSE2) pixels at a time and
+// falls back to single bytes for the rest of the row. The runs it produces
+// are compared with a plain byte-by-byte encoder that follows the same
+// rules: runs of the clear label are only kept at the end of a row, and
+// labels that are not region colors of the filter count as clear.
+
+using CMVision::Run;
+using CMVision::RunColorFilter;
+using CMVision::RunList;
+
+static std::vector<Run> referenceRuns(const Image<raw8> & image, const RunColorFilter * filter) {
+  std::vector<Run> runs;
+  int width = image.getWidth();
+  for (int y = 0; y < image.getHeight(); y++) {
+    const raw8 * row = image.getPixelData() + y * width;
+    int x = 0;
+    while (x < width) {
+      uint8_t label = row[x].v;
+      if (filter != nullptr && !filter->isRegionColor(label)) label = 0;
+      int end = x + 1;
+      while (end < width) {
+        uint8_t next = row[end].v;
+        if (filter != nullptr && !filter->isRegionColor(next)) next = 0;
+        if (next != label) break;
+        end++;
+      }
+      if (label != 0 || end == width) {
+        Run r;
+        r.x = x;
+        r.y = y;
+        r.width = end - x;
+        r.color = raw8(label);
+        runs.push_back(r);
+      }
+      x = end;
+    }
+  }
+  return runs;
+}
+
+static void checkImage(const char * name, Image<raw8> & image, const RunColorFilter * filter) {
+  std::vector<Run> expected = referenceRuns(image, filter);
+  RunList runlist((int) expected.size() + 1);
+  CMVision::RegionProcessing::encodeRuns(&image, &runlist, filter);
+  if (runlist.getUsedRuns() != (int) expected.size()) {
+    fprintf(stderr, "%s %dx%d: %d runs, expected %d\n", name, image.getWidth(), image.getHeight(),
+            runlist.getUsedRuns(), (int) expected.size());
+    test_failures++;
+    return;
+  }
+  for (size_t i = 0; i < expected.size(); i++) {
+    Run r = runlist.getRun(i);
+    const Run & e = expected[i];
+    if (r.x != e.x || r.y != e.y || r.width != e.width || r.color != e.color) {
+      fprintf(stderr, "%s %dx%d: run %zu is x=%d y=%d width=%d color=%d, expected x=%d y=%d width=%d color=%d\n",
+              name, image.getWidth(), image.getHeight(), i, r.x, r.y, r.width, r.color.v,
+              e.x, e.y, e.width, e.color.v);
+      test_failures++;
+      return;
+    }
+  }
+}
+
+// one row per run [start, end) of label on background, for every start
+// below 34 and every end up to the end of the row
+static void fillSingleRuns(Image<raw8> & image, int width, uint8_t label, uint8_t background) {
+  int rows = 0;
+  for (int start = 0; start < width && start < 34; start++) rows += width - start;
+  image.allocate(width, rows);
+  int y = 0;
+  for (int start = 0; start < width && start < 34; start++) {
+    for (int end = start + 1; end <= width; end++, y++) {
+      raw8 * row = image.getPixelData() + y * width;
+      for (int x = 0; x < width; x++) {
+        row[x] = raw8(x >= start && x < end ? label : background);
+      }
+    }
+  }
+}
+
+// runs of random labels and lengths, some longer than two AVX2 chunks
+static void fillRandomRuns(Image<raw8> & image, int width, int height, const uint8_t * labels, int num_labels) {
+  image.allocate(width, height);
+  unsigned int state = 1;
+  raw8 * p = image.getPixelData();
+  int n = width * height;
+  for (int i = 0; i < n;) {
+    state = state * 1103515245u + 12345u;
+    int length = 1 + (state >> 16) % ((state >> 8) % 4 == 0 ? 100 : 8);
+    uint8_t label = labels[(state >> 24) % num_labels];
+    for (int j = 0; j < length && i < n; j++, i++) {
+      p[i] = raw8(label);
+    }
+  }
+}
+
+int main() {
+  RunColorFilter some_colors;
+  some_colors.setRegionColor(1, true);
+  some_colors.setRegionColor(3, true);
+  RunColorFilter high_color;  // a label above 127 takes the byte-wise filter scan
+  high_color.setRegionColor(1, true);
+  high_color.setRegionColor(200, true);
+  RunColorFilter all_colors;
+  all_colors.setAllRegionColors(true);
+
+  // run ends at every offset within a chunk and at the end of the row
+  const int widths[] = {1, 15, 16, 17, 31, 32, 33, 63, 64, 65, 96, 97, 130};
+  Image<raw8> image;
+  for (int width : widths) {
+    fillSingleRuns(image, width, 1, 0);
+    checkImage("run on clear", image, nullptr);
+    checkImage("run on clear, filtered", image, &some_colors);
+    checkImage("run on clear, all colors", image, &all_colors);
+    fillSingleRuns(image, width, 1, 2);
+    checkImage("run on label", image, nullptr);
+    checkImage("run on non-region label", image, &some_colors);
+    checkImage("run on non-region label, high color", image, &high_color);
+    fillSingleRuns(image, width, 0, 3);
+    checkImage("clear run on label", image, nullptr);
+    checkImage("clear run on region label", image, &some_colors);
+  }
+
+  const uint8_t labels[] = {0, 1, 2, 3, 4, 200};
+  const int sizes[][2] = {{780, 580}, {781, 3}, {1280, 1024}};
+  for (const auto & size : sizes) {
+    fillRandomRuns(image, size[0], size[1], labels, 6);
+    checkImage("random", image, nullptr);
+    checkImage("random, filtered", image, &some_colors);
+    checkImage("random, high color", image, &high_color);
+    checkImage("random, all colors", image, &all_colors);
+  }
+  return testResult();
+}
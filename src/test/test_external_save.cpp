@@ -0,0 +1,78 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    test_external_save.cpp
+  \brief   External files are rewritten after a cleared list and a failed write
+*/
+//========================================================================
+#include "convex_hull_image_mask.h"
+#include "VarXMLWriter.h"
+#include "test_util.h"
+#include <QDir>
+#include <QTemporaryDir>
+#include <iterator>
+
+// Saves an image mask, which lives in its own external file, like
+// MainWindow does and reloads it into a fresh mask after each step.
+
+static void save(VarXMLWriter & writer, ConvexHullImageMask & mask, const string & settings_file) {
+  vector<VarType *> world;
+  world.push_back(mask.getSettings());
+  writer.write(world, settings_file);
+  writer.flush();
+}
+
+static int reloadedPoints(const string & mask_file, const string & settings_file) {
+  ConvexHullImageMask loaded(mask_file);
+  vector<VarType *> world;
+  world.push_back(loaded.getSettings());
+  VarXML::read(world, settings_file);
+  return (int) std::distance(loaded.getConvexHull().begin(), loaded.getConvexHull().end());
+}
+
+int main() {
+  QTemporaryDir dir;
+  EXPECT(dir.isValid());
+  string mask_file = dir.filePath("mask.xml").toStdString();
+  string settings_file = dir.filePath("settings.xml").toStdString();
+
+  VarXMLWriter writer;
+  ConvexHullImageMask mask(mask_file);
+  mask.setSize(100, 100);
+  mask.addPoint(10, 10);
+  mask.addPoint(90, 10);
+  mask.addPoint(50, 90);
+  save(writer, mask, settings_file);
+  EXPECT(reloadedPoints(mask_file, settings_file) == 3);
+
+  // clearing the mask empties the list without changing any item in it
+  mask.reset();
+  save(writer, mask, settings_file);
+  EXPECT(reloadedPoints(mask_file, settings_file) == 0);
+
+  // a write that fails (the temporary file cannot be created) is retried
+  // with the next save, even though nothing changed in between
+  mask.addPoint(20, 20);
+  mask.addPoint(80, 20);
+  mask.addPoint(50, 70);
+  QDir(dir.path()).mkdir("mask.xml.tmp");
+  save(writer, mask, settings_file);
+  EXPECT(reloadedPoints(mask_file, settings_file) == 0);
+  QDir(dir.path()).rmdir("mask.xml.tmp");
+  save(writer, mask, settings_file);
+  EXPECT(reloadedPoints(mask_file, settings_file) == 3);
+
+  return testResult();
+}
@@ -0,0 +1,85 @@
+//========================================================================
+//  This software is free: you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License Version 3,
+//  as published by the Free Software Foundation.
+//
+//  This software is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  Version 3 in the file COPYING that came with this distribution.
+//  If not, see <http://www.gnu.org/licenses/>.
+//========================================================================
+/*!
+  \file    test_lut_save.cpp
+  \brief   LUT edits are saved with every settings save, not just the first
+*/
+//========================================================================
+#include "lut3d.h"
+#include "VarXMLWriter.h"
+#include "test_util.h"
+#include <QTemporaryDir>
+#include <cstring>
+
+// Saves a LUT like MainWindow does, edits it, saves again and checks that a
+// fresh LUT read from the files matches the edited table.
+
+static void paintCells(YUVLUT & lut, lut_mask_t label) {
+  lut.lock();
+  for (int y = 0; y <= lut.getMaxX(); y += 3) {
+    lut.set_preshrunk(y, label, 2 * label, label);
+  }
+  lut.unlock();
+  lut.updateDerivedLUTs();
+}
+
+static bool sameTable(const YUVLUT & a, const YUVLUT & b) {
+  return a.LUT_SIZE == b.LUT_SIZE && memcmp(a.getTable(), b.getTable(), a.LUT_SIZE * sizeof(lut_mask_t)) == 0;
+}
+
+static void save(VarXMLWriter & writer, YUVLUT & lut, const string & settings_file) {
+  vector<VarType *> world;
+  world.push_back(lut.getSettings());
+  writer.write(world, settings_file);
+  writer.flush();
+}
+
+static void checkReload(const YUVLUT & saved, const string & lut_file, const string & settings_file) {
+  YUVLUT loaded(4, 6, 6, lut_file);
+  vector<VarType *> world;
+  world.push_back(loaded.getSettings());
+  VarXML::read(world, settings_file);
+  EXPECT(sameTable(saved, loaded));
+}
+
+int main() {
+  QTemporaryDir dir;
+  EXPECT(dir.isValid());
+  string lut_file = dir.filePath("lut-yuv.xml").toStdString();
+  string settings_file = dir.filePath("settings.xml").toStdString();
+
+  VarXMLWriter writer;
+  YUVLUT lut(4, 6, 6, lut_file);
+  lut.loadRoboCupChannels(LUTChannelMode_Numeric);
+
+  // first save, then two rounds of edit, save and reload
+  paintCells(lut, 1);
+  save(writer, lut, settings_file);
+  checkReload(lut, lut_file, settings_file);
+
+  paintCells(lut, 2);
+  save(writer, lut, settings_file);
+  checkReload(lut, lut_file, settings_file);
+
+  paintCells(lut, 3);
+  save(writer, lut, settings_file);
+  checkReload(lut, lut_file, settings_file);
+
+  // saving without an edit keeps the last table
+  save(writer, lut, settings_file);
+  checkReload(lut, lut_file, settings_file);
+
+  return testResult();
+}